@@ -64,20 +64,20 @@ std::ostream& disvm::runtime::operator<<(std::ostream &ss, const middle_data_t &
 
 std::ostream& disvm::runtime::operator<<(std::ostream &ss, const vm_exec_op_t &m)
 {
-    const auto print_d = m.destination.mode != address_mode_t::none;
-    const auto print_m = print_d || m.middle.mode != address_mode_middle_t::none;
-    const auto print_s = print_m || m.source.mode != address_mode_t::none;
+    const auto print_d = m.destination().mode != address_mode_t::none;
+    const auto print_m = print_d || m.middle().mode != address_mode_middle_t::none;
+    const auto print_s = print_m || m.source().mode != address_mode_t::none;
 
     ss << disvm::assembly::opcode_to_token(m.opcode);
 
     if (print_s)
-        ss << " " << m.source;
+        ss << " " << m.source();
 
     if (print_m)
-        ss << " " << m.middle;
+        ss << " " << m.middle();
 
     if (print_d)
-        ss << " " << m.destination;
+        ss << " " << m.destination();
 
     return ss;
 }
\ No newline at end of file
@@ -0,0 +1,160 @@
+//
+// Dis VM - bundle program
+// File: main.cpp
+// Author: arr
+//
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <disvm.hpp>
+#include <exceptions.hpp>
+#include <module_bundle.hpp>
+
+using disvm::runtime::byte_t;
+using disvm::runtime::bundle_file_t;
+using disvm::runtime::vm_user_exception;
+using disvm::runtime::vm_system_exception;
+
+namespace
+{
+    void print_help()
+    {
+        std::cout
+            << "Usage: disvm-bundle -o <bundle> [-f] [-h] <file>+\n"
+               "    o - Bundle file to create\n"
+               "    f - Name files in the bundle by file name instead of the supplied path\n"
+               "    h - Print this help (alternative: '?')\n";
+    }
+
+    // Get the name of the file in the bundle. Paths always use '/' as the separator.
+    std::string get_bundle_name(const char *path, bool file_name_only)
+    {
+        auto name = std::string{ path };
+        std::replace(name.begin(), name.end(), '\\', '/');
+
+        if (file_name_only)
+        {
+            const auto separator = name.rfind('/');
+            if (separator != std::string::npos)
+                name.erase(0, separator + 1);
+        }
+
+        return name;
+    }
+
+    bool ends_with(const std::string &str, const char *suffix)
+    {
+        const auto suffix_len = std::strlen(suffix);
+        return str.size() >= suffix_len && 0 == str.compare(str.size() - suffix_len, suffix_len, suffix);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const char *bundle_path = nullptr;
+    auto file_name_only = false;
+    auto file_paths = std::vector<const char *>{};
+
+    for (auto i = int{ 1 }; i < argc; ++i)
+    {
+        const auto arg = argv[i];
+        if (arg[0] != '-')
+        {
+            file_paths.push_back(arg);
+            continue;
+        }
+
+        switch (arg[1])
+        {
+        case 'o':
+            if (++i == argc)
+            {
+                std::cerr << "Bundle file required\n";
+                return EXIT_FAILURE;
+            }
+
+            bundle_path = argv[i];
+            break;
+
+        case 'f':
+            file_name_only = true;
+            break;
+
+        case 'h':
+        case '?':
+            print_help();
+            return EXIT_SUCCESS;
+
+        default:
+            std::cerr << "Unknown flag: " << arg << "\n";
+            print_help();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (bundle_path == nullptr || file_paths.empty())
+    {
+        print_help();
+        return EXIT_FAILURE;
+    }
+
+    try
+    {
+        auto files = std::vector<bundle_file_t>{};
+        for (auto path : file_paths)
+        {
+            auto file = std::ifstream{ path, std::ifstream::in | std::ifstream::binary };
+            if (!file.is_open())
+            {
+                std::cerr << "Unable to open file: " << path << "\n";
+                return EXIT_FAILURE;
+            }
+
+            auto bundle_file = bundle_file_t{};
+            bundle_file.name = get_bundle_name(path, file_name_only);
+            bundle_file.contents.assign(std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{});
+
+            const auto duplicate = std::find_if(files.cbegin(), files.cend(), [&](const bundle_file_t &f) { return f.name == bundle_file.name; });
+            if (duplicate != files.cend())
+            {
+                std::cerr << "Duplicate file name in bundle: " << bundle_file.name << "\n";
+                return EXIT_FAILURE;
+            }
+
+            // Modules are read to fail early rather than when the bundle is used
+            if (ends_with(bundle_file.name, ".dis"))
+                disvm::read_module(bundle_file.contents.data(), bundle_file.contents.size());
+
+            files.push_back(std::move(bundle_file));
+        }
+
+        auto bundle = std::ofstream{ bundle_path, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc };
+        if (!bundle.is_open())
+        {
+            std::cerr << "Unable to create bundle: " << bundle_path << "\n";
+            return EXIT_FAILURE;
+        }
+
+        disvm::runtime::write_module_bundle(bundle, files);
+
+        std::cerr << "disvm-bundle: " << bundle_path << ": " << files.size() << " files\n";
+    }
+    catch (const vm_user_exception &ue)
+    {
+        std::cerr << ue.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    catch (const vm_system_exception &se)
+    {
+        std::cerr << "Internal exception:\n" << se.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
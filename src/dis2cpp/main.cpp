@@ -0,0 +1,822 @@
+//
+// Dis VM - dis2cpp program
+// File: main.cpp
+// Author: arr
+//
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <builtin_module.hpp>
+#include <disvm.hpp>
+#include <exceptions.hpp>
+#include <vm_asm.hpp>
+
+using disvm::opcode_t;
+
+using disvm::runtime::word_t;
+using disvm::runtime::vm_pc_t;
+using disvm::runtime::vm_module_t;
+using disvm::runtime::vm_exec_op_t;
+using disvm::runtime::inst_data_generic_t;
+using disvm::runtime::address_mode_t;
+using disvm::runtime::address_mode_middle_t;
+using disvm::runtime::runtime_flags_t;
+using disvm::runtime::type_descriptor_t;
+using disvm::runtime::vm_user_exception;
+using disvm::runtime::vm_system_exception;
+
+namespace
+{
+    // Reason an instruction can't be translated
+    class unsupported_instruction final : public std::runtime_error
+    {
+    public:
+        unsupported_instruction(const std::string &reason)
+            : std::runtime_error{ reason }
+        { }
+    };
+
+    // Value types of operands
+    enum class value_type_t
+    {
+        byte,
+        word,
+        big,
+        real,
+    };
+
+    const char *to_cpp_type(value_type_t t)
+    {
+        switch (t)
+        {
+        case value_type_t::byte: return "byte_t";
+        case value_type_t::word: return "word_t";
+        case value_type_t::big: return "big_t";
+        case value_type_t::real: return "real_t";
+        default:
+            throw std::logic_error{ "Unknown value type" };
+        }
+    }
+
+    // Returns 'true' if the type contains pointers the VM needs to track.
+    bool has_pointers(const type_descriptor_t &type)
+    {
+        for (auto i = word_t{ 0 }; i < type.map_in_bytes; ++i)
+        {
+            if (type.pointer_map[i] != 0)
+                return true;
+        }
+
+        return false;
+    }
+
+    // Make a C++ identifier from a Limbo name (e.g. 'Iobuf.open')
+    std::string to_identifier(const char *name)
+    {
+        auto id = std::string{ name };
+        for (auto &c : id)
+        {
+            if (!std::isalnum(static_cast<unsigned char>(c)))
+                c = '_';
+        }
+
+        return id;
+    }
+
+    // Translates functions in a module that only operate on values in their frames.
+    // Functions that access module data, allocate, or leave the module are not translated
+    // since built-in modules are unable to call back into the interpreter.
+    class module_translator_t final
+    {
+    public:
+        module_translator_t(const vm_module_t &module, std::string builtin_name)
+            : _module{ module }
+            , _builtin_name{ std::move(builtin_name) }
+            , _prefix{ to_identifier(_builtin_name.c_str() + 1) }
+        {
+            collect_functions();
+        }
+
+        // Write the C++ source for the built-in module.
+        // Returns the number of exports that were translated.
+        std::size_t write(std::ostream &os, const std::string &source_name)
+        {
+            // Translate all functions and then remove functions that call untranslated functions
+            for (const auto &f : _functions)
+                translate_function(f.first);
+
+            for (auto changed = true; changed;)
+            {
+                changed = false;
+                for (auto &f : _functions)
+                {
+                    if (!f.second.failure.empty())
+                        continue;
+
+                    for (auto callee : f.second.callees)
+                    {
+                        const auto &callee_func = _functions.at(callee);
+                        if (!callee_func.failure.empty())
+                        {
+                            f.second.failure = "Calls untranslated function @" + std::to_string(callee);
+                            changed = true;
+                            break;
+                        }
+                    }
+                }
+            }
+
+            auto exports = std::vector<const disvm::runtime::export_function_t *>{};
+            for (const auto &e : _module.export_section)
+            {
+                const auto &ex = e.second;
+                const auto &func = _functions.at(ex.pc);
+                if (!func.failure.empty())
+                {
+                    std::cerr << "dis2cpp: export '" << ex.name->str() << "' not translated: " << func.failure << "\n";
+                    continue;
+                }
+
+                const auto &frame_type = _module.type_section.at(ex.frame_type);
+                if (has_pointers(*frame_type))
+                {
+                    std::cerr << "dis2cpp: export '" << ex.name->str() << "' not translated: Frame contains pointers\n";
+                    continue;
+                }
+
+                exports.push_back(&ex);
+            }
+
+            if (exports.empty())
+                return 0;
+
+            // Exports are looked up by signature, order the table by name for stable output
+            std::sort(std::begin(exports), std::end(exports), [](const disvm::runtime::export_function_t *l, const disvm::runtime::export_function_t *r)
+            {
+                return std::strcmp(l->name->str(), r->name->str()) < 0;
+            });
+
+            write_prologue(os, source_name);
+
+            // Forward declarations
+            for (const auto &f : _functions)
+            {
+                if (f.second.failure.empty())
+                    os << "    void " << function_name(f.first) << "(byte_t *fp);\n";
+            }
+
+            for (const auto &f : _functions)
+            {
+                if (f.second.failure.empty())
+                    os << "\n" << f.second.body;
+            }
+
+            os << "\n    //\n    // Exports\n    //\n";
+            for (auto ex : exports)
+            {
+                os << "\n"
+                    << "    void " << export_name(*ex) << "(vm_registers_t &r, vm_t &)\n"
+                    << "    {\n"
+                    << "        " << function_name(ex->pc) << "(reinterpret_cast<byte_t *>(r.stack.peek_frame()->base()));\n"
+                    << "    }\n";
+            }
+
+            os << "\n    disvm::runtime::builtin::vm_runtab_t " << _prefix << "modtab[] = {\n";
+            for (auto ex : exports)
+            {
+                const auto &frame_type = _module.type_section.at(ex->frame_type);
+                os << "     \"" << ex->name->str() << "\","
+                    << "0x" << std::hex << static_cast<uint32_t>(ex->sig) << std::dec << ","
+                    << export_name(*ex) << ","
+                    << frame_type->size_in_bytes << ",0,{0},\n";
+            }
+
+            os << "        0\n"
+                << "    };\n"
+                << "\n"
+                << "    const word_t " << _prefix << "modlen = " << exports.size() << ";\n"
+                << "}\n"
+                << "\n"
+                << "void\n"
+                << _prefix << "modinit(void)\n"
+                << "{\n"
+                << "    disvm::runtime::builtin::register_module_exports(\"" << _builtin_name << "\", " << _prefix << "modlen, " << _prefix << "modtab);\n"
+                << "}\n";
+
+            return exports.size();
+        }
+
+    private:
+        struct function_t
+        {
+            vm_pc_t limit_pc;
+            std::set<vm_pc_t> callees;
+            std::string body;
+            std::string failure;
+        };
+
+        // Functions start at the entry, exports, and call targets and are contiguous.
+        void collect_functions()
+        {
+            auto entries = std::set<vm_pc_t>{};
+            if (_module.header.entry_pc >= 0)
+                entries.insert(_module.header.entry_pc);
+
+            for (const auto &e : _module.export_section)
+                entries.insert(e.second.pc);
+
+            for (const auto &inst : _module.code_section)
+            {
+                const auto &op = inst.op;
+                if (op.opcode == opcode_t::call && op.destination().mode == address_mode_t::immediate)
+                    entries.insert(op.destination().register1);
+            }
+
+            const auto code_size = static_cast<vm_pc_t>(_module.code_section.size());
+            for (auto iter = std::begin(entries); iter != std::end(entries); ++iter)
+            {
+                if (*iter < 0 || code_size <= *iter)
+                    throw vm_system_exception{ "Function entry outside of code section" };
+
+                auto next = std::next(iter);
+                auto &f = _functions[*iter];
+                f.limit_pc = (next == std::end(entries)) ? code_size : *next;
+            }
+        }
+
+        std::string function_name(vm_pc_t pc) const
+        {
+            return _prefix + "_f" + std::to_string(pc);
+        }
+
+        std::string export_name(const disvm::runtime::export_function_t &ex) const
+        {
+            return _prefix + "_" + to_identifier(ex.name->str());
+        }
+
+        void translate_function(vm_pc_t entry_pc)
+        {
+            auto &f = _functions.at(entry_pc);
+
+            // Branch targets need a label
+            auto targets = std::set<vm_pc_t>{};
+            for (auto pc = entry_pc; pc < f.limit_pc; ++pc)
+            {
+                const auto &op = _module.code_section[pc].op;
+                if (is_branch(op.opcode) && op.destination().mode == address_mode_t::immediate)
+                    targets.insert(op.destination().register1);
+            }
+
+            auto frames = std::stringstream{};
+            auto code = std::stringstream{};
+            for (auto pc = entry_pc; pc < f.limit_pc; ++pc)
+            {
+                const auto &op = _module.code_section[pc].op;
+                if (targets.find(pc) != std::end(targets))
+                    code << "    pc_" << pc << ":\n";
+
+                code << "        // " << op << "\n";
+                try
+                {
+                    translate_instruction(pc, entry_pc, f, op, frames, code);
+                }
+                catch (const unsupported_instruction &ui)
+                {
+                    auto ss = std::stringstream{};
+                    ss << ui.what() << " @" << pc << ": " << op;
+                    f.failure = ss.str();
+                    return;
+                }
+            }
+
+            auto body = std::stringstream{};
+            body << "    void " << function_name(entry_pc) << "(byte_t *fp)\n"
+                << "    {\n"
+                << frames.str()
+                << code.str()
+                << "    }\n";
+
+            f.body = body.str();
+        }
+
+        static bool is_branch(opcode_t opcode)
+        {
+            switch (opcode)
+            {
+            case opcode_t::beqb: case opcode_t::bneb: case opcode_t::bltb: case opcode_t::bleb: case opcode_t::bgtb: case opcode_t::bgeb:
+            case opcode_t::beqw: case opcode_t::bnew: case opcode_t::bltw: case opcode_t::blew: case opcode_t::bgtw: case opcode_t::bgew:
+            case opcode_t::beqf: case opcode_t::bnef: case opcode_t::bltf: case opcode_t::blef: case opcode_t::bgtf: case opcode_t::bgef:
+            case opcode_t::beql: case opcode_t::bnel: case opcode_t::bltl: case opcode_t::blel: case opcode_t::bgtl: case opcode_t::bgel:
+            case opcode_t::jmp:
+                return true;
+            default:
+                return false;
+            }
+        }
+
+        std::string operand(const inst_data_generic_t &d, value_type_t t, bool writable) const
+        {
+            auto ss = std::stringstream{};
+            switch (d.mode)
+            {
+            case address_mode_t::offset_indirect_fp:
+                ss << "vt<" << to_cpp_type(t) << ">(fp, " << d.register1 << ")";
+                break;
+
+            case address_mode_t::offset_double_indirect_fp:
+                ss << "vt<" << to_cpp_type(t) << ">(ptr(fp, " << d.register1 << "), " << d.register2 << ")";
+                break;
+
+            case address_mode_t::immediate:
+                if (writable)
+                    throw unsupported_instruction{ "Immediate destination" };
+
+                // Immediate values are a single word
+                if (t != value_type_t::byte && t != value_type_t::word)
+                    throw unsupported_instruction{ "Immediate value wider than a word" };
+
+                ss << "static_cast<" << to_cpp_type(t) << ">(" << d.register1 << ")";
+                break;
+
+            case address_mode_t::offset_indirect_mp:
+            case address_mode_t::offset_double_indirect_mp:
+                throw unsupported_instruction{ "Module data access" };
+
+            default:
+                throw unsupported_instruction{ "Invalid operand" };
+            }
+
+            return ss.str();
+        }
+
+        std::string middle_operand(const vm_exec_op_t &op, value_type_t t) const
+        {
+            auto ss = std::stringstream{};
+            switch (op.middle().mode)
+            {
+            case address_mode_middle_t::none:
+                return operand(op.destination(), t, false);
+
+            case address_mode_middle_t::small_immediate:
+                if (t != value_type_t::byte && t != value_type_t::word)
+                    throw unsupported_instruction{ "Immediate value wider than a word" };
+
+                ss << "static_cast<" << to_cpp_type(t) << ">(" << op.middle().register1 << ")";
+                break;
+
+            case address_mode_middle_t::small_offset_indirect_fp:
+                ss << "vt<" << to_cpp_type(t) << ">(fp, " << op.middle().register1 << ")";
+                break;
+
+            case address_mode_middle_t::small_offset_indirect_mp:
+                throw unsupported_instruction{ "Module data access" };
+
+            default:
+                throw unsupported_instruction{ "Invalid operand" };
+            }
+
+            return ss.str();
+        }
+
+        vm_pc_t branch_target(const inst_data_generic_t &d, vm_pc_t entry_pc, const function_t &f) const
+        {
+            if (d.mode != address_mode_t::immediate)
+                throw unsupported_instruction{ "Indirect branch" };
+
+            const auto target = static_cast<vm_pc_t>(d.register1);
+            if (target < entry_pc || f.limit_pc <= target)
+                throw unsupported_instruction{ "Branch outside of function" };
+
+            return target;
+        }
+
+        void translate_instruction(vm_pc_t pc, vm_pc_t entry_pc, function_t &f, const vm_exec_op_t &op, std::ostream &frames, std::ostream &code)
+        {
+            const auto b = value_type_t::byte;
+            const auto w = value_type_t::word;
+            const auto l = value_type_t::big;
+            const auto r = value_type_t::real;
+
+            // dest = src
+            auto move = [&](value_type_t t)
+            {
+                code << "        " << operand(op.destination(), t, true) << " = " << operand(op.source(), t, false) << ";\n";
+            };
+
+            // dest = cast(src)
+            auto convert = [&](value_type_t from, value_type_t to, const char *cast)
+            {
+                code << "        " << operand(op.destination(), to, true) << " = " << cast << "<" << to_cpp_type(to) << ">(" << operand(op.source(), from, false) << ");\n";
+            };
+
+            // dest = src <op> mid
+            auto binary = [&](value_type_t t, const char *oper)
+            {
+                code << "        " << operand(op.destination(), t, true) << " = static_cast<" << to_cpp_type(t) << ">("
+                    << operand(op.source(), t, false) << " " << oper << " " << middle_operand(op, t) << ");\n";
+            };
+
+            // dest = mid <op> src
+            auto binary_rev = [&](value_type_t t, const char *oper)
+            {
+                code << "        " << operand(op.destination(), t, true) << " = static_cast<" << to_cpp_type(t) << ">("
+                    << middle_operand(op, t) << " " << oper << " " << operand(op.source(), t, false) << ");\n";
+            };
+
+            // dest = fn(mid, src)
+            auto binary_fn = [&](value_type_t t, const char *fn)
+            {
+                code << "        " << operand(op.destination(), t, true) << " = " << fn << "<" << to_cpp_type(t) << ">("
+                    << middle_operand(op, t) << ", " << operand(op.source(), t, false) << ");\n";
+            };
+
+            // if (src <op> mid) goto dest
+            auto branch = [&](value_type_t t, const char *oper)
+            {
+                code << "        if (" << operand(op.source(), t, false) << " " << oper << " " << middle_operand(op, t) << ")\n"
+                    << "            goto pc_" << branch_target(op.destination(), entry_pc, f) << ";\n";
+            };
+
+            switch (op.opcode)
+            {
+            case opcode_t::movb: move(b); break;
+            case opcode_t::movw: move(w); break;
+            case opcode_t::movl: move(l); break;
+            case opcode_t::movf: move(r); break;
+
+            case opcode_t::cvtbw: convert(b, w, "static_cast"); break;
+            case opcode_t::cvtwb: convert(w, b, "static_cast"); break;
+            case opcode_t::cvtwl: convert(w, l, "static_cast"); break;
+            case opcode_t::cvtlw: convert(l, w, "static_cast"); break;
+            case opcode_t::cvtwf: convert(w, r, "static_cast"); break;
+            case opcode_t::cvtlf: convert(l, r, "static_cast"); break;
+            case opcode_t::cvtfw: convert(r, w, "round_real"); break;
+            case opcode_t::cvtfl: convert(r, l, "round_real"); break;
+
+            case opcode_t::negf:
+                code << "        " << operand(op.destination(), r, true) << " = -" << operand(op.source(), r, false) << ";\n";
+                break;
+
+            case opcode_t::addb: binary(b, "+"); break;
+            case opcode_t::addw: binary(w, "+"); break;
+            case opcode_t::addl: binary(l, "+"); break;
+            case opcode_t::addf: binary(r, "+"); break;
+            case opcode_t::mulb: binary(b, "*"); break;
+            case opcode_t::mulw: binary(w, "*"); break;
+            case opcode_t::mull: binary(l, "*"); break;
+            case opcode_t::mulf: binary(r, "*"); break;
+            case opcode_t::andb: binary(b, "&"); break;
+            case opcode_t::andw: binary(w, "&"); break;
+            case opcode_t::andl: binary(l, "&"); break;
+            case opcode_t::orb: binary(b, "|"); break;
+            case opcode_t::orw: binary(w, "|"); break;
+            case opcode_t::orl: binary(l, "|"); break;
+            case opcode_t::xorb: binary(b, "^"); break;
+            case opcode_t::xorw: binary(w, "^"); break;
+            case opcode_t::xorl: binary(l, "^"); break;
+
+            case opcode_t::subb: binary_rev(b, "-"); break;
+            case opcode_t::subw: binary_rev(w, "-"); break;
+            case opcode_t::subl: binary_rev(l, "-"); break;
+            case opcode_t::subf: binary_rev(r, "-"); break;
+            case opcode_t::shlb: binary_rev(b, "<<"); break;
+            case opcode_t::shlw: binary_rev(w, "<<"); break;
+            case opcode_t::shll: binary_rev(l, "<<"); break;
+            case opcode_t::shrb: binary_rev(b, ">>"); break;
+            case opcode_t::shrw: binary_rev(w, ">>"); break;
+            case opcode_t::shrl: binary_rev(l, ">>"); break;
+
+            case opcode_t::divb: binary_fn(b, "div"); break;
+            case opcode_t::divw: binary_fn(w, "div"); break;
+            case opcode_t::divl: binary_fn(l, "div"); break;
+            case opcode_t::divf: binary_fn(r, "div"); break;
+            case opcode_t::modb: binary_fn(b, "mod"); break;
+            case opcode_t::modw: binary_fn(w, "mod"); break;
+            case opcode_t::modl: binary_fn(l, "mod"); break;
+            case opcode_t::lsrw: binary_fn(w, "lsr"); break;
+            case opcode_t::lsrl: binary_fn(l, "lsr"); break;
+
+            case opcode_t::beqb: branch(b, "=="); break;
+            case opcode_t::bneb: branch(b, "!="); break;
+            case opcode_t::bltb: branch(b, "<"); break;
+            case opcode_t::bleb: branch(b, "<="); break;
+            case opcode_t::bgtb: branch(b, ">"); break;
+            case opcode_t::bgeb: branch(b, ">="); break;
+            case opcode_t::beqw: branch(w, "=="); break;
+            case opcode_t::bnew: branch(w, "!="); break;
+            case opcode_t::bltw: branch(w, "<"); break;
+            case opcode_t::blew: branch(w, "<="); break;
+            case opcode_t::bgtw: branch(w, ">"); break;
+            case opcode_t::bgew: branch(w, ">="); break;
+            case opcode_t::beql: branch(l, "=="); break;
+            case opcode_t::bnel: branch(l, "!="); break;
+            case opcode_t::bltl: branch(l, "<"); break;
+            case opcode_t::blel: branch(l, "<="); break;
+            case opcode_t::bgtl: branch(l, ">"); break;
+            case opcode_t::bgel: branch(l, ">="); break;
+            case opcode_t::beqf: branch(r, "=="); break;
+            case opcode_t::bnef: branch(r, "!="); break;
+            case opcode_t::bltf: branch(r, "<"); break;
+            case opcode_t::blef: branch(r, "<="); break;
+            case opcode_t::bgtf: branch(r, ">"); break;
+            case opcode_t::bgef: branch(r, ">="); break;
+
+            case opcode_t::jmp:
+                code << "        goto pc_" << branch_target(op.destination(), entry_pc, f) << ";\n";
+                break;
+
+            case opcode_t::lea:
+                if (op.source().mode == address_mode_t::immediate)
+                    throw unsupported_instruction{ "Address of immediate" };
+
+                code << "        vt<byte_t *>(" << operand_base(op.destination()) << ") = &" << operand(op.source(), b, false) << ";\n";
+                break;
+
+            case opcode_t::frame:
+            {
+                // Frames of translated functions are allocated on the native stack.
+                if (op.source().mode != address_mode_t::immediate)
+                    throw unsupported_instruction{ "Indirect frame type" };
+
+                const auto type_id = op.source().register1;
+                if (type_id < 0 || _module.type_section.size() <= static_cast<std::size_t>(type_id))
+                    throw unsupported_instruction{ "Invalid frame type" };
+
+                const auto &frame_type = _module.type_section[type_id];
+                if (has_pointers(*frame_type))
+                    throw unsupported_instruction{ "Frame contains pointers" };
+
+                frames << "        alignas(8) byte_t frame_" << pc << "[" << frame_type->size_in_bytes << "];\n";
+                code << "        std::memset(frame_" << pc << ", 0, sizeof(frame_" << pc << "));\n"
+                    << "        vt<byte_t *>(" << operand_base(op.destination()) << ") = frame_" << pc << ";\n";
+                break;
+            }
+
+            case opcode_t::call:
+            {
+                if (op.destination().mode != address_mode_t::immediate)
+                    throw unsupported_instruction{ "Indirect call" };
+
+                const auto target = static_cast<vm_pc_t>(op.destination().register1);
+                if (_functions.find(target) == std::end(_functions))
+                    throw unsupported_instruction{ "Unknown call target" };
+
+                f.callees.insert(target);
+                code << "        " << function_name(target) << "(vt<byte_t *>(" << operand_base(op.source()) << "));\n";
+                break;
+            }
+
+            case opcode_t::ret:
+                code << "        return;\n";
+                break;
+
+            default:
+                throw unsupported_instruction{ "Unsupported instruction" };
+            }
+        }
+
+        // Base and offset of an operand that holds a pointer
+        std::string operand_base(const inst_data_generic_t &d) const
+        {
+            auto ss = std::stringstream{};
+            switch (d.mode)
+            {
+            case address_mode_t::offset_indirect_fp:
+                ss << "fp, " << d.register1;
+                break;
+
+            case address_mode_t::offset_double_indirect_fp:
+                ss << "ptr(fp, " << d.register1 << "), " << d.register2;
+                break;
+
+            case address_mode_t::offset_indirect_mp:
+            case address_mode_t::offset_double_indirect_mp:
+                throw unsupported_instruction{ "Module data access" };
+
+            default:
+                throw unsupported_instruction{ "Invalid operand" };
+            }
+
+            return ss.str();
+        }
+
+        void write_prologue(std::ostream &os, const std::string &source_name) const
+        {
+            os << "//\n"
+                << "// Dis VM\n"
+                << "// File: " << _prefix << "mod.cpp\n"
+                << "// Generated by dis2cpp from '" << source_name << "' - do not edit.\n"
+                << "//\n"
+                << "\n"
+                << "#include <cstring>\n"
+                << "#include <disvm.hpp>\n"
+                << "#include <builtin_module.hpp>\n"
+                << "#include <exceptions.hpp>\n"
+                << "\n"
+                << "using disvm::vm_t;\n"
+                << "\n"
+                << "using disvm::runtime::byte_t;\n"
+                << "using disvm::runtime::word_t;\n"
+                << "using disvm::runtime::big_t;\n"
+                << "using disvm::runtime::real_t;\n"
+                << "using disvm::runtime::vm_registers_t;\n"
+                << "using disvm::runtime::dereference_nil;\n"
+                << "using disvm::runtime::divide_by_zero;\n"
+                << "\n"
+                << "namespace\n"
+                << "{\n"
+                << "    template<typename T>\n"
+                << "    T &vt(byte_t *base, word_t offset)\n"
+                << "    {\n"
+                << "        return *reinterpret_cast<T *>(base + offset);\n"
+                << "    }\n"
+                << "\n"
+                << "    byte_t *ptr(byte_t *base, word_t offset)\n"
+                << "    {\n"
+                << "        const auto p = vt<byte_t *>(base, offset);\n"
+                << "        if (p == nullptr)\n"
+                << "            throw dereference_nil{};\n"
+                << "\n"
+                << "        return p;\n"
+                << "    }\n"
+                << "\n"
+                << "    template<typename T>\n"
+                << "    T div(T n, T d)\n"
+                << "    {\n"
+                << "        if (d == T{ 0 })\n"
+                << "            throw divide_by_zero{};\n"
+                << "\n"
+                << "        return static_cast<T>(n / d);\n"
+                << "    }\n"
+                << "\n"
+                << "    template<>\n"
+                << "    real_t div<real_t>(real_t n, real_t d)\n"
+                << "    {\n"
+                << "        return n / d;\n"
+                << "    }\n"
+                << "\n"
+                << "    template<typename T>\n"
+                << "    T mod(T n, T d)\n"
+                << "    {\n"
+                << "        if (d == T{ 0 })\n"
+                << "            throw divide_by_zero{};\n"
+                << "\n"
+                << "        return static_cast<T>(n % d);\n"
+                << "    }\n"
+                << "\n"
+                << "    template<typename T>\n"
+                << "    T lsr(T n, T s)\n"
+                << "    {\n"
+                << "        return static_cast<T>(static_cast<typename std::make_unsigned<T>::type>(n) >> s);\n"
+                << "    }\n"
+                << "\n"
+                << "    template<typename T>\n"
+                << "    T round_real(real_t f)\n"
+                << "    {\n"
+                << "        f = f < 0 ? (f - 0.5) : (f + 0.5);\n"
+                << "        return static_cast<T>(f);\n"
+                << "    }\n"
+                << "\n";
+        }
+
+        const vm_module_t &_module;
+        const std::string _builtin_name;
+        const std::string _prefix;
+        std::map<vm_pc_t, function_t> _functions;
+    };
+
+    void print_help()
+    {
+        std::cout
+            << "Usage: dis2cpp [-n <built-in name>] [-o <output file>] [-h] <module>\n"
+               "    n - Name of the built-in module (default: '$' followed by the module name)\n"
+               "    o - Output file (default: stdout)\n"
+               "    h - Print this help (alternative: '?')\n";
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const char *module_path = nullptr;
+    const char *output_path = nullptr;
+    auto builtin_name = std::string{};
+
+    for (auto i = int{ 1 }; i < argc; ++i)
+    {
+        const auto arg = argv[i];
+        if (arg[0] != '-' && arg[0] != '/')
+        {
+            module_path = arg;
+            continue;
+        }
+
+        switch (arg[1])
+        {
+        case 'n':
+            if (++i == argc)
+            {
+                std::cerr << "Built-in name required\n";
+                return EXIT_FAILURE;
+            }
+
+            builtin_name = argv[i];
+            break;
+
+        case 'o':
+            if (++i == argc)
+            {
+                std::cerr << "Output file required\n";
+                return EXIT_FAILURE;
+            }
+
+            output_path = argv[i];
+            break;
+
+        case 'h':
+        case '?':
+            print_help();
+            return EXIT_SUCCESS;
+
+        default:
+            std::cerr << "Unknown flag: " << arg << "\n";
+            print_help();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (module_path == nullptr)
+    {
+        print_help();
+        return EXIT_FAILURE;
+    }
+
+    try
+    {
+        auto module_file = std::ifstream{ module_path, std::ifstream::in | std::ifstream::binary };
+        if (!module_file.is_open())
+        {
+            std::cerr << "Unable to open module: " << module_path << "\n";
+            return EXIT_FAILURE;
+        }
+
+        const auto module = disvm::read_module(module_file);
+
+        if (builtin_name.empty())
+            builtin_name = std::string{ BUILTIN_MODULE_PREFIX_STR } + module->module_name->str();
+
+        if (builtin_name[0] != BUILTIN_MODULE_PREFIX_CHAR)
+        {
+            std::cerr << "Built-in module names must start with '" BUILTIN_MODULE_PREFIX_STR "'\n";
+            return EXIT_FAILURE;
+        }
+
+        auto translator = module_translator_t{ *module, builtin_name };
+
+        auto source = std::stringstream{};
+        const auto export_count = translator.write(source, module_path);
+        if (export_count == 0)
+        {
+            std::cerr << "No exported functions could be translated\n";
+            return EXIT_FAILURE;
+        }
+
+        if (output_path == nullptr)
+        {
+            std::cout << source.str();
+        }
+        else
+        {
+            auto output_file = std::ofstream{ output_path };
+            output_file << source.str();
+            if (!output_file)
+            {
+                std::cerr << "Unable to write output file: " << output_path << "\n";
+                return EXIT_FAILURE;
+            }
+        }
+
+        std::cerr << "dis2cpp: " << builtin_name << ": " << export_count << " of " << module->export_section.size() << " exports translated\n";
+    }
+    catch (const vm_user_exception &ue)
+    {
+        std::cerr << ue.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    catch (const vm_system_exception &se)
+    {
+        std::cerr << "Internal exception:\n" << se.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
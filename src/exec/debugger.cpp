@@ -210,9 +210,9 @@ namespace
             assert(static_cast<std::size_t>(r.pc) < r.module_ref->code_section.size());
             const auto &op = r.module_ref->code_section[r.pc].op;
             register_string
-                << "\n        Src:  " << op.source
-                << "\n        Mid:  " << op.middle
-                << "\n        Dst:  " << op.destination;
+                << "\n        Src:  " << op.source()
+                << "\n        Mid:  " << op.middle()
+                << "\n        Dst:  " << op.destination();
         }
 
         register_string << "\n";
@@ -309,7 +309,7 @@ namespace
         return ss
             << " [[ref: " << dbg_alloc.t->get_ref_count()
             << " addr: " << reinterpret_cast<const void *>(dbg_alloc.t)
-            << " gc_res: " << reinterpret_cast<const void *>(dbg_alloc.t->gc_reserved)
+            << " gc_res: " << dbg_alloc.t->get_gc_reserved()
             << "]]";
     }
 
@@ -319,19 +319,19 @@ namespace
             return ss << "<nil>";
 
         vm_dbg_type<const vm_alloc_t *> dbg_alloc{ alloc };
-        if (alloc->alloc_type == intrinsic_type_desc::type<vm_string_t>())
+        if (alloc->alloc_type == intrinsic_type_desc::type<vm_string_t>().get())
         {
             ss << vm_alloc_t::from_allocation<vm_string_t>(alloc->get_allocation()) << dbg_alloc;
         }
-        else if (alloc->alloc_type == intrinsic_type_desc::type<vm_array_t>())
+        else if (alloc->alloc_type == intrinsic_type_desc::type<vm_array_t>().get())
         {
             ss << vm_alloc_t::from_allocation<vm_array_t>(alloc->get_allocation()) << dbg_alloc;
         }
-        else if (alloc->alloc_type == intrinsic_type_desc::type<vm_list_t>())
+        else if (alloc->alloc_type == intrinsic_type_desc::type<vm_list_t>().get())
         {
             ss << vm_alloc_t::from_allocation<vm_list_t>(alloc->get_allocation()) << dbg_alloc;
         }
-        else if (alloc->alloc_type == intrinsic_type_desc::type<vm_channel_t>())
+        else if (alloc->alloc_type == intrinsic_type_desc::type<vm_channel_t>().get())
         {
             ss << vm_alloc_t::from_allocation<vm_channel_t>(alloc->get_allocation()) << dbg_alloc;
         }
@@ -795,7 +795,7 @@ namespace
         if (a.size() < 3)
             throw debug_cmd_error_t{ "Invalid number of arguments" };
 
-        std::shared_ptr<const type_descriptor_t> base_type;
+        const type_descriptor_t *base_type = nullptr;
         word_t *base_pointer;
         auto &base_ptr_id = a[1];
         if (base_ptr_id.compare("mp") == 0)
@@ -809,7 +809,7 @@ namespace
             if (frame == nullptr)
                 throw debug_cmd_error_t{ "Invalid frame pointer " };
 
-            base_type = frame->frame_type;
+            base_type = frame->frame_type.get();
             base_pointer = reinterpret_cast<word_t *>(frame->base());
         }
         else
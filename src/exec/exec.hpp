@@ -9,9 +9,12 @@
 
 #include <cstdint>
 #include <unordered_set>
+#include <unordered_map>
 #include <vector>
 #include <string>
 #include <memory>
+#include <mutex>
+#include <ostream>
 #include <disvm.hpp>
 #include <vm_asm.hpp>
 #include <vm_tools.hpp>
@@ -80,4 +83,41 @@ private:
     std::unordered_map<std::string, std::string> _debugger_options;
 };
 
+// Records the frequency of opcode pairs and triples executed in sequence.
+// Sequences interrupted by a branch or call are not counted since they can't be
+// executed as a superinstruction.
+class opcode_profiler final : public disvm::runtime::vm_tool_t
+{
+public:
+    opcode_profiler();
+
+    // Print the most frequent opcode sequences
+    void print_report(std::ostream &os, std::size_t max_entries) const;
+
+public: // vm_tool_t
+    void on_load(disvm::runtime::vm_tool_controller_t &, std::size_t tool_id) override;
+
+    void on_unload() override;
+
+private:
+    void record(const disvm::runtime::vm_registers_t &r);
+
+    struct thread_history_t
+    {
+        uint64_t module_ref_id;
+        disvm::runtime::vm_pc_t pc;
+        disvm::opcode_t previous[2];
+        std::size_t length;
+    };
+
+    disvm::runtime::vm_tool_controller_t *_controller;
+    std::unordered_set<disvm::runtime::cookie_t> _event_cookies;
+
+    mutable std::mutex _lock;
+    std::unordered_map<uint32_t, thread_history_t> _threads;
+    std::unordered_map<uint32_t, uint64_t> _pairs;
+    std::unordered_map<uint32_t, uint64_t> _triples;
+    uint64_t _instruction_count;
+};
+
 #endif // _DISVM_SRC_EXEC_EXEC_HPP_
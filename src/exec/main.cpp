@@ -6,11 +6,14 @@
 
 #include <iostream>
 #include <cassert>
+#include <algorithm>
 #include <array>
+#include <chrono>
 #include <memory>
 #include <builtin_module.hpp>
 #include <debug.hpp>
 #include <exceptions.hpp>
+#include <module_bundle.hpp>
 #include <vm_asm_sigkind.hpp>
 #include <vm_version.hpp>
 #include "exec.hpp"
@@ -45,6 +48,8 @@ using disvm::runtime::address_mode_t;
 using disvm::runtime::address_mode_middle_t;
 using disvm::runtime::import_function_t;
 using disvm::runtime::import_vm_module_t;
+using disvm::runtime::vm_dispatch_strategy_t;
+using disvm::runtime::bundle_resolver_t;
 using disvm::runtime::vm_user_exception;
 using disvm::runtime::vm_system_exception;
 
@@ -136,7 +141,6 @@ namespace
             { vm_exec_op_t
                 {
                     opcode_t::load,
-                    disvm::assembly::construct_address_code(address_mode_t::offset_indirect_mp, address_mode_middle_t::small_immediate, address_mode_t::offset_indirect_fp),
                     { address_mode_t::offset_indirect_mp, 0, 0 }, // command module path
                     { address_mode_middle_t::small_immediate, 0 }, // import table index
                     { address_mode_t::offset_indirect_fp, 20, 0 } // module reference
@@ -145,7 +149,6 @@ namespace
             { vm_exec_op_t
                 {
                     opcode_t::mframe,
-                    disvm::assembly::construct_address_code(address_mode_t::offset_indirect_fp, address_mode_middle_t::small_immediate, address_mode_t::offset_indirect_fp),
                     { address_mode_t::offset_indirect_fp, 20, 0 }, // module reference
                     { address_mode_middle_t::small_immediate, 0 }, // function index into module
                     { address_mode_t::offset_indirect_fp, 24, 0 } // module call frame
@@ -154,7 +157,6 @@ namespace
             { vm_exec_op_t
                 {
                     opcode_t::movp,
-                    disvm::assembly::construct_address_code(address_mode_t::offset_indirect_mp, address_mode_middle_t::none, address_mode_t::offset_double_indirect_fp),
                     { address_mode_t::offset_indirect_mp, 4, 0 }, // Argument list
                     { address_mode_middle_t::none },
                     { address_mode_t::offset_double_indirect_fp, 24, first_arg_offset } // module call frame -> argument list offset
@@ -163,7 +165,6 @@ namespace
             { vm_exec_op_t
                 {
                     opcode_t::mcall,
-                    disvm::assembly::construct_address_code(address_mode_t::offset_indirect_fp, address_mode_middle_t::small_immediate, address_mode_t::offset_indirect_fp),
                     { address_mode_t::offset_indirect_fp, 24, 0 }, // module call frame
                     { address_mode_middle_t::small_immediate, 0 }, // function index into module
                     { address_mode_t::offset_indirect_fp, 20, 0 } // module reference
@@ -172,7 +173,6 @@ namespace
             { vm_exec_op_t
                 {
                     opcode_t::ret,
-                    disvm::assembly::construct_address_code(address_mode_t::none, address_mode_middle_t::none, address_mode_t::none),
                     { address_mode_t::none },
                     { address_mode_middle_t::none },
                     { address_mode_t::none }
@@ -224,19 +224,35 @@ struct exec_options
         , enabled_debugger{ false }
         , quiet_start{ false }
         , print_help{ false }
+        , benchmark{ false }
+        , profile{ false }
         , vm_config{}
     { }
 
     std::vector<char *> vm_args;
+    std::vector<char *> bundle_paths;
 
     vm_config_t vm_config;
 
     bool print_help;
+    bool benchmark;
+    bool profile;
     bool quiet_start;
     bool enabled_debugger;
     debugger_options debugger;
 };
 
+const char *dispatch_strategy_name(vm_dispatch_strategy_t strategy)
+{
+    switch (strategy)
+    {
+    case vm_dispatch_strategy_t::call_threaded: return "call-threaded";
+    case vm_dispatch_strategy_t::switch_table: return "switch";
+    case vm_dispatch_strategy_t::direct_threaded: return "direct-threaded";
+    default: return "unknown";
+    }
+}
+
 void print_banner(const exec_options &options)
 {
     std::cout << "DisVM " << DISVM_VERSION_MAJOR << '.' << DISVM_VERSION_MINOR << '.' << DISVM_VERSION_PATCH;
@@ -248,7 +264,11 @@ void print_banner(const exec_options &options)
     std::cout
         << "\n----------------\n"
         << "Debugger enabled: " << std::boolalpha << options.enabled_debugger << "\n"
-        << "System thread usage: " << options.vm_config.sys_thread_pool_size << "\n";
+        << "System thread usage: " << options.vm_config.sys_thread_pool_size << "\n"
+        << "Interpreter dispatch: " << (options.benchmark ? "benchmark" : dispatch_strategy_name(vm_t::get_supported_dispatch_strategy(options.vm_config.dispatch_strategy))) << "\n"
+        << "JIT enabled: " << options.vm_config.jit_enabled << "\n"
+        << "Module image cache: " << (options.vm_config.module_image_cache_path.empty() ? "<disabled>" : options.vm_config.module_image_cache_path) << "\n"
+        << "Opcode profiling: " << options.profile << "\n";
 
     if (options.enabled_debugger)
         std::cout << "\n" << options.debugger << "\n";
@@ -259,13 +279,21 @@ void print_banner(const exec_options &options)
 void print_help()
 {
     std::cout
-        << "Usage: disvm-exec [-d[e|m|x]*] [-l[s|S|t|T|e|g|m]*] [-gD] [-t <num>] [-q] [-h] <entry module> <args>*\n"
+        << "Usage: disvm-exec [-d[e|m|x]*] [-l[s|S|t|T|e|g|m]*] [-gD] [-i[c|s|g]] [-j] [-p] [-b] [-a <bundle>]* [-c <dir>] [-t <num>] [-q] [-h] <entry module> <args>*\n"
+           "    a - Resolve modules from the supplied bundle before the file system\n"
+           "    b - Benchmark the entry module under each interpreter dispatch strategy (min/median of 5 runs)\n"
+           "    c - Store and load module images in the supplied directory\n"
            "    d - Enable debugger\n"
            "         e - Break on entry\n"
            "         m - Break on module load\n"
            "         x - Break on exception (first chance)\n"
            "    g - Garbage collector options\n"
            "         D - Disable\n"
+           "    i - Interpreter dispatch strategy\n"
+           "         c - Call-threaded (default)\n"
+           "         s - Switch\n"
+           "         g - Direct-threaded (computed goto)\n"
+           "    j - Enable JIT compilation (x86 only)\n"
            "    l - Enable logging in a component\n"
            "         s - Scheduler\n"
            "         S - Stack\n"
@@ -275,6 +303,7 @@ void print_help()
            "         d - Duration of actions\n"
            "         g - Garbage collector (noisy)\n"
            "         m - Memory allocations (noisy)\n"
+           "    p - Profile opcode sequences and print the most frequent on exit\n"
            "    q - Suppress banner and configuration\n"
            "    t - Specify the number of system threads to use (0 < x <= 4)\n"
            "    h - Print this help (alternative: '?')\n";
@@ -338,6 +367,30 @@ void process_arg(char* arg, std::function<char *()> next, exec_options &options)
         }
         break;
 
+    case 'a':
+        {
+            auto bundle_path = next();
+            if (bundle_path == nullptr)
+                throw arg_exception_t{ "Module bundle requires path" };
+
+            options.bundle_paths.push_back(bundle_path);
+        }
+        break;
+
+    case 'b':
+        options.benchmark = true;
+        break;
+
+    case 'c':
+        {
+            auto cache_path = next();
+            if (cache_path == nullptr)
+                throw arg_exception_t{ "Module image cache requires directory" };
+
+            options.vm_config.module_image_cache_path = cache_path;
+        }
+        break;
+
     case 'g':
         if (arg_len <= 2 || arg[2] != 'D')
             throw arg_exception_t{ "Invalid garbage collector option" };
@@ -345,6 +398,27 @@ void process_arg(char* arg, std::function<char *()> next, exec_options &options)
         options.vm_config.create_gc = disvm::runtime::create_no_op_gc;
         break;
 
+    case 'i':
+        if (arg_len <= 2)
+            throw arg_exception_t{ "Interpreter dispatch requires strategy", arg };
+
+        switch (arg[2])
+        {
+        case 'c': options.vm_config.dispatch_strategy = vm_dispatch_strategy_t::call_threaded;
+            break;
+        case 's': options.vm_config.dispatch_strategy = vm_dispatch_strategy_t::switch_table;
+            break;
+        case 'g': options.vm_config.dispatch_strategy = vm_dispatch_strategy_t::direct_threaded;
+            break;
+        default:
+            throw arg_exception_t{ "Invalid interpreter dispatch strategy", arg };
+        }
+        break;
+
+    case 'j':
+        options.vm_config.jit_enabled = true;
+        break;
+
     case 't':
         {
             auto sys_threads_str = next();
@@ -387,6 +461,10 @@ void process_arg(char* arg, std::function<char *()> next, exec_options &options)
         }
         break;
 
+    case 'p':
+        options.profile = true;
+        break;
+
     case 'q':
         options.quiet_start = true;
         break;
@@ -401,6 +479,107 @@ void process_arg(char* arg, std::function<char *()> next, exec_options &options)
     }
 }
 
+// Add a resolver for each of the supplied module bundles
+void add_bundle_resolvers(const exec_options &options, vm_config_t &config)
+{
+    for (auto path : options.bundle_paths)
+        config.additional_resolvers.push_back(std::make_unique<bundle_resolver_t>(path));
+}
+
+// Number of opcode sequences reported when profiling
+const auto max_profile_entries = std::size_t{ 16 };
+
+// Create a config with the supplied dispatch strategy and the remaining settings of the supplied options.
+vm_config_t create_benchmark_config(const exec_options &options, vm_dispatch_strategy_t strategy)
+{
+    const auto &other = options.vm_config;
+
+    vm_config_t config{};
+    config.sys_thread_pool_size = other.sys_thread_pool_size;
+    config.thread_quanta = other.thread_quanta;
+    config.dispatch_strategy = strategy;
+    config.jit_enabled = other.jit_enabled;
+    config.share_modules = other.share_modules;
+    config.create_scheduler = other.create_scheduler;
+    config.create_gc = other.create_gc;
+    config.probing_paths = other.probing_paths;
+    config.module_image_cache_path = other.module_image_cache_path;
+    add_bundle_resolvers(options, config);
+
+    return config;
+}
+
+using benchmark_duration_t = std::chrono::duration<double, std::milli>;
+
+// Number of timed runs of the entry module under each dispatch strategy
+const auto benchmark_run_count = std::size_t{ 5 };
+
+// Run the entry module with the supplied config and return the time taken to execute it.
+// Creating the VM, loading the entry module, and tearing down the VM are not timed.
+benchmark_duration_t run_entry_module(const exec_options &options, vm_config_t config)
+{
+    vm_t vm{ std::move(config) };
+    auto entry = create_entry_module(vm, options.vm_args);
+
+    const auto start = std::chrono::steady_clock::now();
+
+    vm.exec(std::move(entry));
+    vm.spin_sleep_till_idle(std::chrono::milliseconds(0));
+
+    return std::chrono::duration_cast<benchmark_duration_t>(std::chrono::steady_clock::now() - start);
+}
+
+// Run the entry module under each dispatch strategy and report the minimum and median execution time.
+// Each strategy is run once untimed to warm caches (including the module image cache), then the
+// strategies are timed in turn with the order rotated each round.
+// The debugger is not loaded during a benchmark run.
+void run_benchmark(const exec_options &options)
+{
+    const vm_dispatch_strategy_t all_strategies[] =
+    {
+        vm_dispatch_strategy_t::call_threaded,
+        vm_dispatch_strategy_t::switch_table,
+        vm_dispatch_strategy_t::direct_threaded,
+    };
+
+    auto strategies = std::vector<vm_dispatch_strategy_t>{};
+    for (auto strategy : all_strategies)
+    {
+        // Strategies the compiler doesn't support would measure another strategy
+        if (vm_t::get_supported_dispatch_strategy(strategy) != strategy)
+        {
+            std::cout << "Benchmark: " << dispatch_strategy_name(strategy) << ": not supported" << std::endl;
+            continue;
+        }
+
+        strategies.push_back(strategy);
+        run_entry_module(options, create_benchmark_config(options, strategy));
+    }
+
+    auto elapsed = std::vector<std::vector<benchmark_duration_t>>(strategies.size());
+    for (auto run = std::size_t{ 0 }; run < benchmark_run_count; ++run)
+    {
+        for (auto i = std::size_t{ 0 }; i < strategies.size(); ++i)
+        {
+            const auto index = (run + i) % strategies.size();
+            elapsed[index].push_back(run_entry_module(options, create_benchmark_config(options, strategies[index])));
+        }
+    }
+
+    for (auto i = std::size_t{ 0 }; i < strategies.size(); ++i)
+    {
+        auto &times = elapsed[i];
+        std::sort(times.begin(), times.end());
+
+        std::cout
+            << "Benchmark: " << dispatch_strategy_name(strategies[i])
+            << ": min " << times.front().count() << " ms"
+            << ", median " << times[times.size() / 2].count() << " ms"
+            << " (" << times.size() << " runs)"
+            << std::endl;
+    }
+}
+
 int main(int argc, char* argv[])
 {
     exec_options options{};
@@ -436,18 +615,36 @@ int main(int argc, char* argv[])
         return EXIT_SUCCESS;
     }
 
-    vm_t vm{ std::move(options.vm_config) };
-
-    if (options.enabled_debugger)
-        vm.load_tool(std::make_shared<debugger>(options.debugger));
-
     try
     {
-        auto entry = create_entry_module(vm, options.vm_args);
+        if (options.benchmark)
+        {
+            run_benchmark(options);
+        }
+        else
+        {
+            add_bundle_resolvers(options, options.vm_config);
+            vm_t vm{ std::move(options.vm_config) };
+
+            if (options.enabled_debugger)
+                vm.load_tool(std::make_shared<debugger>(options.debugger));
 
-        vm.exec(std::move(entry));
+            auto profiler = std::shared_ptr<opcode_profiler>{};
+            if (options.profile)
+            {
+                profiler = std::make_shared<opcode_profiler>();
+                vm.load_tool(profiler);
+            }
 
-        vm.spin_sleep_till_idle(std::chrono::milliseconds(100));
+            auto entry = create_entry_module(vm, options.vm_args);
+
+            vm.exec(std::move(entry));
+
+            vm.spin_sleep_till_idle(std::chrono::milliseconds(100));
+
+            if (profiler != nullptr)
+                profiler->print_report(std::cout, max_profile_entries);
+        }
     }
     catch (const vm_user_exception &ue)
     {
@@ -0,0 +1,170 @@
+//
+// Dis VM
+// File: profiler.cpp
+// Author: arr
+//
+
+#include <algorithm>
+#include <cassert>
+#include <iomanip>
+#include <vector>
+#include <utils.hpp>
+#include <vm_asm.hpp>
+#include "exec.hpp"
+
+using disvm::opcode_t;
+
+using disvm::runtime::runtime_flags_t;
+using disvm::runtime::vm_registers_t;
+using disvm::runtime::vm_thread_state_t;
+using disvm::runtime::vm_trap_flags_t;
+using disvm::runtime::vm_tool_controller_t;
+using disvm::runtime::vm_event_t;
+using disvm::runtime::vm_event_context_t;
+
+namespace disvm
+{
+    namespace runtime
+    {
+        DEFINE_ENUM_FLAG_OPERATORS(vm_trap_flags_t);
+    }
+}
+
+namespace
+{
+    using sequence_counts_t = std::unordered_map<uint32_t, uint64_t>;
+
+    const auto opcode_bits = uint32_t{ 8 };
+
+    uint32_t to_key(opcode_t a, opcode_t b)
+    {
+        return (static_cast<uint32_t>(a) << opcode_bits) | static_cast<uint32_t>(b);
+    }
+
+    uint32_t to_key(opcode_t a, opcode_t b, opcode_t c)
+    {
+        return (to_key(a, b) << opcode_bits) | static_cast<uint32_t>(c);
+    }
+
+    void print_sequences(std::ostream &os, const char *title, const sequence_counts_t &counts, std::size_t length, uint64_t total, std::size_t max_entries)
+    {
+        auto sorted = std::vector<std::pair<uint32_t, uint64_t>>{ std::begin(counts), std::end(counts) };
+        std::sort(std::begin(sorted), std::end(sorted), [](const std::pair<uint32_t, uint64_t> &l, const std::pair<uint32_t, uint64_t> &r)
+        {
+            return l.second > r.second;
+        });
+
+        os << title << ":\n";
+
+        const auto count = std::min(max_entries, sorted.size());
+        for (auto i = std::size_t{ 0 }; i < count; ++i)
+        {
+            const auto &entry = sorted[i];
+            const auto percent = (total == 0) ? 0.0 : (100.0 * entry.second) / total;
+
+            os << std::setw(12) << entry.second << " " << std::setw(6) << std::fixed << std::setprecision(2) << percent << "% ";
+            for (auto j = length; j > 0; --j)
+            {
+                const auto opcode = static_cast<opcode_t>((entry.first >> ((j - 1) * opcode_bits)) & 0xff);
+                os << " " << disvm::assembly::opcode_to_token(opcode);
+            }
+
+            os << "\n";
+        }
+    }
+}
+
+opcode_profiler::opcode_profiler()
+    : _controller{ nullptr }
+    , _instruction_count{ 0 }
+{ }
+
+void opcode_profiler::print_report(std::ostream &os, std::size_t max_entries) const
+{
+    std::lock_guard<std::mutex> lock{ _lock };
+
+    os << "Opcode profile: " << _instruction_count << " instructions\n";
+    print_sequences(os, "Opcode pairs", _pairs, 2, _instruction_count, max_entries);
+    print_sequences(os, "Opcode triples", _triples, 3, _instruction_count, max_entries);
+    os << std::flush;
+}
+
+void opcode_profiler::on_load(vm_tool_controller_t &controller, std::size_t)
+{
+    _controller = &controller;
+
+    _event_cookies.emplace(_controller->subscribe_event(vm_event_t::thread_begin, [](vm_event_t, vm_event_context_t &cxt)
+    {
+        // The thread has not been scheduled so the trap flag can be set directly
+        auto &r = const_cast<vm_registers_t &>(cxt.value1.thread->get_registers());
+        r.trap_flags |= vm_trap_flags_t::instruction;
+    }));
+
+    _event_cookies.emplace(_controller->subscribe_event(vm_event_t::thread_end, [&](vm_event_t, vm_event_context_t &cxt)
+    {
+        std::lock_guard<std::mutex> lock{ _lock };
+        _threads.erase(cxt.value1.thread->get_thread_id());
+    }));
+
+    _event_cookies.emplace(_controller->subscribe_event(vm_event_t::trap, [&](vm_event_t, vm_event_context_t &cxt)
+    {
+        if (!disvm::util::has_flag(cxt.value2.trap, vm_trap_flags_t::instruction))
+            return;
+
+        // The trap is raised on the thread being profiled so the flag is re-armed directly
+        auto &r = *cxt.value1.registers;
+        record(r);
+        r.trap_flags |= vm_trap_flags_t::instruction;
+    }));
+}
+
+void opcode_profiler::on_unload()
+{
+    assert(_controller != nullptr);
+
+    for (auto ec : _event_cookies)
+        _controller->unsubscribe_event(ec);
+
+    _controller = nullptr;
+}
+
+// The trap occurs after an instruction has executed, so the instruction at the
+// current program counter is the next in the sequence.
+void opcode_profiler::record(const vm_registers_t &r)
+{
+    if (r.current_thread_state == vm_thread_state_t::empty_stack
+        || r.current_thread_state == vm_thread_state_t::exiting
+        || r.current_thread_state == vm_thread_state_t::broken)
+        return;
+
+    const auto &module = *r.module_ref->module;
+    if (disvm::util::has_flag(module.header.runtime_flag, runtime_flags_t::builtin)
+        || r.pc < 0
+        || module.code_section.size() <= static_cast<std::size_t>(r.pc))
+        return;
+
+    const auto opcode = module.code_section[r.pc].op.opcode;
+    const auto module_ref_id = r.module_ref->instance_id;
+
+    std::lock_guard<std::mutex> lock{ _lock };
+
+    ++_instruction_count;
+
+    auto &history = _threads[r.thread.get_thread_id()];
+
+    // Control transferred to a non-sequential instruction
+    if (history.length > 0 && (history.module_ref_id != module_ref_id || (history.pc + 1) != r.pc))
+        history.length = 0;
+
+    if (history.length > 0)
+        ++_pairs[to_key(history.previous[1], opcode)];
+
+    if (history.length > 1)
+        ++_triples[to_key(history.previous[0], history.previous[1], opcode)];
+
+    history.module_ref_id = module_ref_id;
+    history.pc = r.pc;
+    history.previous[0] = history.previous[1];
+    history.previous[1] = opcode;
+    history.length = std::min(history.length + 1, std::size_t{ 2 });
+}
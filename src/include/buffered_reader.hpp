@@ -9,27 +9,42 @@
 
 #include <cstdint>
 #include <cassert>
+#include <cstring>
+#include <algorithm>
 #include <vector>
 #include <sstream>
+#include <string>
 #include <tuple>
-#include <iosfwd>
+#include <istream>
 
 namespace disvm
 {
     namespace util
     {
+        // Reader over a stream or a contiguous block of memory.
+        // If constructed over memory, the supplied bytes must outlive the reader and are read in place.
         class buffered_reader_t
         {
         public:
             buffered_reader_t(std::istream &stream)
                 : _buffer(64 * 1024) // 64k is an optimization for the Windows filesystem manager
+                , _data{ reinterpret_cast<const uint8_t *>(_buffer.data()) }
                 , _current_index{ 0 }
                 , _current_size{ 0 }
-                , _stream{ stream }
+                , _stream{ &stream }
             {
                 assert(!stream.fail());
             }
 
+            buffered_reader_t(const uint8_t *data, std::size_t size)
+                : _data{ data }
+                , _current_index{ 0 }
+                , _current_size{ size }
+                , _stream{ nullptr }
+            {
+                assert(data != nullptr || size == 0);
+            }
+
             buffered_reader_t(const buffered_reader_t&) = delete;
             buffered_reader_t& operator=(const buffered_reader_t&) = delete;
 
@@ -53,7 +68,7 @@ namespace disvm
                     // Buffer contains requested amount
                     if (bytes_requested <= amount_in_buffer)
                     {
-                        std::memcpy(buffer, (_buffer.data() + _current_index), bytes_requested);
+                        std::memcpy(buffer, (_data + _current_index), bytes_requested);
                         _current_index += bytes_requested;
                         bytes_requested_acc += bytes_requested;
                         return bytes_requested_acc;
@@ -61,7 +76,7 @@ namespace disvm
                     else
                     {
                         // Buffer does not contain all the data requested
-                        std::memcpy(buffer, (_buffer.data() + _current_index), amount_in_buffer);
+                        std::memcpy(buffer, (_data + _current_index), amount_in_buffer);
                         _current_index += amount_in_buffer;
 
                         // Subtract the bytes consumed
@@ -76,17 +91,20 @@ namespace disvm
             // Read from the stream as a string until the supplied delimiter is encountered.
             std::string get_as_string_until(const char delim)
             {
-                std::stringstream ss;
+                std::string str;
                 auto amount_in_buffer = check_buffer_content();
                 while (amount_in_buffer != 0)
                 {
-                    while (_current_index < _current_size)
-                    {
-                        auto c = _buffer[_current_index++];
-                        if (c == delim)
-                            return ss.str();
+                    const auto begin = reinterpret_cast<const char *>(_data + _current_index);
+                    const auto end = begin + amount_in_buffer;
+                    const auto found = std::find(begin, end, delim);
 
-                        ss << c;
+                    str.append(begin, found);
+                    _current_index += static_cast<std::size_t>(found - begin);
+                    if (found != end)
+                    {
+                        ++_current_index;
+                        return str;
                     }
 
                     amount_in_buffer = check_buffer_content();
@@ -101,13 +119,16 @@ namespace disvm
                 auto amount_in_buffer = check_buffer_content();
                 while (amount_in_buffer != 0)
                 {
-                    while(_current_index < _current_size)
-                    {
-                        auto b = _buffer[_current_index++];
-                        if (b == delim)
-                            return true;
+                    const auto begin = _data + _current_index;
+                    const auto end = begin + amount_in_buffer;
+                    const auto found = std::find(begin, end, delim);
 
-                        byte_buffer.push_back(b);
+                    byte_buffer.insert(byte_buffer.end(), begin, found);
+                    _current_index += static_cast<std::size_t>(found - begin);
+                    if (found != end)
+                    {
+                        ++_current_index;
+                        return true;
                     }
 
                     amount_in_buffer = check_buffer_content();
@@ -124,34 +145,52 @@ namespace disvm
                 if (amount_in_buffer == 0)
                     return std::make_tuple<bool, uint8_t>(false, 0);
 
-                return std::make_tuple(true, _buffer[_current_index++]);
+                return std::make_tuple(true, _data[_current_index++]);
+            }
+
+            // Get the bytes that can be read in place without copying.
+            // Returns the number of bytes available, which may be fewer than the remaining content
+            // if the reader is over a stream. Consume bytes with skip_bytes().
+            std::size_t peek_bytes(const uint8_t *&bytes)
+            {
+                const auto amount_in_buffer = check_buffer_content();
+                bytes = _data + _current_index;
+                return amount_in_buffer;
+            }
+
+            // Consume bytes returned from peek_bytes().
+            void skip_bytes(std::size_t count)
+            {
+                assert(count <= (_current_size - _current_index));
+                _current_index += count;
             }
 
         private:
             std::size_t check_buffer_content()
             {
-                if (_current_size <= _current_index)
+                if (_current_size <= _current_index && _stream != nullptr)
                 {
                     _current_index = 0;
                     _current_size = 0;
 
-                    if (_stream.fail())
+                    if (_stream->fail())
                         return 0;
 
-                    _stream.read(_buffer.data(), _buffer.size());
+                    _stream->read(_buffer.data(), _buffer.size());
 
                     // If the stream has failed, set the current size, otherwise the buffer size
-                    _current_size = _stream.fail() ? static_cast<std::size_t>(_stream.gcount()) : _buffer.size();
+                    _current_size = _stream->fail() ? static_cast<std::size_t>(_stream->gcount()) : _buffer.size();
                 }
 
                 return _current_size - _current_index;
             }
 
         private:
-            std::istream &_stream;
+            std::vector<char> _buffer;
+            const uint8_t *_data;
             std::size_t _current_index;
             std::size_t _current_size;
-            std::vector<char> _buffer;
+            std::istream *_stream;
         };
     }
 }
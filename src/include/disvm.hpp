@@ -21,6 +21,14 @@ namespace disvm
     // Read in a module from the supplied stream
     std::unique_ptr<runtime::vm_module_t> read_module(std::istream &data);
 
+    // Read in a module from the supplied bytes (e.g. a memory mapped file).
+    // The bytes are parsed in place and only need to remain valid for the duration of the call.
+    std::unique_ptr<runtime::vm_module_t> read_module(const runtime::byte_t *data, std::size_t size);
+
+    // Prove the operands of the supplied module's code section are valid (see vm_module_t::verified).
+    // Modules returned by read_module() have already been verified.
+    bool verify_module(const runtime::vm_module_t &module);
+
     template <typename C>
     using create_vm_interface_callback_t = std::unique_ptr<C>(*)(vm_t &);
 
@@ -62,6 +70,18 @@ namespace disvm
         uint32_t sys_thread_pool_size;
         uint32_t thread_quanta;
 
+        // Dispatch strategy used by the interpreter.
+        runtime::vm_dispatch_strategy_t dispatch_strategy;
+
+        // Compile frequently executed modules to native code.
+        // Modules marked 'must_compile' are compiled on first execution.
+        bool jit_enabled;
+
+        // Share modules loaded from a path with other VMs in the process that enable sharing.
+        // Module code, types, and exports are shared, each VM gets its own copy of module data.
+        // VMs that share modules should resolve a path to the same module.
+        bool share_modules;
+
         create_vm_interface_callback_t<runtime::vm_scheduler_t> create_scheduler;
         create_vm_interface_callback_t<runtime::vm_garbage_collector_t> create_gc;
 
@@ -69,6 +89,11 @@ namespace disvm
         // the user isn't found. Note these will be concatenated with the supplied
         // path, not other manipulation will be performed.
         std::vector<std::string> probing_paths;
+
+        // Directory the default module resolver stores module images in.
+        // Images are trusted when loaded, see module_image.hpp. Empty disables the cache.
+        std::string module_image_cache_path;
+
         std::vector<std::unique_ptr<runtime::vm_module_resolver_t>> additional_resolvers;
     };
 
@@ -78,6 +103,10 @@ namespace disvm
     public: // static
         static const uint32_t root_vm_thread_id;
 
+        // Get the dispatch strategy the interpreter uses for the supplied strategy.
+        // Strategies the compiler doesn't support are replaced (e.g. 'direct_threaded').
+        static runtime::vm_dispatch_strategy_t get_supported_dispatch_strategy(runtime::vm_dispatch_strategy_t strategy);
+
     public:
         explicit vm_t();
         explicit vm_t(vm_config_t config);
@@ -119,6 +148,12 @@ namespace disvm
         // Access the garbage collector for this VM.
         runtime::vm_garbage_collector_t &get_garbage_collector() const;
 
+        // Get the dispatch strategy used by the interpreter.
+        runtime::vm_dispatch_strategy_t get_dispatch_strategy() const;
+
+        // Returns 'true' if modules may be compiled to native code.
+        bool is_jit_enabled() const;
+
         // Spin and sleep until the VM is idle, then return.
         // Idle is defined as no vm threads executing, scheduled to be executed, or blocked.
         void spin_sleep_till_idle(std::chrono::milliseconds sleep_interval) const;
@@ -136,12 +171,28 @@ namespace disvm
         mutable std::mutex _modules_lock;
         loaded_modules_t _modules;
 
+        // Index of loaded modules by path. The index is immutable once published so
+        // lookups don't take the modules lock. It is replaced when a module is loaded.
+        struct module_index_entry_t
+        {
+            loaded_vm_module_t *loaded_module;
+            std::weak_ptr<runtime::vm_module_t> module;
+        };
+
+        using module_index_t = std::unordered_map<std::string, module_index_entry_t>;
+        std::shared_ptr<const module_index_t> _module_index;
+        void publish_module_index(loaded_vm_module_t &loaded_module, std::string path, std::shared_ptr<runtime::vm_module_t> module);
+
         std::vector<std::unique_ptr<runtime::vm_module_resolver_t>> _module_resolvers;
         std::unique_ptr<runtime::vm_scheduler_t> _scheduler;
         std::unique_ptr<runtime::vm_garbage_collector_t> _gc;
         std::unique_ptr<runtime::vm_tool_dispatch_t> _tool_dispatch;
         std::mutex _tool_dispatch_lock;
 
+        const runtime::vm_dispatch_strategy_t _dispatch_strategy;
+        const bool _jit_enabled;
+        const bool _share_modules;
+
         std::atomic_flag _last_syscall_error_message_lock;
         std::array<char, 128> _last_syscall_error_message;
 
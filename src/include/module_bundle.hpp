@@ -0,0 +1,83 @@
+//
+// Dis VM
+// File: module_bundle.hpp
+// Author: arr
+//
+
+#ifndef _DISVM_SRC_INCLUDE_MODULE_BUNDLE_HPP_
+#define _DISVM_SRC_INCLUDE_MODULE_BUNDLE_HPP_
+
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "runtime.hpp"
+
+namespace disvm
+{
+    namespace util
+    {
+        // Forward declaration
+        class mapped_file_t;
+    }
+
+    namespace runtime
+    {
+        // File to store in a module bundle (e.g. '.dis' module or '.sbl' symbols)
+        struct bundle_file_t
+        {
+            // Name used to find the file in the bundle (e.g. 'lib/bufio.dis')
+            std::string name;
+            std::vector<byte_t> contents;
+        };
+
+        // Write a bundle containing the supplied files to the stream.
+        // A bundle is a header, an index of names and offsets, followed by the contents of each file.
+        void write_module_bundle(std::ostream &bundle, const std::vector<bundle_file_t> &files);
+
+        // Module resolver that reads modules from a bundle. The bundle is mapped into
+        // memory once and modules are read in place. Supply instances of this resolver
+        // through vm_config_t::additional_resolvers.
+        class bundle_resolver_t final : public vm_module_resolver_t
+        {
+        public:
+            // Open the bundle at the supplied path.
+            // Throws vm_module_exception if the bundle can't be opened or is invalid.
+            bundle_resolver_t(const char *bundle_path);
+            bundle_resolver_t(const bundle_resolver_t &) = delete;
+            bundle_resolver_t &operator=(const bundle_resolver_t &) = delete;
+
+            ~bundle_resolver_t();
+
+        public: // vm_module_resolver_t
+            // Modules are found by the supplied path. If no file in the bundle has the same normalized path,
+            // a file whose path and the supplied path end in the same whole components is used
+            // (e.g. '/dis/lib/x.dis' finds 'lib/x.dis'). Throws vm_module_exception if more than one file matches.
+            bool try_resolve_module(const char *path, std::unique_ptr<vm_module_t> &new_module);
+
+        public:
+            // Get the contents of the named file in the bundle (e.g. symbols).
+            // Returns 'false' if the file isn't in the bundle.
+            bool try_get_file(const char *name, const byte_t *&data, std::size_t &size) const;
+
+        private:
+            struct file_t
+            {
+                const byte_t *data;
+                std::size_t size;
+            };
+
+            const file_t *find_module_file(const char *path) const;
+
+            std::unique_ptr<util::mapped_file_t> _bundle;
+
+            // Files by normalized path and the normalized paths of files by file name
+            std::unordered_map<std::string, file_t> _files;
+            std::unordered_multimap<std::string, std::string> _paths_by_file_name;
+        };
+    }
+}
+
+#endif // _DISVM_SRC_INCLUDE_MODULE_BUNDLE_HPP_
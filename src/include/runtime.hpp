@@ -17,6 +17,7 @@
 #include <unordered_map>
 #include <mutex>
 #include <functional>
+#include <limits>
 #include "opcodes.hpp"
 
 namespace disvm
@@ -56,6 +57,8 @@ namespace disvm
             static vm_alloc_instance_finalizer_t no_finalizer;
 
             // Create a type descriptor for type of the supplied size and pointers based on the supplied map.
+            // Descriptors are interned so the same instance is returned for identical layouts.
+            // Interned descriptors live for the lifetime of the process.
             static std::shared_ptr<const type_descriptor_t> create(const word_t size_in_bytes);
             static std::shared_ptr<const type_descriptor_t> create(const word_t size_in_bytes, const std::vector<byte_t> &pointer_map);
             static std::shared_ptr<const type_descriptor_t> create(
@@ -65,7 +68,15 @@ namespace disvm
                 vm_alloc_instance_finalizer_t finalizer = type_descriptor_t::no_finalizer);
 
         public:
-            type_descriptor_t(word_t size_in_bytes, word_t map_in_bytes, const byte_t * pointer_map, vm_alloc_instance_finalizer_t finalizer, const char *debug_name);
+            type_descriptor_t(
+                word_t size_in_bytes,
+                word_t map_in_bytes,
+                const byte_t * pointer_map,
+                word_t pointer_count,
+                const word_t * pointer_offsets,
+                vm_alloc_instance_finalizer_t finalizer,
+                bool free_eagerly,
+                const char *debug_name);
             type_descriptor_t(const type_descriptor_t&) = delete;
             type_descriptor_t& operator=(const type_descriptor_t&) = delete;
 
@@ -74,7 +85,16 @@ namespace disvm
             const word_t size_in_bytes;
             const word_t map_in_bytes;
             const byte_t * const pointer_map;
+
+            // Word offsets of the pointer fields in the pointer map, in ascending order.
+            const word_t pointer_count;
+            const word_t * const pointer_offsets;
+
             const vm_alloc_instance_finalizer_t finalizer;
+
+            // Allocations of this type hold resources outside of the VM (e.g. an open file) and are
+            // freed as soon as their last reference is released, rather than queued for incremental freeing.
+            const bool free_eagerly;
 #ifndef NDEBUG
             const char *debug_type_name;
 #endif
@@ -96,7 +116,7 @@ namespace disvm
             static void *operator new(std::size_t sz);
             static void operator delete(void *ptr);
 
-            static vm_alloc_t *allocate(std::shared_ptr<const type_descriptor_t> td);
+            static vm_alloc_t *allocate(const std::shared_ptr<const type_descriptor_t> &td);
             static vm_alloc_t *copy(const vm_alloc_t &other);
 
             static vm_alloc_t *from_allocation(pointer_t allocation)
@@ -115,21 +135,33 @@ namespace disvm
                 return static_cast<T *>(alloc_inst);
             }
 
+        private:
+            static vm_alloc_t *allocate(const type_descriptor_t *td);
+
         protected:
-            vm_alloc_t(std::shared_ptr<const type_descriptor_t> td);
+            vm_alloc_t(const std::shared_ptr<const type_descriptor_t> &td);
+            vm_alloc_t(const type_descriptor_t *td);
 
         public:
             virtual ~vm_alloc_t();
 
             std::size_t add_ref();
+
+            // Returns 0 if the caller released the last reference and should free the allocation.
             std::size_t release();
+
+            // The count is only exact if no other thread is changing it.
             std::size_t get_ref_count() const;
 
-            std::shared_ptr<const type_descriptor_t> alloc_type;
+            // [PERF] The allocation header is kept small since most allocations are small (e.g. list
+            // cells and ADTs). Type descriptors are never destroyed (see type_descriptor_t::create()
+            // and intrinsic_type_desc) so the allocation doesn't own a reference to its type.
+            const type_descriptor_t * const alloc_type;
 
-            // Reserved for use by the garbage collector.
+            // Reserved for use by the garbage collector (values 0 - 3).
             // This should not be accessed by any other component.
-            pointer_t gc_reserved;
+            uint32_t get_gc_reserved() const;
+            void set_gc_reserved(uint32_t value);
 
         public:
             pointer_t get_allocation() const
@@ -145,8 +177,22 @@ namespace disvm
                 return reinterpret_cast<T *>(get_allocation());
             }
 
+        public: // static
+            // Merge reference counts of allocations owned by the current system thread
+            // that were released by other threads, freeing any that are no longer referenced.
+            static void process_deferred_releases();
+
         private:
-            std::atomic<std::size_t> _ref_count;
+            // Merge the biased count into the shared count. Returns 'true' if the allocation should be freed.
+            bool merge_biased_count();
+
+            // [PERF] Reference counts are biased towards the system thread that created the allocation.
+            // The owning thread updates the biased count without atomic read-modify-write operations
+            // and other threads update the shared count, see vm_memory.cpp. The owner ID and biased
+            // count share a word, and the collector's bits are kept in the shared count, so the header
+            // is the same size as a single reference count.
+            std::atomic<uint32_t> _owner_count;
+            std::atomic<int32_t> _shared_count;
         };
 
         //
@@ -420,6 +466,24 @@ namespace disvm
         using src_data_t = inst_data_generic_t;
         using dest_data_t = inst_data_generic_t;
 
+        // Returns 'true' if the addressing mode is double indirect.
+        constexpr bool is_double_indirect(address_mode_t mode)
+        {
+            return mode == address_mode_t::offset_double_indirect_fp || mode == address_mode_t::offset_double_indirect_mp;
+        }
+
+        // Packed source or destination instruction data
+        // Double indirect operands are two 16-bit offsets, all other operands are a single word.
+        union vm_operand_t
+        {
+            word_t value;
+            struct
+            {
+                uint16_t first;
+                uint16_t second;
+            } offsets;
+        };
+
         // Forward declaration
         class vm_registers_t;
 
@@ -432,15 +496,65 @@ namespace disvm
         using addr_code_t = uint8_t;
 
         // Opcode execution operation
+        // Instructions are stored packed - the addressing modes are derived from the address
+        // code and the operands are unpacked on access.
         struct vm_exec_op_t
         {
+        public: // static
+            static vm_operand_t pack(const inst_data_generic_t &data)
+            {
+                auto operand = vm_operand_t{};
+                if (is_double_indirect(data.mode))
+                {
+                    assert(0 <= data.register1 && data.register1 <= std::numeric_limits<uint16_t>::max());
+                    assert(0 <= data.register2 && data.register2 <= std::numeric_limits<uint16_t>::max());
+                    operand.offsets.first = static_cast<uint16_t>(data.register1);
+                    operand.offsets.second = static_cast<uint16_t>(data.register2);
+                }
+                else
+                {
+                    operand.value = data.register1;
+                }
+
+                return operand;
+            }
+
+            static inst_data_generic_t unpack(address_mode_t mode, vm_operand_t operand)
+            {
+                if (is_double_indirect(mode))
+                    return{ mode, operand.offsets.first, operand.offsets.second };
+
+                return{ mode, operand.value, 0 };
+            }
+
+        public:
+            vm_exec_op_t() = default;
+
+            vm_exec_op_t(opcode_t opcode, const src_data_t &source, const middle_data_t &middle, const dest_data_t &destination)
+                : opcode{ opcode }
+                , addr_code{ static_cast<addr_code_t>(static_cast<uint8_t>(middle.mode) << 6 | static_cast<uint8_t>(source.mode) << 3 | static_cast<uint8_t>(destination.mode)) }
+                , mid{ middle.register1 }
+                , src{ pack(source) }
+                , dest{ pack(destination) }
+            { }
+
+            address_mode_middle_t middle_mode() const { return static_cast<address_mode_middle_t>(addr_code >> 6); }
+            address_mode_t source_mode() const { return static_cast<address_mode_t>((addr_code >> 3) & 0x7); }
+            address_mode_t destination_mode() const { return static_cast<address_mode_t>(addr_code & 0x7); }
+
+            middle_data_t middle() const { return{ middle_mode(), mid }; }
+            src_data_t source() const { return unpack(source_mode(), src); }
+            dest_data_t destination() const { return unpack(destination_mode(), dest); }
+
             opcode_t opcode;
             addr_code_t addr_code;
-            src_data_t source;
-            middle_data_t middle;
-            dest_data_t destination;
+            word_t mid;
+            vm_operand_t src;
+            vm_operand_t dest;
         };
 
+        static_assert(sizeof(vm_exec_op_t) == 16, "Instructions should be packed into 16 bytes");
+
         // VM Instruction (code section of module)
         union vm_instruction_t
         {
@@ -448,6 +562,95 @@ namespace disvm
             vm_exec_t native;
         };
 
+        // Interpreter dispatch strategies
+        enum class vm_dispatch_strategy_t
+        {
+            call_threaded,      // Indirect call through the handler resolved at load time
+            switch_table,       // Switch over the opcode
+            direct_threaded,    // Computed goto - falls back to 'switch_table' if unsupported by the compiler
+        };
+
+        // Inline cache for an inter-module call site (i.e. 'mframe' and 'mcall').
+        // Records the target resolved for the last seen module reference. Entries are
+        // updated using a sequence lock so readers never block.
+        struct vm_call_site_cache_t
+        {
+            vm_call_site_cache_t()
+                : sequence{ 0 }
+                , module_ref_id{ 0 }
+                , function_id{ 0 }
+                , entry_pc{ 0 }
+                , frame_type{ nullptr }
+                , builtin{ false }
+            { }
+
+            // Odd while the entry is being updated
+            std::atomic<uint32_t> sequence;
+
+            // Key
+            std::atomic<uint64_t> module_ref_id;
+            std::atomic<word_t> function_id;
+
+            // Resolved target
+            std::atomic<vm_pc_t> entry_pc;
+            std::atomic<const std::shared_ptr<const type_descriptor_t> *> frame_type;
+            std::atomic<bool> builtin;
+        };
+
+        // Point at which executing an instruction charges the thread quanta
+        // Straight-line code can't run indefinitely without reaching a back-edge, call, or
+        // blocking instruction, so the quanta is only charged at those instructions.
+        enum class vm_preemption_t : uint8_t
+        {
+            none,
+            back_edge, // Charged if control was transferred backwards
+            always, // Charged unconditionally and the thread state is examined
+        };
+
+        // Forward declaration
+        struct vm_decoded_inst_t;
+
+        // Addressing decode operation - updates the source, middle, and destination registers.
+        using vm_decode_t = void(*)(const vm_decoded_inst_t &, vm_registers_t &);
+
+        // Pre-decoded VM instruction
+        // The addressing decoder and opcode handler are resolved when the module is loaded
+        // so the interpreter doesn't need to consult the decode and execution tables.
+        struct vm_decoded_inst_t
+        {
+            vm_decoded_inst_t() = default;
+            vm_decoded_inst_t(const vm_decoded_inst_t &other)
+            {
+                *this = other;
+            }
+
+            vm_decoded_inst_t &operator=(const vm_decoded_inst_t &other)
+            {
+                decode.store(other.decode.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                exec = other.exec;
+                opcode = other.opcode;
+                preemption = other.preemption;
+                mid = other.mid;
+                src = other.src;
+                dest = other.dest;
+                call_site_cache = other.call_site_cache;
+                return *this;
+            }
+
+            // Entries are decoded when first executed (see decode_code_section()). The decoder is
+            // stored with release semantics after the rest of the entry and must be loaded with acquire.
+            std::atomic<vm_decode_t> decode;
+            vm_exec_t exec;
+            opcode_t opcode;
+            vm_preemption_t preemption;
+            word_t mid;
+            vm_operand_t src;
+            vm_operand_t dest;
+
+            // Inline cache if the instruction is an inter-module call site, otherwise null.
+            vm_call_site_cache_t *call_site_cache;
+        };
+
         // Flags that dictate the runtime operations of the module
         // [SPEC] Values past 'shared_module' are not fully documented.
         enum class runtime_flags_t
@@ -570,6 +773,7 @@ namespace disvm
         };
 
         using code_section_t = std::vector<vm_instruction_t>;
+        using decoded_section_t = std::vector<vm_decoded_inst_t>;
         using type_section_map_t = std::vector<std::shared_ptr<const type_descriptor_t>>;
         using export_section_t = std::unordered_multimap<word_t, const export_function_t>;
         using import_section_t = std::vector<import_vm_module_t>;
@@ -577,6 +781,46 @@ namespace disvm
 
         using module_id_t = std::size_t;
 
+        // Forward declaration
+        class vm_native_code_t;
+        struct vm_module_t;
+
+        // Reference to a function in an imported module.
+        struct vm_module_function_ref_t
+        {
+            vm_pc_t entry_pc;
+            word_t frame_type;
+        };
+
+        // Functions of an import table resolved against the exports of a module.
+        using vm_function_refs_t = std::vector<vm_module_function_ref_t>;
+
+        // Cache of the import tables of a module resolved against the modules they were loaded from.
+        class vm_import_cache_t final
+        {
+        public:
+            vm_import_cache_t() = default;
+            vm_import_cache_t(const vm_import_cache_t &) = delete;
+            vm_import_cache_t &operator=(const vm_import_cache_t &) = delete;
+
+            // Get the functions of the supplied import table of the importing module resolved against the supplied module.
+            // Only the module most recently resolved for each import table is cached.
+            std::shared_ptr<const vm_function_refs_t> resolve(
+                const vm_module_t &importing_module,
+                std::size_t import_index,
+                const std::shared_ptr<const vm_module_t> &module) const;
+
+        private:
+            struct entry_t
+            {
+                std::weak_ptr<const vm_module_t> module;
+                std::shared_ptr<const vm_function_refs_t> function_refs;
+            };
+
+            mutable std::mutex _lock;
+            mutable std::vector<entry_t> _entries;
+        };
+
         // VM module
         struct vm_module_t
         {
@@ -596,6 +840,25 @@ namespace disvm
             // Describes a sequence of instructions for the virtual machine
             code_section_t code_section;
 
+            // Set if the code section passed verification when the module was read.
+            // Operands of unverified modules are checked as each instruction is executed.
+            bool verified;
+
+            // Pre-decoded form of the code section executed by the interpreter.
+            // Entries are placeholders until the containing function is first executed.
+            // This is empty for built-in modules.
+            decoded_section_t decoded_section;
+
+            // Program counters of function entry points in ascending order.
+            // Used to decode the code section a function at a time.
+            std::vector<vm_pc_t> function_entries;
+
+            // Serializes updates to the decoded section.
+            std::mutex decode_lock;
+
+            // Inline caches referenced by call sites in the decoded section.
+            std::unique_ptr<vm_call_site_cache_t[]> call_site_caches;
+
             // template module pointer
             std::unique_ptr<vm_alloc_t> original_mp;
 
@@ -611,15 +874,14 @@ namespace disvm
             // List of all functions imported from other modules
             import_section_t import_section;
 
+            // Import tables resolved by 'load' instructions in this module
+            vm_import_cache_t import_cache;
+
             // Lists all exception handlers declared in the module
             handler_section_t handler_section;
-        };
 
-        // Reference to a function in an imported module.
-        struct vm_module_function_ref_t
-        {
-            vm_pc_t entry_pc;
-            word_t frame_type;
+            // Native code for the module. This is null if the module is not compiled.
+            std::shared_ptr<vm_native_code_t> native_code;
         };
 
         // Reference to a module
@@ -630,20 +892,37 @@ namespace disvm
 
         public:
             vm_module_ref_t(std::shared_ptr<const vm_module_t> module);
-            vm_module_ref_t(std::shared_ptr<const vm_module_t> module, const import_vm_module_t &imports);
+            vm_module_ref_t(std::shared_ptr<const vm_module_t> module, std::shared_ptr<const vm_function_refs_t> function_refs);
             ~vm_module_ref_t();
 
             std::shared_ptr<const vm_module_t> module;
-            vm_alloc_t *mp_base;
+
+            // Module data (MP). This starts as a reference to the original module data of
+            // the module and is replaced with a private copy before it is first written.
+            std::atomic<vm_alloc_t *> mp_base;
+
+            // Unique ID for this module reference. IDs are 64-bit and never reused
+            // so they can be safely retained in call site caches.
+            const uint64_t instance_id;
+
             const code_section_t &code_section;
+            const decoded_section_t &decoded_section;
             const type_section_map_t &type_section;
 
             bool is_builtin_module() const;
             const vm_module_function_ref_t& get_function_ref(word_t index) const;
 
+            // Returns 'true' if the module data is shared with the original module data.
+            bool is_mp_shared() const;
+
+            // Replace shared module data with a private copy.
+            void make_mp_private();
+
         private:
             const bool _builtin_module;
-            std::unique_ptr<vm_array_t> _function_refs;
+            std::atomic<bool> _mp_shared;
+            std::mutex _mp_lock;
+            std::shared_ptr<const vm_function_refs_t> _function_refs;
         };
 
         // VM stack frame
@@ -755,6 +1034,12 @@ namespace disvm
                 vm_module_ref_t &entry);
             ~vm_registers_t();
 
+            // Refresh the cached FP base after a frame is pushed or popped.
+            void update_fp();
+
+            // Refresh the cached MP base after the MP register changes.
+            void update_mp();
+
             vm_thread_t &thread;
             std::atomic<vm_tool_dispatch_t *> tool_dispatch;
             vm_stack_t stack;  // Frame pointer access (FP)
@@ -764,6 +1049,11 @@ namespace disvm
             vm_module_ref_t *module_ref;  // Module reference
             vm_request_mutex_t request_mutex;
 
+            // Base addresses of the top frame and module data used to decode operands.
+            // These are only valid while the thread is executing.
+            pointer_t fp;
+            pointer_t mp;
+
             uint16_t current_thread_quanta;
             vm_thread_state_t current_thread_state;
             vm_trap_flags_t trap_flags;
@@ -939,6 +1229,11 @@ namespace disvm
             // an exception and instead return 'false'. Exception thrown
             // indirectly by calling supplied DisVM functions are valid.
             virtual bool try_resolve_module(const char *path, std::unique_ptr<vm_module_t> &new_module) = 0;
+
+            // Try to identify the file the supplied path resolves to (e.g. by its location and modification
+            // time). Returns 'false' if the path can't be resolved. An empty identity means the resolved file
+            // can't be identified, which is the default. Modules are only shared between VMs by identity.
+            virtual bool try_get_module_identity(const char *path, std::string &identity);
         };
 
         // Forward declaration
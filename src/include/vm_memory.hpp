@@ -12,7 +12,6 @@
 #include <limits>
 #include <mutex>
 #include <memory>
-#include <bitset>
 #include <functional>
 #include "runtime.hpp"
 
@@ -46,9 +45,26 @@ namespace disvm
         // Decrement the ref count of all pointers in the supplied memory allocation
         void dec_ref_count_in_memory(const type_descriptor_t &type_desc, void *data);
 
-        // Decrement the ref count and if 0 free the allocation
+        // Decrement the ref count and if 0 free the allocation.
+        // Allocations released while freeing another allocation are queued on the current
+        // system thread and freed by free_pending_allocs(), unless their type has a finalizer
+        // or is freed eagerly (see type_descriptor_t::free_eagerly).
         void dec_ref_count_and_free(vm_alloc_t *alloc);
 
+        // Free at most 'budget' of the allocations queued on the current system thread.
+        // Returns the number of allocations still queued.
+        std::size_t free_pending_allocs(std::size_t budget = std::numeric_limits<std::size_t>::max());
+
+        // Mark the current system thread as waiting for work. While parked, releases by other threads
+        // of allocations created on this thread are merged by the releasing thread rather than queued.
+        // Returns 'false' if releases or allocations are still queued on this thread, in which case they
+        // should be processed (see vm_alloc_t::process_deferred_releases()) and the call retried.
+        bool park_system_thread();
+
+        // Resume processing releases queued on the current system thread. Must be called after
+        // park_system_thread() succeeds and before the thread releases or frees any allocation.
+        void unpark_system_thread();
+
         // Function to enumerate pointer fields in an object. The function is defined
         // as a template to permit raw function pointers or lambdas. The signature
         // of the callback must be 'void(pointer_t *)' and is supplied a pointer to the
@@ -59,25 +75,14 @@ namespace disvm
         {
             assert(data != nullptr);
 
+            // [PERF] Frames are created and destroyed on every call so the pointer fields are
+            // visited from the precomputed offsets rather than by decoding the pointer map.
             auto memory = reinterpret_cast<word_t *>(data);
-            for (auto i = word_t{ 0 }; i < type_desc.map_in_bytes; ++i, memory += 8)
+            for (auto i = word_t{ 0 }; i < type_desc.pointer_count; ++i)
             {
-                const auto words8 = type_desc.pointer_map[i];
-                assert(sizeof(words8) == 1);
-                if (words8 == 0)
-                    continue;
-
-                const auto flags = std::bitset<sizeof(words8) * 8>{ words8 };
-
-                // Enumerating the flags in reverse order so memory access is sequential.
-                if (flags[7] && (memory[0] != runtime_constants::nil)) callback(reinterpret_cast<pointer_t *>(memory));
-                if (flags[6] && (memory[1] != runtime_constants::nil)) callback(reinterpret_cast<pointer_t *>(memory) + 1);
-                if (flags[5] && (memory[2] != runtime_constants::nil)) callback(reinterpret_cast<pointer_t *>(memory) + 2);
-                if (flags[4] && (memory[3] != runtime_constants::nil)) callback(reinterpret_cast<pointer_t *>(memory) + 3);
-                if (flags[3] && (memory[4] != runtime_constants::nil)) callback(reinterpret_cast<pointer_t *>(memory) + 4);
-                if (flags[2] && (memory[5] != runtime_constants::nil)) callback(reinterpret_cast<pointer_t *>(memory) + 5);
-                if (flags[1] && (memory[6] != runtime_constants::nil)) callback(reinterpret_cast<pointer_t *>(memory) + 6);
-                if (flags[0] && (memory[7] != runtime_constants::nil)) callback(reinterpret_cast<pointer_t *>(memory) + 7);
+                const auto offset = type_desc.pointer_offsets[i];
+                if (memory[offset] != runtime_constants::nil)
+                    callback(reinterpret_cast<pointer_t *>(memory + offset));
             }
         }
 
@@ -7,7 +7,8 @@
 #include <cassert>
 #include <atomic>
 #include <mutex>
-#include <forward_list>
+#include <string>
+#include <unordered_map>
 #include <runtime.hpp>
 #include <module_reader.hpp>
 #include <builtin_module.hpp>
@@ -21,8 +22,9 @@ namespace
 {
     std::atomic_bool builtin_modules_initialized{ false };
 
+    // Built-in modules by name
     std::mutex builtin_modules_lock;
-    std::forward_list<std::shared_ptr<vm_module_t>> builtin_modules;
+    std::unordered_map<std::string, std::shared_ptr<vm_module_t>> builtin_modules;
 }
 
 // Declare initializers for built-in modules.
@@ -93,23 +95,18 @@ void disvm::runtime::builtin::register_module_exports(const char *name, word_t t
     {
         std::lock_guard<std::mutex> lock{ builtin_modules_lock };
 
-#ifndef NDEBUG
-        for (const auto &m : builtin_modules)
-            assert(0 != std::strcmp(m->module_name->str(), name) && "Built-in module with matching name already exists");
-#endif
-
-        builtin_modules.push_front(std::move(new_builtin));
+        const auto inserted = builtin_modules.emplace(name, std::move(new_builtin)).second;
+        assert(inserted && "Built-in module with matching name already exists");
+        (void)inserted;
     }
 }
 
 std::shared_ptr<vm_module_t> disvm::runtime::builtin::get_builtin_module(const char *name)
 {
     std::lock_guard<std::mutex> lock{ builtin_modules_lock };
-    for (const auto &m : builtin_modules)
-    {
-        if (0 == std::strcmp(m->module_name->str(), name))
-            return m;
-    }
+    const auto iter = builtin_modules.find(name);
+    if (iter != builtin_modules.cend())
+        return iter->second;
 
     throw vm_module_exception{ "Unknown built-in module" };
 }
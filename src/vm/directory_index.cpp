@@ -0,0 +1,223 @@
+//
+// Dis VM
+// File: directory_index.cpp
+// Author: arr
+//
+
+#include <cassert>
+#include <cctype>
+#include <ctime>
+#include <debug.hpp>
+#include "directory_index.hpp"
+
+// [PAL] Directory enumeration
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+using disvm::debug::component_trace_t;
+using disvm::debug::log_level_t;
+
+using disvm::util::directory_index_t;
+using disvm::util::file_lookup_t;
+
+namespace
+{
+    enum class list_result_t
+    {
+        listed,
+        missing, // The directory doesn't exist
+        failed,
+    };
+
+#ifdef _WIN32
+    list_result_t list_directory(const std::string &directory, std::unordered_set<std::string> &names)
+    {
+        auto pattern = directory;
+        pattern.append("\\*");
+
+        WIN32_FIND_DATAA find_data;
+        auto find = ::FindFirstFileA(pattern.c_str(), &find_data);
+        if (find == INVALID_HANDLE_VALUE)
+        {
+            const auto error = ::GetLastError();
+            return (error == ERROR_PATH_NOT_FOUND || error == ERROR_FILE_NOT_FOUND) ? list_result_t::missing : list_result_t::failed;
+        }
+
+        do
+        {
+            if ((find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0)
+                names.insert(find_data.cFileName);
+        } while (::FindNextFileA(find, &find_data));
+
+        ::FindClose(find);
+        return list_result_t::listed;
+    }
+
+    // Get the modification time of the directory in seconds since the UNIX epoch
+    bool get_modified_time(const std::string &directory, int64_t &modified_time)
+    {
+        WIN32_FILE_ATTRIBUTE_DATA data;
+        if (!::GetFileAttributesExA(directory.c_str(), GetFileExInfoStandard, &data))
+            return false;
+
+        const auto ticks = (static_cast<int64_t>(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+
+        // FILETIME is in 100ns intervals since 1601-01-01
+        modified_time = (ticks - 116444736000000000LL) / 10000000LL;
+        return true;
+    }
+#else
+    list_result_t list_directory(const std::string &directory, std::unordered_set<std::string> &names)
+    {
+        auto dir = ::opendir(directory.c_str());
+        if (dir == nullptr)
+            return (errno == ENOENT || errno == ENOTDIR) ? list_result_t::missing : list_result_t::failed;
+
+        // Entries of an unknown type are kept since they may be files
+        for (auto entry = ::readdir(dir); entry != nullptr; entry = ::readdir(dir))
+        {
+            if (entry->d_type != DT_DIR)
+                names.insert(entry->d_name);
+        }
+
+        ::closedir(dir);
+        return list_result_t::listed;
+    }
+
+    // Get the modification time of the directory in seconds since the UNIX epoch
+    bool get_modified_time(const std::string &directory, int64_t &modified_time)
+    {
+        struct stat info;
+        if (::stat(directory.c_str(), &info) != 0)
+            return false;
+
+        modified_time = static_cast<int64_t>(info.st_mtime);
+        return true;
+    }
+#endif
+
+    // [TODO] Only ASCII names are folded
+    std::string fold_case(const std::string &name)
+    {
+        auto folded = name;
+        for (auto &c : folded)
+            c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+
+        return folded;
+    }
+
+    // Split the supplied path into its directory and file name.
+    void split_path(const std::string &path, std::string &directory, std::string &file_name)
+    {
+        const auto separator = path.find_last_of("/\\");
+        if (separator == std::string::npos)
+        {
+            directory = ".";
+            file_name = path;
+        }
+        else
+        {
+            // The root directory keeps its separator
+            directory = path.substr(0, (separator == 0) ? 1 : separator);
+            file_name = path.substr(separator + 1);
+        }
+    }
+}
+
+void directory_index_t::index_directory_of(const std::string &path)
+{
+    auto directory = std::string{};
+    auto file_name = std::string{};
+    split_path(path, directory, file_name);
+
+    std::lock_guard<std::mutex> lock{ _lock };
+    get_listing(directory);
+}
+
+file_lookup_t directory_index_t::lookup(const std::string &path)
+{
+    auto directory = std::string{};
+    auto file_name = std::string{};
+    split_path(path, directory, file_name);
+
+    std::lock_guard<std::mutex> lock{ _lock };
+    auto listing = &get_listing(directory);
+    if (!listing->is_listed)
+        return file_lookup_t::unknown;
+
+    if (listing->names.find(file_name) != listing->names.cend())
+        return file_lookup_t::found;
+
+    // [PERF] A miss is trusted unless the directory has changed since it was listed
+    auto modified_time = int64_t{};
+    const auto has_modified_time = get_modified_time(directory, modified_time);
+    if (listing->may_change_unobserved
+        || has_modified_time != listing->has_modified_time
+        || modified_time != listing->modified_time)
+    {
+        listing = &read_listing(directory);
+        if (!listing->is_listed)
+            return file_lookup_t::unknown;
+
+        if (listing->names.find(file_name) != listing->names.cend())
+            return file_lookup_t::found;
+    }
+
+    if (listing->folded_names.find(fold_case(file_name)) != listing->folded_names.cend())
+        return file_lookup_t::found_ignoring_case;
+
+    return file_lookup_t::missing;
+}
+
+void directory_index_t::invalidate_directory_of(const std::string &path)
+{
+    auto directory = std::string{};
+    auto file_name = std::string{};
+    split_path(path, directory, file_name);
+
+    std::lock_guard<std::mutex> lock{ _lock };
+    _directories.erase(directory);
+}
+
+directory_index_t::listing_t &directory_index_t::get_listing(const std::string &directory)
+{
+    auto iter = _directories.find(directory);
+    if (iter != _directories.end())
+        return iter->second;
+
+    return read_listing(directory);
+}
+
+directory_index_t::listing_t &directory_index_t::read_listing(const std::string &directory)
+{
+    auto listing = listing_t{};
+
+    // The modification time is read first so a change during the listing is observed later
+    listing.modified_time = 0;
+    listing.has_modified_time = get_modified_time(directory, listing.modified_time);
+    const auto result = list_directory(directory, listing.names);
+    listing.is_listed = (result != list_result_t::failed);
+
+    // A change within the same second as the last modification doesn't alter the
+    // modification time, so listings of recently modified directories aren't trusted.
+    const auto now = static_cast<int64_t>(std::time(nullptr));
+    listing.may_change_unobserved = (result == list_result_t::listed)
+        && (!listing.has_modified_time || now < (listing.modified_time + 2));
+
+    for (const auto &name : listing.names)
+        listing.folded_names.insert(fold_case(name));
+
+    if (disvm::debug::is_component_tracing_enabled<component_trace_t::module>())
+        disvm::debug::log_msg(component_trace_t::module, log_level_t::debug, "index: directory: >>%s<< %d files", directory.c_str(), static_cast<int>(listing.names.size()));
+
+    auto &entry = _directories[directory];
+    entry = std::move(listing);
+    return entry;
+}
@@ -0,0 +1,75 @@
+//
+// Dis VM
+// File: directory_index.hpp
+// Author: arr
+//
+
+#ifndef _DISVM_SRC_VM_DIRECTORY_INDEX_HPP_
+#define _DISVM_SRC_VM_DIRECTORY_INDEX_HPP_
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace disvm
+{
+    namespace util
+    {
+        // Result of looking up a file in a directory index
+        enum class file_lookup_t
+        {
+            missing,
+            found,
+            found_ignoring_case, // Only a name differing in case was found (e.g. case-insensitive file system)
+            unknown, // The directory couldn't be read
+        };
+
+        // Cache of the names of files in directories. Directories are read the first time a
+        // path in them is queried. A listing is trusted until the modification time of its
+        // directory changes or it is invalidated.
+        class directory_index_t final
+        {
+        public:
+            directory_index_t() = default;
+            directory_index_t(const directory_index_t &) = delete;
+            directory_index_t &operator=(const directory_index_t &) = delete;
+
+            // Read the listing of the directory containing the supplied path.
+            void index_directory_of(const std::string &path);
+
+            // Look up the file at the supplied path. The directory is only read again
+            // on a miss if its modification time has changed since it was listed.
+            file_lookup_t lookup(const std::string &path);
+
+            // Drop the listing of the directory containing the supplied path (e.g. an indexed file couldn't be opened).
+            void invalidate_directory_of(const std::string &path);
+
+        private:
+            struct listing_t
+            {
+                // Set if the names in the directory are known
+                bool is_listed;
+
+                // Set if the directory was modified too recently for a later change to
+                // be observed through its modification time.
+                bool may_change_unobserved;
+
+                // The modification time isn't known if the directory doesn't exist
+                bool has_modified_time;
+                int64_t modified_time;
+                std::unordered_set<std::string> names;
+                std::unordered_set<std::string> folded_names;
+            };
+
+            listing_t &get_listing(const std::string &directory);
+            listing_t &read_listing(const std::string &directory);
+
+            std::mutex _lock;
+            std::unordered_map<std::string, listing_t> _directories;
+        };
+    }
+}
+
+#endif // _DISVM_SRC_VM_DIRECTORY_INDEX_HPP_
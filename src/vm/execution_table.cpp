@@ -4,6 +4,7 @@
 // Author: arr
 //
 
+#include <cinttypes>
 #include <type_traits>
 #include <numeric>
 #include <algorithm>
@@ -21,10 +22,17 @@
 #include <builtin_module.hpp>
 #include "tool_dispatch.hpp"
 #include "execution_table.hpp"
+#include "instruction_decoder.hpp"
+#include "jit.hpp"
 
 using namespace disvm;
 using namespace disvm::runtime;
 
+#if defined(__GNUC__) || defined(__clang__)
+// Labels-as-values extension is available
+#define EXEC_COMPUTED_GOTO
+#endif
+
 namespace
 {
     //
@@ -905,7 +913,7 @@ namespace
         const auto list = at_val<vm_list_t>(r.src);
         if (list != nullptr)
         {
-            assert(list->alloc_type == vm_list_t::type_desc());
+            assert(list->alloc_type == vm_list_t::type_desc().get());
             len = list->get_length();
         }
 
@@ -1029,7 +1037,7 @@ namespace
         if (list == nullptr)
             throw dereference_nil{ "Tail of list" };
 
-        assert(list->alloc_type == vm_list_t::type_desc());
+        assert(list->alloc_type == vm_list_t::type_desc().get());
         auto tail = pointer_t{};
 
         auto tail_maybe = list->get_tail();
@@ -1105,6 +1113,8 @@ namespace
     EXEC_DECL(newcm)
     {
         auto memory_size = vt_ref<word_t>(r.src);
+
+        // Type descriptors are interned so this only allocates the first time a size is used
         auto channel_data_type = type_descriptor_t::create(memory_size);
 
         _newc_(r, vm, std::move(channel_data_type), _channel_movm);
@@ -1418,7 +1428,7 @@ namespace
         if (s == nullptr)
             return;
 
-        if (d == nullptr || !s->alloc_type->is_equal(d->alloc_type.get()))
+        if (d == nullptr || !s->alloc_type->is_equal(d->alloc_type))
             throw type_violation{};
     }
 
@@ -1446,23 +1456,107 @@ namespace
         pt_ref(r.dest) = r.stack.alloc_frame(std::move(frame_type))->base();
     }
 
+    namespace
+    {
+        // Resolved target of an inter-module call
+        struct call_target_t
+        {
+            vm_pc_t entry_pc;
+            const std::shared_ptr<const type_descriptor_t> *frame_type;
+            bool builtin;
+        };
+
+        bool try_get_cached_target(const vm_call_site_cache_t &cache, const vm_module_ref_t &target_module, word_t function_id, call_target_t &target)
+        {
+            const auto sequence = cache.sequence.load(std::memory_order_acquire);
+            if ((sequence & 1) != 0)
+                return false;
+
+            if (cache.module_ref_id.load(std::memory_order_relaxed) != target_module.instance_id
+                || cache.function_id.load(std::memory_order_relaxed) != function_id)
+                return false;
+
+            target.entry_pc = cache.entry_pc.load(std::memory_order_relaxed);
+            target.frame_type = cache.frame_type.load(std::memory_order_relaxed);
+            target.builtin = cache.builtin.load(std::memory_order_relaxed);
+
+            // Confirm the entry wasn't updated while being read
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return sequence == cache.sequence.load(std::memory_order_relaxed);
+        }
+
+        void update_cached_target(vm_call_site_cache_t &cache, const vm_module_ref_t &target_module, word_t function_id, const call_target_t &target)
+        {
+            // If another thread is updating the entry this update is dropped since
+            // the cache is not needed for correctness.
+            auto sequence = cache.sequence.load(std::memory_order_relaxed);
+            if ((sequence & 1) != 0
+                || !cache.sequence.compare_exchange_strong(sequence, sequence + 1, std::memory_order_acquire, std::memory_order_relaxed))
+                return;
+
+            std::atomic_thread_fence(std::memory_order_release);
+
+            cache.module_ref_id.store(target_module.instance_id, std::memory_order_relaxed);
+            cache.function_id.store(function_id, std::memory_order_relaxed);
+            cache.entry_pc.store(target.entry_pc, std::memory_order_relaxed);
+            cache.frame_type.store(target.frame_type, std::memory_order_relaxed);
+            cache.builtin.store(target.builtin, std::memory_order_relaxed);
+
+            cache.sequence.store(sequence + 2, std::memory_order_release);
+        }
+
+        // Resolve the target of the inter-module call at the current program counter.
+        // The call site's inline cache is consulted first and updated on a miss.
+        call_target_t resolve_call_target(const vm_registers_t &r, const vm_module_ref_t &target_module, word_t function_id)
+        {
+            assert(!r.module_ref->is_builtin_module());
+            const auto cache = r.module_ref->decoded_section[r.pc].call_site_cache;
+
+            auto target = call_target_t{};
+            if (cache != nullptr && try_get_cached_target(*cache, target_module, function_id, target))
+                return target;
+
+            const auto &types = target_module.type_section;
+            const auto &function_ref = target_module.get_function_ref(function_id);
+
+            const auto frame_type_id = function_ref.frame_type;
+            assert(0 <= frame_type_id && frame_type_id < static_cast<word_t>(types.size()));
+
+            target.entry_pc = function_ref.entry_pc;
+            target.frame_type = &types[frame_type_id];
+            target.builtin = target_module.is_builtin_module();
+
+            if (cache != nullptr)
+                update_cached_target(*cache, target_module, function_id, target);
+
+            return target;
+        }
+    }
+
     EXEC_DECL(mframe)
     {
         const auto target_module = at_val<vm_module_ref_t>(r.src);
         if (target_module == nullptr)
             throw vm_user_exception{ "Module not loaded" };
 
-        const auto &types = target_module->type_section;
-
         // Get the function ref index for this module.
         const auto function_id = vt_ref<word_t>(r.mid);
-        const auto &function_ref = target_module->get_function_ref(function_id);
+        const auto target = resolve_call_target(r, *target_module, function_id);
 
-        const auto frame_type_id = function_ref.frame_type;
-        assert(0 <= frame_type_id && frame_type_id < static_cast<word_t>(types.size()));
-        auto frame_type = types[frame_type_id];
+        pt_ref(r.dest) = r.stack.alloc_frame(*target.frame_type)->base();
+    }
 
-        pt_ref(r.dest) = r.stack.alloc_frame(std::move(frame_type))->base();
+    // Load the module data of the current module reference into the MP register.
+    // The register holds its own reference since the module data of a module reference
+    // can be replaced with a private copy (see vm_module_ref_t::make_mp_private()).
+    void load_mp(vm_registers_t &r)
+    {
+        auto mp_base = r.module_ref->mp_base.load(std::memory_order_acquire);
+        if (mp_base != nullptr)
+            mp_base->add_ref();
+
+        dec_ref_count_and_free(r.mp_base);
+        r.mp_base = mp_base;
     }
 
     EXEC_DECL(ret)
@@ -1477,14 +1571,16 @@ namespace
             r.module_ref = current_top_frame->prev_module_ref();
             current_top_frame->prev_module_ref() = nullptr;
 
-            dec_ref_count_and_free(r.mp_base);
-            r.mp_base = r.module_ref->mp_base;
+            load_mp(r);
+            r.update_mp();
         }
 
         auto new_frame = r.stack.pop_frame();
         if (new_frame == nullptr)
             r.current_thread_state = vm_thread_state_t::empty_stack;
 
+        r.update_fp();
+
         if (disvm::debug::is_component_tracing_enabled<debug::component_trace_t::stack>())
             disvm::debug::log_msg(debug::component_trace_t::stack, debug::log_level_t::debug, "exit: function");
     }
@@ -1493,6 +1589,7 @@ namespace
     {
         auto top_frame = r.stack.push_frame();
         top_frame->prev_pc() = r.next_pc;
+        r.update_fp();
 
 #ifndef NDEBUG
         // Validate the stack state
@@ -1518,12 +1615,13 @@ namespace
 
         // Get the pc for the function call into this module
         const auto export_id = vt_ref<word_t>(r.mid);
-        const auto &function_ref = target_module->get_function_ref(export_id);
-        const auto function_pc = function_ref.entry_pc;
+        const auto target = resolve_call_target(r, *target_module, export_id);
+        const auto function_pc = target.entry_pc;
         assert(static_cast<std::size_t>(function_pc) < target_module->code_section.size());
 
         // Push the next frame
         auto top_frame = r.stack.push_frame();
+        r.update_fp();
 
 #ifndef NDEBUG
         // Validate the stack state
@@ -1545,21 +1643,18 @@ namespace
                 export_id,
                 target_module->module->module_name->str(),
                 function_pc,
-                (target_module->is_builtin_module() ? "true" : "false"));
+                (target.builtin ? "true" : "false"));
         }
 
         // Set registers for execution
         r.module_ref = target_module;
         r.module_ref->add_ref();
-        r.mp_base = r.module_ref->mp_base;
+        load_mp(r);
+        r.update_mp();
         r.next_pc = function_pc;
 
-        // Non-built-in modules ref count and return
-        if (!r.module_ref->is_builtin_module())
-        {
-            r.mp_base->add_ref();
+        if (!target.builtin)
             return;
-        }
 
         // Calling into a built-in module is a bit complicated since control leaves the VM and thus
         // the callee clean-up semantics of DisVM are difficult to enforced. The solution here is
@@ -1611,8 +1706,13 @@ namespace
 
         assert(r.dest != nullptr);
         const auto pc_table = reinterpret_cast<vm_pc_t *>(r.dest);
+        const auto target_pc = pc_table[pc_index];
 
-        r.next_pc = pc_table[pc_index];
+        // The length of the table isn't encoded so modules using 'goto' aren't verified and the target is always checked.
+        if (target_pc < 0 || r.module_ref->code_section.size() <= static_cast<std::size_t>(target_pc))
+            throw vm_system_exception{ "Invalid branch target" };
+
+        r.next_pc = target_pc;
     }
 
     //
@@ -1692,7 +1792,7 @@ namespace
         const vm_string_t *exception_id;
 
         // Determine if a 'string' or 'exception' type was raised.
-        if (e->alloc_type == vm_string_t::type_desc())
+        if (e->alloc_type == vm_string_t::type_desc().get())
         {
             // String
             exception_id = static_cast<vm_string_t *>(e);
@@ -1755,11 +1855,13 @@ namespace
                     r.module_ref = curr_frame->prev_module_ref();
                     curr_frame->prev_module_ref() = nullptr;
 
-                    dec_ref_count_and_free(r.mp_base);
-                    r.mp_base = r.module_ref->mp_base;
+                    load_mp(r);
                 }
             }
             while (target_frame != r.stack.pop_frame());
+
+            r.update_fp();
+            r.update_mp();
         }
 
         // Re-initialize the current frame
@@ -1839,12 +1941,10 @@ namespace
         }
 
         auto module_import_index = vt_ref<uint32_t>(r.mid);
-        const auto &imports = importing_module->import_section;
+        assert(module_import_index < importing_module->import_section.size());
 
-        assert(module_import_index < imports.size());
-        const auto &function_imports = imports[module_import_index];
-
-        auto entry_module_ref = new vm_module_ref_t{ imported_module, function_imports };
+        auto function_refs = importing_module->import_cache.resolve(*importing_module, module_import_index, imported_module);
+        auto entry_module_ref = new vm_module_ref_t{ imported_module, std::move(function_refs) };
         pt_ref(r.dest) = entry_module_ref->get_allocation();
 
         // Check if the tool dispatcher has been supplied
@@ -1854,182 +1954,588 @@ namespace
     }
 }
 
+// Mapping of each opcode to its execution handler - must be in opcode order.
+#define EXEC_TABLE(EXEC_ENTRY) \
+    EXEC_ENTRY(invalid, invalid) \
+    EXEC_ENTRY(alt, alt) \
+    EXEC_ENTRY(nbalt, nbalt) \
+    EXEC_ENTRY(goto_, goto_) \
+    EXEC_ENTRY(call, call) \
+    EXEC_ENTRY(frame, frame) \
+    EXEC_ENTRY(spawn, spawn) \
+    EXEC_ENTRY(runt, runt) \
+    EXEC_ENTRY(load, load) \
+    EXEC_ENTRY(mcall, mcall) \
+    EXEC_ENTRY(mspawn, mspawn) \
+    EXEC_ENTRY(mframe, mframe) \
+    EXEC_ENTRY(ret, ret) \
+    EXEC_ENTRY(jmp, jmp) \
+    EXEC_ENTRY(casew, casew) \
+    EXEC_ENTRY(exit, exit) \
+    EXEC_ENTRY(new_, new_) \
+    EXEC_ENTRY(newa, newa) \
+    EXEC_ENTRY(newcb, newcb) \
+    EXEC_ENTRY(newcw, newcw) \
+    EXEC_ENTRY(newcf, newcf) \
+    EXEC_ENTRY(newcp, newcp) \
+    EXEC_ENTRY(newcm, newcm) \
+    EXEC_ENTRY(newcmp, newcmp) \
+    EXEC_ENTRY(send, send) \
+    EXEC_ENTRY(recv, recv) \
+    EXEC_ENTRY(consb, consb) \
+    EXEC_ENTRY(consw, consw) \
+    EXEC_ENTRY(consp, consp) \
+    EXEC_ENTRY(consf, consf) \
+    EXEC_ENTRY(consm, notimpl) \
+    EXEC_ENTRY(consmp, consmp) \
+    EXEC_ENTRY(headb, headb) \
+    EXEC_ENTRY(headw, headw) \
+    EXEC_ENTRY(headp, headp) \
+    EXEC_ENTRY(headf, headf) \
+    EXEC_ENTRY(headm, notimpl) \
+    EXEC_ENTRY(headmp, headmp) \
+    EXEC_ENTRY(tail, tail) \
+    EXEC_ENTRY(lea, lea) \
+    EXEC_ENTRY(indx, indx) \
+    EXEC_ENTRY(movp, movp) \
+    EXEC_ENTRY(movm, movm) \
+    EXEC_ENTRY(movmp, movmp) \
+    EXEC_ENTRY(movb, movb) \
+    EXEC_ENTRY(movw, movw) \
+    EXEC_ENTRY(movf, movf) \
+    EXEC_ENTRY(cvtbw, cvtbw) \
+    EXEC_ENTRY(cvtwb, cvtwb) \
+    EXEC_ENTRY(cvtfw, cvtfw) \
+    EXEC_ENTRY(cvtwf, cvtwf) \
+    EXEC_ENTRY(cvtca, cvtca) \
+    EXEC_ENTRY(cvtac, cvtac) \
+    EXEC_ENTRY(cvtwc, cvtwc) \
+    EXEC_ENTRY(cvtcw, cvtcw) \
+    EXEC_ENTRY(cvtfc, cvtfc) \
+    EXEC_ENTRY(cvtcf, cvtcf) \
+    EXEC_ENTRY(addb, addb) \
+    EXEC_ENTRY(addw, addw) \
+    EXEC_ENTRY(addf, addf) \
+    EXEC_ENTRY(subb, subb) \
+    EXEC_ENTRY(subw, subw) \
+    EXEC_ENTRY(subf, subf) \
+    EXEC_ENTRY(mulb, mulb) \
+    EXEC_ENTRY(mulw, mulw) \
+    EXEC_ENTRY(mulf, mulf) \
+    EXEC_ENTRY(divb, divb) \
+    EXEC_ENTRY(divw, divw) \
+    EXEC_ENTRY(divf, divf) \
+    EXEC_ENTRY(modw, modw) \
+    EXEC_ENTRY(modb, modb) \
+    EXEC_ENTRY(andb, andb) \
+    EXEC_ENTRY(andw, andw) \
+    EXEC_ENTRY(orb, orb) \
+    EXEC_ENTRY(orw, orw) \
+    EXEC_ENTRY(xorb, xorb) \
+    EXEC_ENTRY(xorw, xorw) \
+    EXEC_ENTRY(shlb, shlb) \
+    EXEC_ENTRY(shlw, shlw) \
+    EXEC_ENTRY(shrb, shrb) \
+    EXEC_ENTRY(shrw, shrw) \
+    EXEC_ENTRY(insc, insc) \
+    EXEC_ENTRY(indc, indc) \
+    EXEC_ENTRY(addc, addc) \
+    EXEC_ENTRY(lenc, lenc) \
+    EXEC_ENTRY(lena, lena) \
+    EXEC_ENTRY(lenl, lenl) \
+    EXEC_ENTRY(beqb, beqb) \
+    EXEC_ENTRY(bneb, bneb) \
+    EXEC_ENTRY(bltb, bltb) \
+    EXEC_ENTRY(bleb, bleb) \
+    EXEC_ENTRY(bgtb, bgtb) \
+    EXEC_ENTRY(bgeb, bgeb) \
+    EXEC_ENTRY(beqw, beqw) \
+    EXEC_ENTRY(bnew, bnew) \
+    EXEC_ENTRY(bltw, bltw) \
+    EXEC_ENTRY(blew, blew) \
+    EXEC_ENTRY(bgtw, bgtw) \
+    EXEC_ENTRY(bgew, bgew) \
+    EXEC_ENTRY(beqf, beqf) \
+    EXEC_ENTRY(bnef, bnef) \
+    EXEC_ENTRY(bltf, bltf) \
+    EXEC_ENTRY(blef, blef) \
+    EXEC_ENTRY(bgtf, bgtf) \
+    EXEC_ENTRY(bgef, bgef) \
+    EXEC_ENTRY(beqc, beqc) \
+    EXEC_ENTRY(bnec, bnec) \
+    EXEC_ENTRY(bltc, bltc) \
+    EXEC_ENTRY(blec, blec) \
+    EXEC_ENTRY(bgtc, bgtc) \
+    EXEC_ENTRY(bgec, bgec) \
+    EXEC_ENTRY(slicea, slicea) \
+    EXEC_ENTRY(slicela, slicela) \
+    EXEC_ENTRY(slicec, slicec) \
+    EXEC_ENTRY(indw, indw) \
+    EXEC_ENTRY(indf, indf) \
+    EXEC_ENTRY(indb, indb) \
+    EXEC_ENTRY(negf, negf) \
+    EXEC_ENTRY(movl, movl) \
+    EXEC_ENTRY(addl, addl) \
+    EXEC_ENTRY(subl, subl) \
+    EXEC_ENTRY(divl, divl) \
+    EXEC_ENTRY(modl, modl) \
+    EXEC_ENTRY(mull, mull) \
+    EXEC_ENTRY(andl, andl) \
+    EXEC_ENTRY(orl, orl) \
+    EXEC_ENTRY(xorl, xorl) \
+    EXEC_ENTRY(shll, shll) \
+    EXEC_ENTRY(shrl, shrl) \
+    EXEC_ENTRY(bnel, bnel) \
+    EXEC_ENTRY(bltl, bltl) \
+    EXEC_ENTRY(blel, blel) \
+    EXEC_ENTRY(bgtl, bgtl) \
+    EXEC_ENTRY(bgel, bgel) \
+    EXEC_ENTRY(beql, beql) \
+    EXEC_ENTRY(cvtlf, cvtlf) \
+    EXEC_ENTRY(cvtfl, cvtfl) \
+    EXEC_ENTRY(cvtlw, cvtlw) \
+    EXEC_ENTRY(cvtwl, cvtwl) \
+    EXEC_ENTRY(cvtlc, cvtlc) \
+    EXEC_ENTRY(cvtcl, cvtcl) \
+    EXEC_ENTRY(headl, headl) \
+    EXEC_ENTRY(consl, consl) \
+    EXEC_ENTRY(newcl, newcl) \
+    EXEC_ENTRY(casec, casec) \
+    EXEC_ENTRY(indl, indl) \
+    EXEC_ENTRY(movpc, notimpl) \
+    EXEC_ENTRY(tcmp, tcmp) \
+    EXEC_ENTRY(mnewz, mnewz) \
+    EXEC_ENTRY(cvtrf, cvtrf) \
+    EXEC_ENTRY(cvtfr, cvtfr) \
+    EXEC_ENTRY(cvtws, cvtws) \
+    EXEC_ENTRY(cvtsw, cvtsw) \
+    EXEC_ENTRY(lsrw, lsrw) \
+    EXEC_ENTRY(lsrl, lsrl) \
+    EXEC_ENTRY(eclr, eclr) \
+    EXEC_ENTRY(newz, newz) \
+    EXEC_ENTRY(newaz, newaz) \
+    EXEC_ENTRY(raise, raise) \
+    EXEC_ENTRY(casel, casel) \
+    EXEC_ENTRY(mulx, mulx) \
+    EXEC_ENTRY(divx, divx) \
+    EXEC_ENTRY(cvtxx, cvtxx) \
+    EXEC_ENTRY(mulx0, mulx0) \
+    EXEC_ENTRY(divx0, divx0) \
+    EXEC_ENTRY(cvtxx0, cvtxx0) \
+    EXEC_ENTRY(mulx1, notimpl) \
+    EXEC_ENTRY(divx1, notimpl) \
+    EXEC_ENTRY(cvtxx1, notimpl) \
+    EXEC_ENTRY(cvtfx, cvtfx) \
+    EXEC_ENTRY(cvtxf, cvtxf) \
+    EXEC_ENTRY(expw, expw) \
+    EXEC_ENTRY(expl, expl) \
+    EXEC_ENTRY(expf, expf) \
+    EXEC_ENTRY(self, notimpl) \
+    EXEC_ENTRY(brkpt, brkpt)
+
+#define EXEC_TABLE_HANDLER(op, fn) fn,
 const vm_exec_t disvm::runtime::vm_exec_table[static_cast<std::size_t>(opcode_t::last_opcode) + 1] =
 {
-    invalid,
-    alt,
-    nbalt,
-    goto_,
-    call,
-    frame,
-    spawn,
-    runt,
-    load,
-    mcall,
-    mspawn,
-    mframe,
-    ret,
-    jmp,
-    casew,
-    exit,
-    new_,
-    newa,
-    newcb,
-    newcw,
-    newcf,
-    newcp,
-    newcm,
-    newcmp,
-    send,
-    recv,
-    consb,
-    consw,
-    consp,
-    consf,
-    notimpl, // consm,
-    consmp,
-    headb,
-    headw,
-    headp,
-    headf,
-    notimpl, // headm,
-    headmp,
-    tail,
-    lea,
-    indx,
-    movp,
-    movm,
-    movmp,
-    movb,
-    movw,
-    movf,
-    cvtbw,
-    cvtwb,
-    cvtfw,
-    cvtwf,
-    cvtca,
-    cvtac,
-    cvtwc,
-    cvtcw,
-    cvtfc,
-    cvtcf,
-    addb,
-    addw,
-    addf,
-    subb,
-    subw,
-    subf,
-    mulb,
-    mulw,
-    mulf,
-    divb,
-    divw,
-    divf,
-    modw,
-    modb,
-    andb,
-    andw,
-    orb,
-    orw,
-    xorb,
-    xorw,
-    shlb,
-    shlw,
-    shrb,
-    shrw,
-    insc,
-    indc,
-    addc,
-    lenc,
-    lena,
-    lenl,
-    beqb,
-    bneb,
-    bltb,
-    bleb,
-    bgtb,
-    bgeb,
-    beqw,
-    bnew,
-    bltw,
-    blew,
-    bgtw,
-    bgew,
-    beqf,
-    bnef,
-    bltf,
-    blef,
-    bgtf,
-    bgef,
-    beqc,
-    bnec,
-    bltc,
-    blec,
-    bgtc,
-    bgec,
-    slicea,
-    slicela,
-    slicec,
-    indw,
-    indf,
-    indb,
-    negf,
-    movl,
-    addl,
-    subl,
-    divl,
-    modl,
-    mull,
-    andl,
-    orl,
-    xorl,
-    shll,
-    shrl,
-    bnel,
-    bltl,
-    blel,
-    bgtl,
-    bgel,
-    beql,
-    cvtlf,
-    cvtfl,
-    cvtlw,
-    cvtwl,
-    cvtlc,
-    cvtcl,
-    headl,
-    consl,
-    newcl,
-    casec,
-    indl,
-    notimpl, // movpc,
-    tcmp,
-    mnewz,
-    cvtrf,
-    cvtfr,
-    cvtws,
-    cvtsw,
-    lsrw,
-    lsrl,
-    eclr,
-    newz,
-    newaz,
-    raise,
-    casel,
-    mulx,
-    divx,
-    cvtxx,
-    mulx0,
-    divx0,
-    cvtxx0,
-    notimpl, // mulx1,
-    notimpl, // divx1,
-    notimpl, // cvtxx1,
-    cvtfx,
-    cvtxf,
-    expw,
-    expl,
-    expf,
-    notimpl, // self,
-    brkpt,
+    EXEC_TABLE(EXEC_TABLE_HANDLER)
 };
+#undef EXEC_TABLE_HANDLER
+
+// Instruction sequences fused into superinstructions - longest sequences first.
+// Sequences are taken from opcode sequence profiles of Limbo compiled modules (see 'disvm-exec -p').
+// Only the last instruction in a sequence may be a call or a blocking instruction.
+#define SUPERINSTRUCTION_TABLE(SUPER_ENTRY) \
+    SUPER_ENTRY(frame_movw_call, opcode_t::frame, opcode_t::movw, opcode_t::call) \
+    SUPER_ENTRY(mframe_movw_mcall, opcode_t::mframe, opcode_t::movw, opcode_t::mcall) \
+    SUPER_ENTRY(movw_movw, opcode_t::movw, opcode_t::movw) \
+    SUPER_ENTRY(movw_addw, opcode_t::movw, opcode_t::addw) \
+    SUPER_ENTRY(addw_bltw, opcode_t::addw, opcode_t::bltw) \
+    SUPER_ENTRY(addw_jmp, opcode_t::addw, opcode_t::jmp) \
+    SUPER_ENTRY(beqw_beqw, opcode_t::beqw, opcode_t::beqw) \
+    SUPER_ENTRY(bnew_bnew, opcode_t::bnew, opcode_t::bnew) \
+    SUPER_ENTRY(movp_movp, opcode_t::movp, opcode_t::movp) \
+    SUPER_ENTRY(frame_call, opcode_t::frame, opcode_t::call) \
+    SUPER_ENTRY(mframe_mcall, opcode_t::mframe, opcode_t::mcall)
+
+namespace
+{
+    // Execution handler of an opcode resolved at compile time
+    template<opcode_t Op>
+    struct exec_handler_t;
+
+#define EXEC_HANDLER_SPECIALIZATION(op, fn) \
+    template<> \
+    struct exec_handler_t<opcode_t::op> \
+    { \
+        static void exec(vm_registers_t &r, vm_t &vm) { fn(r, vm); } \
+    };
+
+    EXEC_TABLE(EXEC_HANDLER_SPECIALIZATION)
+#undef EXEC_HANDLER_SPECIALIZATION
+
+    template<opcode_t... Ops>
+    struct superinstruction_t;
+
+    template<opcode_t Last>
+    struct superinstruction_t<Last>
+    {
+        static constexpr std::size_t length = 1;
+        static constexpr vm_preemption_t preemption = get_preemption(Last);
+
+        static void exec(vm_registers_t &r, vm_t &vm)
+        {
+            exec_handler_t<Last>::exec(r, vm);
+        }
+    };
+
+    template<opcode_t First, opcode_t Second, opcode_t... Rest>
+    struct superinstruction_t<First, Second, Rest...>
+    {
+        static_assert(get_preemption(First) != vm_preemption_t::always, "Only the last instruction of a superinstruction can leave the current function or block");
+
+        using rest_t = superinstruction_t<Second, Rest...>;
+
+        static constexpr std::size_t length = rest_t::length + 1;
+        static constexpr vm_preemption_t preemption = (get_preemption(First) < rest_t::preemption) ? rest_t::preemption : get_preemption(First);
+
+        static void exec(vm_registers_t &r, vm_t &vm)
+        {
+            exec_handler_t<First>::exec(r, vm);
+
+            // A taken branch leaves the sequence
+            if (get_preemption(First) == vm_preemption_t::back_edge && r.next_pc != (r.pc + 1))
+                return;
+
+            // Decode the next instruction - it keeps its own pre-decoded entry since it may also be a branch target.
+            r.pc = r.next_pc;
+            const auto &next = r.module_ref->decoded_section[r.pc];
+            next.decode.load(std::memory_order_acquire)(next, r);
+            r.next_pc = (r.pc + 1);
+
+            rest_t::exec(r, vm);
+        }
+    };
+
+    enum class superinstruction_id_t : std::size_t
+    {
+#define SUPER_ID(name, ...) name,
+        SUPERINSTRUCTION_TABLE(SUPER_ID)
+#undef SUPER_ID
+        count
+    };
+
+    static_assert((static_cast<std::size_t>(opcode_t::last_opcode) + static_cast<std::size_t>(superinstruction_id_t::count)) <= std::numeric_limits<std::underlying_type_t<opcode_t>>::max(), "Superinstruction opcodes must be representable");
+
+    constexpr opcode_t superinstruction_opcode(superinstruction_id_t id)
+    {
+        return static_cast<opcode_t>(static_cast<std::size_t>(opcode_t::last_opcode) + 1 + static_cast<std::size_t>(id));
+    }
+}
+
+#define SUPER_TABLE_ENTRY(name, ...) \
+    { \
+        superinstruction_opcode(superinstruction_id_t::name), \
+        superinstruction_t<__VA_ARGS__>::exec, \
+        superinstruction_t<__VA_ARGS__>::preemption, \
+        superinstruction_t<__VA_ARGS__>::length, \
+        { __VA_ARGS__ } \
+    },
+const vm_superinstruction_t disvm::runtime::vm_superinstruction_table[] =
+{
+    SUPERINSTRUCTION_TABLE(SUPER_TABLE_ENTRY)
+};
+#undef SUPER_TABLE_ENTRY
+
+const std::size_t disvm::runtime::vm_superinstruction_count = static_cast<std::size_t>(superinstruction_id_t::count);
+
+namespace
+{
+    struct execute_with_tool_t final
+    {
+        static void begin_exec_loop(vm_registers_t &r, vm_t &)
+        {
+            auto tool_dispatch = r.tool_dispatch.load();
+            assert(tool_dispatch != nullptr);
+
+            tool_dispatch->block_if_thread_suspended(r.thread.get_thread_id());
+        }
+
+        static void after_exec(vm_registers_t &r, vm_t &)
+        {
+            if (r.trap_flags == vm_trap_flags_t::none
+                || !disvm::util::has_flag(r.trap_flags, vm_trap_flags_t::instruction))
+                return;
+
+            auto tool_dispatch = r.tool_dispatch.load();
+            assert(tool_dispatch != nullptr);
+
+            tool_dispatch->on_trap(r, vm_trap_flags_t::instruction);
+        }
+
+        // Tools observe (e.g. single step, breakpoint) individual instructions so
+        // only the first instruction of a superinstruction is executed.
+        static opcode_t get_opcode(const vm_decoded_inst_t &inst, const vm_registers_t &r)
+        {
+            if (!is_superinstruction(inst.opcode))
+                return inst.opcode;
+
+            return r.module_ref->module->code_section[r.pc].op.opcode;
+        }
+
+        static bool leave_exec_loop(vm_registers_t &r, vm_preemption_t preemption, vm_pc_t pc)
+        {
+            return is_preempted(r, preemption, pc);
+        }
+    };
+
+    struct execute_normal_t final
+    {
+        static void begin_exec_loop(vm_registers_t &, vm_t &) { }
+        static void after_exec(vm_registers_t &, vm_t &) { }
+        static opcode_t get_opcode(const vm_decoded_inst_t &inst, const vm_registers_t &) { return inst.opcode; }
+        static bool leave_exec_loop(vm_registers_t &r, vm_preemption_t preemption, vm_pc_t pc) { return is_preempted(r, preemption, pc); }
+    };
+
+    // Records module hotness at back-edges and calls, and leaves the interpreter loop
+    // once the current module has native code that should be entered.
+    struct execute_native_t final
+    {
+        static void begin_exec_loop(vm_registers_t &, vm_t &) { }
+        static void after_exec(vm_registers_t &, vm_t &) { }
+        static opcode_t get_opcode(const vm_decoded_inst_t &inst, const vm_registers_t &) { return inst.opcode; }
+
+        static bool leave_exec_loop(vm_registers_t &r, vm_preemption_t preemption, vm_pc_t pc)
+        {
+            if (is_preempted(r, preemption, pc))
+                return true;
+
+            // Forward branches aren't back-edges
+            if (preemption == vm_preemption_t::back_edge && pc < r.pc)
+                return false;
+
+            auto native_code = r.module_ref->module->native_code.get();
+            return (native_code != nullptr && native_code->is_hot());
+        }
+    };
+
+    // Fetch the instruction at the current pc and update the VM registers based on it.
+    const vm_decoded_inst_t &fetch_and_decode(vm_registers_t &r)
+    {
+        assert(r.stack.peek_frame() != nullptr && "Thread state should not be running with empty stack");
+        assert(!r.module_ref->is_builtin_module() && "Interpreter thread is unable to execute native instructions");
+
+        const auto &decoded_section = r.module_ref->decoded_section;
+        assert(static_cast<std::size_t>(r.pc) < decoded_section.size());
+
+        // The instruction was validated and resolved when the module was loaded
+        const auto &inst = decoded_section[r.pc];
+        inst.decode.load(std::memory_order_acquire)(inst, r);
+
+#ifndef NDEBUG
+        // This is a perf critical function so logging is only available in debug builds
+        if (disvm::debug::is_component_tracing_enabled<debug::component_trace_t::addressing>())
+        {
+            disvm::debug::log_msg(
+                debug::component_trace_t::addressing,
+                debug::log_level_t::debug,
+                "decode: registers: %d (%#" PRIxPTR " %#" PRIxPTR " %#" PRIxPTR ")",
+                inst.opcode,
+                r.src,
+                r.mid,
+                r.dest);
+        }
+#endif
+
+        r.next_pc = (r.pc + 1);
+        return inst;
+    }
+
+    template<typename EXEC_DETOUR>
+    void execute_call_threaded(vm_registers_t &r, vm_t &vm)
+    {
+        if (0 == r.current_thread_quanta)
+            return;
+
+        for (;;)
+        {
+            EXEC_DETOUR::begin_exec_loop(r, vm);
+
+            const auto pc = r.pc;
+            const auto &inst = fetch_and_decode(r);
+            const auto opcode = EXEC_DETOUR::get_opcode(inst, r);
+
+            // The instruction may release the last reference to its module
+            const auto preemption = (opcode == inst.opcode) ? inst.preemption : get_preemption(opcode);
+            const auto exec = (opcode == inst.opcode) ? inst.exec : vm_exec_table[static_cast<std::size_t>(opcode)];
+            exec(r, vm);
+            r.pc = r.next_pc;
+
+            EXEC_DETOUR::after_exec(r, vm);
+
+            if (preemption != vm_preemption_t::none && EXEC_DETOUR::leave_exec_loop(r, preemption, pc))
+                break;
+        }
+    }
+
+    template<typename EXEC_DETOUR>
+    void execute_switch(vm_registers_t &r, vm_t &vm)
+    {
+        if (0 == r.current_thread_quanta)
+            return;
+
+        for (;;)
+        {
+            EXEC_DETOUR::begin_exec_loop(r, vm);
+
+            const auto pc = r.pc;
+            const auto &inst = fetch_and_decode(r);
+
+            // Instructions that aren't preemption points continue without charging the quanta
+            switch (static_cast<std::size_t>(EXEC_DETOUR::get_opcode(inst, r)))
+            {
+#define EXEC_SWITCH_CASE(op, fn) \
+            case static_cast<std::size_t>(opcode_t::op): \
+                fn(r, vm); \
+                r.pc = r.next_pc; \
+                EXEC_DETOUR::after_exec(r, vm); \
+                if (get_preemption(opcode_t::op) != vm_preemption_t::none && EXEC_DETOUR::leave_exec_loop(r, get_preemption(opcode_t::op), pc)) \
+                    return; \
+                continue;
+
+                EXEC_TABLE(EXEC_SWITCH_CASE)
+#undef EXEC_SWITCH_CASE
+
+#define SUPER_SWITCH_CASE(name, ...) \
+            case static_cast<std::size_t>(superinstruction_opcode(superinstruction_id_t::name)): \
+                superinstruction_t<__VA_ARGS__>::exec(r, vm); \
+                r.pc = r.next_pc; \
+                EXEC_DETOUR::after_exec(r, vm); \
+                if (superinstruction_t<__VA_ARGS__>::preemption != vm_preemption_t::none && EXEC_DETOUR::leave_exec_loop(r, superinstruction_t<__VA_ARGS__>::preemption, pc)) \
+                    return; \
+                continue;
+
+                SUPERINSTRUCTION_TABLE(SUPER_SWITCH_CASE)
+#undef SUPER_SWITCH_CASE
+            default:
+                invalid(r, vm);
+            }
+        }
+    }
+
+#ifdef EXEC_COMPUTED_GOTO
+    template<typename EXEC_DETOUR>
+    void execute_direct_threaded(vm_registers_t &r, vm_t &vm)
+    {
+#define EXEC_LABEL_ADDRESS(op, fn) &&exec_##op,
+#define SUPER_LABEL_ADDRESS(name, ...) &&super_##name,
+        static void * const labels[] = { EXEC_TABLE(EXEC_LABEL_ADDRESS) SUPERINSTRUCTION_TABLE(SUPER_LABEL_ADDRESS) };
+#undef SUPER_LABEL_ADDRESS
+#undef EXEC_LABEL_ADDRESS
+
+        if (0 == r.current_thread_quanta)
+            return;
+
+        auto pc = vm_pc_t{};
+
+        // Each handler has its own copy of the dispatch so the branch predictor
+        // is able to learn opcode sequences.
+#define EXEC_DISPATCH_NEXT() \
+        EXEC_DETOUR::begin_exec_loop(r, vm); \
+        goto *labels[static_cast<std::size_t>(EXEC_DETOUR::get_opcode(fetch_and_decode(r), r))]
+
+        EXEC_DISPATCH_NEXT();
+
+#define EXEC_LABEL(op, fn) \
+    exec_##op: \
+        pc = r.pc; \
+        fn(r, vm); \
+        r.pc = r.next_pc; \
+        EXEC_DETOUR::after_exec(r, vm); \
+        if (get_preemption(opcode_t::op) != vm_preemption_t::none && EXEC_DETOUR::leave_exec_loop(r, get_preemption(opcode_t::op), pc)) \
+            return; \
+        EXEC_DISPATCH_NEXT();
+
+        EXEC_TABLE(EXEC_LABEL)
+
+#define SUPER_LABEL(name, ...) \
+    super_##name: \
+        pc = r.pc; \
+        superinstruction_t<__VA_ARGS__>::exec(r, vm); \
+        r.pc = r.next_pc; \
+        EXEC_DETOUR::after_exec(r, vm); \
+        if (superinstruction_t<__VA_ARGS__>::preemption != vm_preemption_t::none && EXEC_DETOUR::leave_exec_loop(r, superinstruction_t<__VA_ARGS__>::preemption, pc)) \
+            return; \
+        EXEC_DISPATCH_NEXT();
+
+        SUPERINSTRUCTION_TABLE(SUPER_LABEL)
+
+#undef SUPER_LABEL
+#undef EXEC_LABEL
+#undef EXEC_DISPATCH_NEXT
+    }
+#endif
+
+    // Transfers control to native code for compiled modules, otherwise runs the
+    // supplied interpreter loop until a back-edge or call in a hot module.
+    template<vm_interpreter_t INTERPRETER>
+    void execute_with_native(vm_registers_t &r, vm_t &vm)
+    {
+        while (0 != r.current_thread_quanta)
+        {
+            // Native code consumes thread quanta itself
+            auto native_code = r.module_ref->module->native_code.get();
+            if (native_code == nullptr || !native_code->try_execute(r, vm))
+                INTERPRETER(r, vm);
+
+            if (r.current_thread_state != vm_thread_state_t::running)
+                break;
+        }
+    }
+}
+
+vm_dispatch_strategy_t disvm::runtime::get_supported_dispatch_strategy(vm_dispatch_strategy_t strategy)
+{
+#ifndef EXEC_COMPUTED_GOTO
+    if (strategy == vm_dispatch_strategy_t::direct_threaded)
+        return vm_dispatch_strategy_t::switch_table;
+#endif
+
+    return strategy;
+}
+
+vm_interpreter_t disvm::runtime::get_interpreter(vm_dispatch_strategy_t strategy, bool with_tool, bool with_native)
+{
+    // [TODO] Tools patch the decoded section (e.g. breakpoints) and single step
+    // instructions, so native code is only entered when no tool is attached.
+    if (with_native && !with_tool)
+    {
+        switch (strategy)
+        {
+        case vm_dispatch_strategy_t::direct_threaded:
+#ifdef EXEC_COMPUTED_GOTO
+            return execute_with_native<execute_direct_threaded<execute_native_t>>;
+#endif
+            // Fall back to the switch dispatch
+        case vm_dispatch_strategy_t::switch_table:
+            return execute_with_native<execute_switch<execute_native_t>>;
+        case vm_dispatch_strategy_t::call_threaded:
+            return execute_with_native<execute_call_threaded<execute_native_t>>;
+        default:
+            throw vm_system_exception{ "Unknown interpreter dispatch strategy" };
+        }
+    }
+
+    switch (strategy)
+    {
+    case vm_dispatch_strategy_t::direct_threaded:
+#ifdef EXEC_COMPUTED_GOTO
+        return with_tool ? execute_direct_threaded<execute_with_tool_t> : execute_direct_threaded<execute_normal_t>;
+#endif
+        // Fall back to the switch dispatch
+    case vm_dispatch_strategy_t::switch_table:
+        return with_tool ? execute_switch<execute_with_tool_t> : execute_switch<execute_normal_t>;
+    case vm_dispatch_strategy_t::call_threaded:
+        return with_tool ? execute_call_threaded<execute_with_tool_t> : execute_call_threaded<execute_normal_t>;
+    default:
+        throw vm_system_exception{ "Unknown interpreter dispatch strategy" };
+    }
+}
@@ -7,6 +7,7 @@
 #ifndef _DISVM_SRC_VM_EXECUTION_TABLE_HPP_
 #define _DISVM_SRC_VM_EXECUTION_TABLE_HPP_
 
+#include <cstdint>
 #include "runtime.hpp"
 
 namespace disvm
@@ -15,6 +16,61 @@ namespace disvm
     {
         // VM instruction execution table
         extern const vm_exec_t vm_exec_table[];
+
+        // Maximum number of instructions executed by a superinstruction
+        const std::size_t vm_superinstruction_max_length = 3;
+
+        // Superinstruction - a sequence of instructions executed with a single dispatch.
+        // Superinstructions only exist in the pre-decoded form and are identified by opcodes following 'last_opcode'.
+        struct vm_superinstruction_t
+        {
+            opcode_t opcode;
+            vm_exec_t exec;
+            vm_preemption_t preemption;
+            std::size_t length;
+            opcode_t sequence[vm_superinstruction_max_length];
+        };
+
+        // Superinstructions ordered from the longest sequence to the shortest
+        extern const vm_superinstruction_t vm_superinstruction_table[];
+        extern const std::size_t vm_superinstruction_count;
+
+        // Returns 'true' if the supplied pre-decoded opcode is a superinstruction.
+        inline bool is_superinstruction(opcode_t opcode)
+        {
+            return opcode > opcode_t::last_opcode;
+        }
+
+        // Charge the thread quanta for the instruction that was executed at the supplied program counter.
+        // Returns 'true' if the thread quanta is consumed or the thread is no longer running.
+        inline bool is_preempted(vm_registers_t &r, vm_preemption_t preemption, vm_pc_t pc)
+        {
+            if (preemption == vm_preemption_t::back_edge)
+            {
+                // Forward branches don't need to be charged
+                if (pc < r.pc)
+                    return false;
+            }
+            else if (r.current_thread_state != vm_thread_state_t::running)
+            {
+                return true;
+            }
+
+            return (0 == --r.current_thread_quanta);
+        }
+
+        // Interpreter loop - executes instructions until the thread quanta
+        // is consumed or the thread is no longer running.
+        // The quanta is only charged at back-edges, calls, and blocking instructions.
+        using vm_interpreter_t = void(*)(vm_registers_t &, vm_t &);
+
+        // Get the dispatch strategy used for the supplied strategy by this build of the VM.
+        vm_dispatch_strategy_t get_supported_dispatch_strategy(vm_dispatch_strategy_t strategy);
+
+        // Get the interpreter loop for the supplied dispatch strategy.
+        // The tool variant services the thread's tool dispatcher between instructions.
+        // The native variant enters compiled code for modules that have been compiled.
+        vm_interpreter_t get_interpreter(vm_dispatch_strategy_t strategy, bool with_tool, bool with_native);
     }
 }
 
@@ -11,6 +11,7 @@
 #include <vm_memory.hpp>
 #include <exceptions.hpp>
 #include "garbage_collector.hpp"
+#include "slab_allocator.hpp"
 
 using disvm::vm_t;
 
@@ -86,12 +87,12 @@ namespace
 
     gc_colour_t get_gc_colour(const vm_alloc_t *a)
     {
-        return *reinterpret_cast<const gc_colour_t *>(&a->gc_reserved);
+        return static_cast<gc_colour_t>(a->get_gc_reserved());
     }
 
     void set_gc_colour(vm_alloc_t *a, const gc_colour_t c)
     {
-        a->gc_reserved = reinterpret_cast<pointer_t>(c);
+        a->set_gc_reserved(static_cast<uint32_t>(c));
     }
 
     class mark_cxt_t final : public std::stack<vm_alloc_t *, std::vector<vm_alloc_t *>>
@@ -131,7 +132,7 @@ default_garbage_collector_t::~default_garbage_collector_t()
 
 vm_memory_allocator_t default_garbage_collector_t::get_allocator() const
 {
-    return{ std::calloc, std::free };
+    return disvm::runtime::get_slab_allocator();
 }
 
 void default_garbage_collector_t::track_allocation(vm_alloc_t *alloc)
@@ -174,25 +175,8 @@ namespace
         assert(data != nullptr);
 
         auto memory = reinterpret_cast<pointer_t *>(data);
-        for (auto i = word_t{ 0 }; i < type_desc.map_in_bytes; ++i, memory += 8)
-        {
-            const auto words8 = type_desc.pointer_map[i];
-            assert(sizeof(words8) == 1);
-            if (words8 == 0)
-                continue;
-
-            const auto flags = std::bitset<sizeof(words8) * 8>{ words8 };
-
-            // Enumerating the flags in reverse order so memory access is sequential.
-            if (flags[7]) mark_pointer_maybe(memory[0], cxt);
-            if (flags[6]) mark_pointer_maybe(memory[1], cxt);
-            if (flags[5]) mark_pointer_maybe(memory[2], cxt);
-            if (flags[4]) mark_pointer_maybe(memory[3], cxt);
-            if (flags[3]) mark_pointer_maybe(memory[4], cxt);
-            if (flags[2]) mark_pointer_maybe(memory[5], cxt);
-            if (flags[1]) mark_pointer_maybe(memory[6], cxt);
-            if (flags[0]) mark_pointer_maybe(memory[7], cxt);
-        }
+        for (auto i = word_t{ 0 }; i < type_desc.pointer_count; ++i)
+            mark_pointer_maybe(memory[type_desc.pointer_offsets[i]], cxt);
     }
 
     void mark(std::vector<std::shared_ptr<const vm_thread_t>> threads, mark_cxt_t &mark_cxt)
@@ -211,7 +195,7 @@ namespace
                 // Previous MP
                 if (frame->prev_module_ref() != nullptr)
                 {
-                    auto prev_mp = frame->prev_module_ref()->mp_base;
+                    auto prev_mp = frame->prev_module_ref()->mp_base.load();
                     mark_cxt.push(prev_mp);
                 }
 
@@ -0,0 +1,676 @@
+//
+// Dis VM
+// File: instruction_decoder.cpp
+// Author: arr
+//
+
+#include <cassert>
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <disvm.hpp>
+#include <opcodes.hpp>
+#include <utils.hpp>
+#include <vm_memory.hpp>
+#include <debug.hpp>
+#include <exceptions.hpp>
+#include "execution_table.hpp"
+#include "instruction_decoder.hpp"
+#include "tool_dispatch.hpp"
+
+using disvm::opcode_t;
+
+using disvm::debug::component_trace_t;
+using disvm::debug::log_level_t;
+
+using disvm::runtime::byte_t;
+using disvm::runtime::short_word_t;
+using disvm::runtime::word_t;
+using disvm::runtime::big_t;
+using disvm::runtime::short_real_t;
+using disvm::runtime::real_t;
+using disvm::runtime::pointer_t;
+using disvm::runtime::vm_pc_t;
+using disvm::runtime::vm_exec_op_t;
+using disvm::runtime::vm_decode_t;
+using disvm::runtime::vm_decoded_inst_t;
+using disvm::runtime::vm_call_site_cache_t;
+using disvm::runtime::vm_superinstruction_t;
+using disvm::runtime::code_section_t;
+using disvm::runtime::decoded_section_t;
+using disvm::runtime::vm_module_t;
+using disvm::runtime::vm_module_ref_t;
+using disvm::runtime::vm_registers_t;
+using disvm::runtime::vm_system_exception;
+using disvm::runtime::type_operand_t;
+using disvm::runtime::operand_widths_t;
+using disvm::runtime::runtime_flags_t;
+using disvm::runtime::address_mode_t;
+using disvm::runtime::address_mode_middle_t;
+
+namespace
+{
+#include "address_decoding.inc"
+
+    //
+    // Operand checks for modules that failed verification
+    //
+
+    void check_offset(word_t offset, std::size_t size, std::size_t access_size)
+    {
+        if (offset < 0 || size < access_size || (size - access_size) < static_cast<std::size_t>(offset))
+            throw vm_system_exception{ "Operand offset outside of frame or module data" };
+    }
+
+    std::size_t get_frame_size(const vm_registers_t &r)
+    {
+        return r.stack.peek_frame()->frame_type->size_in_bytes;
+    }
+
+    std::size_t get_mp_size(const vm_registers_t &r)
+    {
+        return (r.mp_base != nullptr) ? r.mp_base->alloc_type->size_in_bytes : 0;
+    }
+
+    void check_operand(address_mode_t mode, word_t register1, std::size_t width, const vm_registers_t &r)
+    {
+        switch (mode)
+        {
+        case address_mode_t::offset_indirect_fp:
+            check_offset(register1, get_frame_size(r), width);
+            break;
+        case address_mode_t::offset_double_indirect_fp:
+            check_offset(register1, get_frame_size(r), sizeof(pointer_t));
+            break;
+        case address_mode_t::offset_indirect_mp:
+            check_offset(register1, get_mp_size(r), width);
+            break;
+        case address_mode_t::offset_double_indirect_mp:
+            check_offset(register1, get_mp_size(r), sizeof(pointer_t));
+            break;
+        case address_mode_t::immediate:
+        case address_mode_t::none:
+            break;
+        default:
+            throw vm_system_exception{ "Illegal Dis VM addressing mode" };
+        }
+    }
+
+    void check_middle_operand(address_mode_middle_t mode, word_t register1, std::size_t width, const vm_registers_t &r)
+    {
+        switch (mode)
+        {
+        case address_mode_middle_t::small_offset_indirect_fp:
+            check_offset(register1, get_frame_size(r), width);
+            break;
+        case address_mode_middle_t::small_offset_indirect_mp:
+            check_offset(register1, get_mp_size(r), width);
+            break;
+        default:
+            break;
+        }
+    }
+
+    void check_type_id(pointer_t operand, const vm_module_ref_t &module_ref)
+    {
+        const auto type_id = *reinterpret_cast<const word_t *>(operand);
+        if (type_id < 0 || module_ref.type_section.size() <= static_cast<std::size_t>(type_id))
+            throw vm_system_exception{ "Invalid type ID" };
+    }
+
+    void check_pc(big_t pc, const vm_module_ref_t &module_ref)
+    {
+        if (pc < 0 || module_ref.code_section.size() <= static_cast<std::size_t>(pc))
+            throw vm_system_exception{ "Invalid branch target" };
+    }
+
+    // Case tables are laid out as: count, (low, high, pc) * count, default pc
+    template<typename T>
+    void check_case_table(const vm_registers_t &r)
+    {
+        const auto mp_begin = reinterpret_cast<const uint8_t *>(r.mp);
+        const auto table = reinterpret_cast<const uint8_t *>(r.dest);
+        if (table == nullptr || mp_begin == nullptr || table < mp_begin)
+            throw vm_system_exception{ "Case table outside of module data" };
+
+        const auto available = get_mp_size(r) - static_cast<std::size_t>(table - mp_begin);
+        const auto entries = reinterpret_cast<const T *>(table);
+        const auto count = entries[0];
+        if (available < (2 * sizeof(T)) || count < 0 || ((available / sizeof(T)) - 2) / 3 < static_cast<std::size_t>(count))
+            throw vm_system_exception{ "Case table outside of module data" };
+
+        for (auto i = std::size_t{ 0 }; i < static_cast<std::size_t>(count); ++i)
+            check_pc(entries[1 + (i * 3) + 2], *r.module_ref);
+
+        check_pc(entries[1 + (count * 3)], *r.module_ref);
+    }
+
+    // Get the size of the block of memory accessed through the memory operands of an instruction (e.g. 'movm').
+    // The size is either the middle operand or the size of the type it identifies. Type IDs must be checked first.
+    std::size_t get_memory_size(opcode_t opcode, const vm_registers_t &r)
+    {
+        const auto value = *reinterpret_cast<const word_t *>(r.mid);
+        if (disvm::runtime::get_type_operand(opcode) == type_operand_t::middle)
+            return static_cast<std::size_t>(r.module_ref->type_section[value]->size_in_bytes);
+
+        if (value < 0)
+            throw vm_system_exception{ "Invalid memory operand size" };
+
+        return static_cast<std::size_t>(value);
+    }
+
+    void decode_checked(const vm_decoded_inst_t &inst, vm_registers_t &r)
+    {
+        assert(r.module_ref != nullptr);
+        const auto &op = r.module_ref->code_section[r.pc].op;
+
+        // A breakpoint executes the instruction it replaced
+        auto opcode = op.opcode;
+        if (opcode == opcode_t::brkpt)
+        {
+            auto tool_dispatch = r.tool_dispatch.load();
+            if (tool_dispatch == nullptr)
+                throw vm_system_exception{ "Breakpoint set but no tool(s) loaded" };
+
+            opcode = tool_dispatch->get_original_opcode(r);
+        }
+
+        // Memory operands are checked once their size is known
+        auto widths = disvm::runtime::get_operand_widths(opcode);
+        if (op.middle_mode() == address_mode_middle_t::none && widths.destination != 0)
+            widths.destination = std::max(widths.destination, widths.middle);
+
+        const auto source = op.source();
+        const auto destination = op.destination();
+        check_operand(source.mode, source.register1, widths.source, r);
+        check_middle_operand(op.middle_mode(), op.mid, widths.middle, r);
+        check_operand(destination.mode, destination.register1, widths.destination, r);
+
+        decode_table[op.addr_code](inst, r);
+
+        switch (disvm::runtime::get_type_operand(opcode))
+        {
+        case type_operand_t::source:
+            check_type_id(r.src, *r.module_ref);
+            break;
+        case type_operand_t::middle:
+            check_type_id(r.mid, *r.module_ref);
+            break;
+        case type_operand_t::none:
+            break;
+        }
+
+        if (widths.source == 0 || widths.destination == 0)
+        {
+            const auto memory_size = get_memory_size(opcode, r);
+            if (widths.source == 0)
+                check_operand(source.mode, source.register1, memory_size, r);
+
+            if (widths.destination == 0)
+                check_operand(destination.mode, destination.register1, memory_size, r);
+        }
+
+        if (disvm::runtime::is_branch(opcode))
+            check_pc(*reinterpret_cast<const vm_pc_t *>(r.dest), *r.module_ref);
+        else if (opcode == opcode_t::casel)
+            check_case_table<big_t>(r);
+        else if (disvm::runtime::is_case(opcode))
+            check_case_table<word_t>(r);
+    }
+
+    //
+    // Module data (MP) access for module references sharing the original module data
+    //
+
+    enum class mp_access_t
+    {
+        none,
+        read,
+        write,
+    };
+
+    // Determine how the supplied instruction accesses module data directly.
+    // Memory referenced by pointers in the module data is shared by every copy
+    // of the module data, so it doesn't need a private copy to be written.
+    mp_access_t get_mp_access(const vm_exec_op_t &inst)
+    {
+        const auto source = inst.source();
+        const auto destination = inst.destination();
+        const auto middle_mode = inst.middle_mode();
+
+        const auto source_mp = source.mode == address_mode_t::offset_indirect_mp;
+        const auto middle_mp = middle_mode == address_mode_middle_t::small_offset_indirect_mp;
+        const auto destination_mp = destination.mode == address_mode_t::offset_indirect_mp;
+
+        // The address of the source is retained
+        if (source_mp && (inst.opcode == opcode_t::lea || inst.opcode == opcode_t::alt || inst.opcode == opcode_t::nbalt))
+            return mp_access_t::write;
+
+        // Indexing stores the element address in the middle operand
+        if (middle_mp)
+        {
+            switch (inst.opcode)
+            {
+            case opcode_t::indb: case opcode_t::indw: case opcode_t::indf: case opcode_t::indl: case opcode_t::indx:
+                return mp_access_t::write;
+            default:
+                break;
+            }
+        }
+
+        if (destination_mp)
+        {
+            if (disvm::runtime::is_branch(inst.opcode) || disvm::runtime::is_case(inst.opcode))
+                return mp_access_t::read;
+
+            switch (inst.opcode)
+            {
+            case opcode_t::goto_:
+            case opcode_t::send:
+            case opcode_t::tcmp:
+            case opcode_t::mcall:
+            case opcode_t::mspawn:
+                return mp_access_t::read;
+            default:
+                return mp_access_t::write;
+            }
+        }
+
+        if (source_mp
+            || middle_mp
+            || source.mode == address_mode_t::offset_double_indirect_mp
+            || destination.mode == address_mode_t::offset_double_indirect_mp)
+            return mp_access_t::read;
+
+        return mp_access_t::none;
+    }
+
+    // Update the MP register if the module data of the module reference has been copied.
+    void refresh_mp(vm_registers_t &r)
+    {
+        auto mp_base = r.module_ref->mp_base.load(std::memory_order_acquire);
+        if (r.mp_base == mp_base)
+            return;
+
+        mp_base->add_ref();
+        disvm::runtime::dec_ref_count_and_free(r.mp_base);
+        r.mp_base = mp_base;
+        r.update_mp();
+    }
+
+    template<bool Verified>
+    void decode_operands(const vm_decoded_inst_t &inst, vm_registers_t &r)
+    {
+        if (Verified)
+            decode_table[r.module_ref->code_section[r.pc].op.addr_code](inst, r);
+        else
+            decode_checked(inst, r);
+    }
+
+    template<mp_access_t Access, bool Verified>
+    void decode_shared_mp(const vm_decoded_inst_t &inst, vm_registers_t &r)
+    {
+        if (Access == mp_access_t::write && r.module_ref->is_mp_shared())
+            r.module_ref->make_mp_private();
+
+        refresh_mp(r);
+        decode_operands<Verified>(inst, r);
+    }
+
+    vm_decoded_inst_t decode(const vm_exec_op_t &inst, bool verified, bool shared_mp)
+    {
+        const auto opcode = static_cast<std::size_t>(inst.opcode);
+        assert(opcode <= static_cast<std::size_t>(opcode_t::last_opcode));
+
+        auto decoded = vm_decoded_inst_t{};
+        decoded.decode = verified ? decode_table[inst.addr_code] : decode_checked;
+
+        // Instructions accessing module data that may be shared check for a copy first
+        if (shared_mp)
+        {
+            switch (get_mp_access(inst))
+            {
+            case mp_access_t::read:
+                decoded.decode = verified ? decode_shared_mp<mp_access_t::read, true> : decode_shared_mp<mp_access_t::read, false>;
+                break;
+            case mp_access_t::write:
+                decoded.decode = verified ? decode_shared_mp<mp_access_t::write, true> : decode_shared_mp<mp_access_t::write, false>;
+                break;
+            case mp_access_t::none:
+                break;
+            }
+        }
+
+        decoded.exec = disvm::runtime::vm_exec_table[opcode];
+        decoded.opcode = inst.opcode;
+        decoded.preemption = disvm::runtime::get_preemption(inst.opcode);
+        decoded.mid = inst.mid;
+        decoded.src = inst.src;
+        decoded.dest = inst.dest;
+        decoded.call_site_cache = nullptr;
+
+        return decoded;
+    }
+
+    // Module references share the original module data of modules without native code, see vm_module_ref_t.
+    bool may_share_mp(const vm_module_t &module)
+    {
+        return module.original_mp != nullptr && module.native_code == nullptr;
+    }
+
+    bool is_call_site(opcode_t opcode)
+    {
+        return opcode == opcode_t::mframe || opcode == opcode_t::mcall;
+    }
+
+    // Find the longest superinstruction matching the instructions starting at the supplied program counter.
+    const vm_superinstruction_t *find_superinstruction(const code_section_t &code_section, std::size_t pc)
+    {
+        for (auto i = std::size_t{ 0 }; i < disvm::runtime::vm_superinstruction_count; ++i)
+        {
+            const auto &super_inst = disvm::runtime::vm_superinstruction_table[i];
+            if ((code_section.size() - pc) < super_inst.length)
+                continue;
+
+            auto j = std::size_t{ 0 };
+            while (j < super_inst.length && code_section[pc + j].op.opcode == super_inst.sequence[j])
+                ++j;
+
+            if (j == super_inst.length)
+                return &super_inst;
+        }
+
+        return nullptr;
+    }
+
+    void decode_function(const vm_decoded_inst_t &inst, vm_registers_t &r);
+
+    // Get the program counters of function entry points in ascending order.
+    // Functions in the Dis format aren't delimited, so entry points are the targets of local calls
+    // and spawns along with exports. Function ranges only determine how much of the code section
+    // is decoded at once, an instruction outside of a decoded range is decoded when executed.
+    std::vector<vm_pc_t> get_function_entries(const vm_module_t &module)
+    {
+        const auto &code_section = module.code_section;
+        const auto is_valid_pc = [&](vm_pc_t pc) { return 0 <= pc && static_cast<std::size_t>(pc) < code_section.size(); };
+
+        auto entries = std::vector<vm_pc_t>{};
+        if (is_valid_pc(module.header.entry_pc))
+            entries.push_back(module.header.entry_pc);
+
+        for (const auto &e : module.export_section)
+        {
+            if (is_valid_pc(e.second.pc))
+                entries.push_back(e.second.pc);
+        }
+
+        for (const auto &inst : code_section)
+        {
+            const auto &op = inst.op;
+            if ((op.opcode == opcode_t::call || op.opcode == opcode_t::spawn)
+                && op.destination().mode == address_mode_t::immediate
+                && is_valid_pc(op.destination().register1))
+                entries.push_back(op.destination().register1);
+        }
+
+        std::sort(entries.begin(), entries.end());
+        entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+        return entries;
+    }
+
+    // Copy a decoded instruction into an entry that may be read by executing threads.
+    // The decoder is published after the rest of the entry.
+    void publish_decoded(vm_decoded_inst_t &entry, vm_decoded_inst_t decoded)
+    {
+        const auto decode_fn = decoded.decode.load(std::memory_order_relaxed);
+        decoded.decode.store(entry.decode.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        entry = decoded;
+        entry.decode.store(decode_fn, std::memory_order_release);
+    }
+
+    // Replace the placeholder at the supplied program counter with the pre-decoded instruction.
+    void decode_placeholder(vm_module_t &module, std::size_t pc)
+    {
+        auto &entry = module.decoded_section[pc];
+        assert(entry.decode.load(std::memory_order_relaxed) == decode_function);
+
+        auto decoded = decode(module.code_section[pc].op, module.verified, may_share_mp(module));
+        decoded.call_site_cache = entry.call_site_cache;
+
+        // Rewrite common instruction sequences as superinstructions.
+        // The operands of each instruction in a sequence are decoded as it executes, so only
+        // verified modules are rewritten. Instructions within a sequence keep their own entry
+        // since they may be branch targets.
+        if (module.verified)
+        {
+            const auto super_inst = find_superinstruction(module.code_section, pc);
+            if (super_inst != nullptr)
+            {
+                decoded.opcode = super_inst->opcode;
+                decoded.exec = super_inst->exec;
+                decoded.preemption = super_inst->preemption;
+            }
+        }
+
+        // Threads that observe the placeholder wait for the decode lock
+        publish_decoded(entry, decoded);
+    }
+
+    // Decode the function containing the current instruction and then the instruction's operands.
+    void decode_function(const vm_decoded_inst_t &inst, vm_registers_t &r)
+    {
+        // The decoded section is a cache of the code section, so it is updated
+        // through the module reference.
+        auto &module = const_cast<vm_module_t &>(*r.module_ref->module);
+        {
+            std::lock_guard<std::mutex> lock{ module.decode_lock };
+
+            // Another thread may have decoded the function
+            if (inst.decode.load(std::memory_order_acquire) == decode_function)
+            {
+                const auto &entries = module.function_entries;
+                const auto next_entry = std::upper_bound(entries.cbegin(), entries.cend(), r.pc);
+                const auto begin = (next_entry == entries.cbegin()) ? std::size_t{ 0 } : static_cast<std::size_t>(*(next_entry - 1));
+                const auto end = (next_entry == entries.cend()) ? module.decoded_section.size() : static_cast<std::size_t>(*next_entry);
+                assert(begin <= static_cast<std::size_t>(r.pc) && static_cast<std::size_t>(r.pc) < end);
+
+                for (auto pc = begin; pc < end; ++pc)
+                {
+                    if (module.decoded_section[pc].decode.load(std::memory_order_relaxed) == decode_function)
+                        decode_placeholder(module, pc);
+                }
+
+                if (disvm::debug::is_component_tracing_enabled<component_trace_t::module>())
+                    disvm::debug::log_msg(component_trace_t::module, log_level_t::debug, "decode: function: %d-%d >>%s<<", begin, end, module.module_name->str());
+            }
+        }
+
+        const auto decode_fn = inst.decode.load(std::memory_order_acquire);
+        assert(decode_fn != decode_function);
+        decode_fn(inst, r);
+    }
+}
+
+type_operand_t disvm::runtime::get_type_operand(opcode_t opcode)
+{
+    switch (opcode)
+    {
+    case opcode_t::new_:
+    case opcode_t::newz:
+    case opcode_t::newcmp:
+    case opcode_t::frame:
+        return type_operand_t::source;
+    case opcode_t::newa:
+    case opcode_t::newaz:
+    case opcode_t::movmp:
+    case opcode_t::consmp:
+    case opcode_t::headmp:
+        return type_operand_t::middle;
+    default:
+        return type_operand_t::none;
+    }
+}
+
+operand_widths_t disvm::runtime::get_operand_widths(opcode_t opcode)
+{
+    const auto b = sizeof(byte_t);
+    const auto w = sizeof(word_t);
+    const auto p = sizeof(pointer_t);
+    const auto l = sizeof(big_t);
+    const auto f = sizeof(real_t);
+    const auto s = sizeof(short_word_t);
+    const auto r = sizeof(short_real_t);
+    const auto m = std::size_t{ 0 };
+
+    switch (opcode)
+    {
+    case opcode_t::addb: case opcode_t::subb: case opcode_t::mulb: case opcode_t::divb: case opcode_t::modb:
+    case opcode_t::andb: case opcode_t::orb: case opcode_t::xorb: case opcode_t::shlb: case opcode_t::shrb:
+        return{ b, b, b };
+    case opcode_t::beqb: case opcode_t::bneb: case opcode_t::bltb: case opcode_t::bleb: case opcode_t::bgtb: case opcode_t::bgeb:
+        return{ b, b, w };
+    case opcode_t::movb: return{ b, w, b };
+    case opcode_t::cvtbw: return{ b, w, w };
+    case opcode_t::cvtwb: return{ w, w, b };
+    case opcode_t::consb: return{ b, w, p };
+    case opcode_t::headb: return{ p, w, b };
+
+    case opcode_t::addf: case opcode_t::subf: case opcode_t::mulf: case opcode_t::divf:
+        return{ f, f, f };
+    case opcode_t::beqf: case opcode_t::bnef: case opcode_t::bltf: case opcode_t::blef: case opcode_t::bgtf: case opcode_t::bgef:
+        return{ f, f, w };
+    case opcode_t::movf: case opcode_t::negf: return{ f, w, f };
+    case opcode_t::cvtfw: return{ f, w, w };
+    case opcode_t::cvtwf: return{ w, w, f };
+    case opcode_t::cvtfc: return{ f, w, p };
+    case opcode_t::cvtcf: return{ p, w, f };
+    case opcode_t::cvtfl: return{ f, w, l };
+    case opcode_t::cvtlf: return{ l, w, f };
+    case opcode_t::cvtrf: return{ f, w, r };
+    case opcode_t::cvtfr: return{ r, w, f };
+    case opcode_t::cvtfx: return{ f, f, w };
+    case opcode_t::cvtxf: return{ w, f, f };
+    case opcode_t::consf: return{ f, w, p };
+    case opcode_t::headf: return{ p, w, f };
+    case opcode_t::expf: return{ w, f, f };
+
+    case opcode_t::addl: case opcode_t::subl: case opcode_t::mull: case opcode_t::divl: case opcode_t::modl:
+    case opcode_t::andl: case opcode_t::orl: case opcode_t::xorl: case opcode_t::shll: case opcode_t::shrl: case opcode_t::lsrl:
+        return{ l, l, l };
+    case opcode_t::beql: case opcode_t::bnel: case opcode_t::bltl: case opcode_t::blel: case opcode_t::bgtl: case opcode_t::bgel:
+        return{ l, l, w };
+    case opcode_t::movl: return{ l, w, l };
+    case opcode_t::cvtlw: return{ l, w, w };
+    case opcode_t::cvtwl: return{ w, w, l };
+    case opcode_t::cvtlc: return{ l, w, p };
+    case opcode_t::cvtcl: return{ p, w, l };
+    case opcode_t::consl: return{ l, w, p };
+    case opcode_t::headl: return{ p, w, l };
+    case opcode_t::expl: return{ w, l, l };
+    case opcode_t::casel: return{ l, w, w };
+
+    case opcode_t::cvtws: return{ w, w, s };
+    case opcode_t::cvtsw: return{ s, w, w };
+
+    // Index instructions write the address of the element to the middle operand
+    case opcode_t::indb: case opcode_t::indw: case opcode_t::indf: case opcode_t::indl: case opcode_t::indx:
+        return{ p, p, w };
+
+    case opcode_t::movm: case opcode_t::movmp: return{ m, w, m };
+    case opcode_t::consmp: return{ m, w, p };
+    case opcode_t::headmp: return{ p, w, m };
+
+    default:
+        return{ w, w, w };
+    }
+}
+
+bool disvm::runtime::is_branch(opcode_t opcode)
+{
+    switch (opcode)
+    {
+    case opcode_t::beqb: case opcode_t::bneb: case opcode_t::bltb: case opcode_t::bleb: case opcode_t::bgtb: case opcode_t::bgeb:
+    case opcode_t::beqw: case opcode_t::bnew: case opcode_t::bltw: case opcode_t::blew: case opcode_t::bgtw: case opcode_t::bgew:
+    case opcode_t::beqf: case opcode_t::bnef: case opcode_t::bltf: case opcode_t::blef: case opcode_t::bgtf: case opcode_t::bgef:
+    case opcode_t::beqc: case opcode_t::bnec: case opcode_t::bltc: case opcode_t::blec: case opcode_t::bgtc: case opcode_t::bgec:
+    case opcode_t::beql: case opcode_t::bnel: case opcode_t::bltl: case opcode_t::blel: case opcode_t::bgtl: case opcode_t::bgel:
+    case opcode_t::jmp:
+    case opcode_t::call:
+    case opcode_t::spawn:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool disvm::runtime::is_case(opcode_t opcode)
+{
+    return opcode == opcode_t::casew || opcode == opcode_t::casel || opcode == opcode_t::casec;
+}
+
+void disvm::runtime::decode_code_section(vm_module_t &module)
+{
+    if (util::has_flag(module.header.runtime_flag, runtime_flags_t::builtin)
+        || !module.decoded_section.empty())
+        return;
+
+    const auto &code_section = module.code_section;
+
+    // [PERF] Each entry starts as a placeholder that decodes the containing function when it is
+    // first executed, so the cost of decoding scales with the code that is executed.
+    auto placeholder = vm_decoded_inst_t{};
+    placeholder.decode = decode_function;
+    placeholder.exec = nullptr;
+    placeholder.call_site_cache = nullptr;
+
+    auto call_site_count = std::size_t{ 0 };
+    for (const auto &inst : code_section)
+    {
+        if (is_call_site(inst.op.opcode))
+            ++call_site_count;
+    }
+
+    auto decoded_section = decoded_section_t(code_section.size(), placeholder);
+
+    // Assign each inter-module call site an inline cache
+    auto call_site_caches = std::unique_ptr<vm_call_site_cache_t[]>{};
+    if (call_site_count > 0)
+    {
+        call_site_caches.reset(new vm_call_site_cache_t[call_site_count]);
+
+        auto next_cache = call_site_caches.get();
+        for (auto pc = std::size_t{ 0 }; pc < code_section.size(); ++pc)
+        {
+            if (is_call_site(code_section[pc].op.opcode))
+                decoded_section[pc].call_site_cache = next_cache++;
+        }
+    }
+
+    module.function_entries = get_function_entries(module);
+    module.decoded_section = std::move(decoded_section);
+    module.call_site_caches = std::move(call_site_caches);
+
+    if (disvm::debug::is_component_tracing_enabled<component_trace_t::module>())
+        disvm::debug::log_msg(component_trace_t::module, log_level_t::debug, "decode: code section: %d call sites: %d functions: %d", module.decoded_section.size(), call_site_count, module.function_entries.size());
+}
+
+void disvm::runtime::decode_instruction(vm_module_t &module, vm_pc_t pc)
+{
+    assert(0 <= pc && static_cast<std::size_t>(pc) < module.code_section.size());
+    if (module.decoded_section.empty())
+        return;
+
+    assert(module.decoded_section.size() == module.code_section.size());
+    std::lock_guard<std::mutex> lock{ module.decode_lock };
+    auto &decoded = module.decoded_section[pc];
+
+    // Placeholders are decoded from the patched code section when executed
+    if (decoded.decode.load(std::memory_order_relaxed) == decode_function)
+        return;
+
+    // Patching (e.g. breakpoint) doesn't change the call site so the cache is retained
+    auto patched = decode(module.code_section[pc].op, module.verified, may_share_mp(module));
+    patched.call_site_cache = decoded.call_site_cache;
+    publish_decoded(decoded, patched);
+}
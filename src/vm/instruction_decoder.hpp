@@ -0,0 +1,89 @@
+//
+// Dis VM
+// File: instruction_decoder.hpp
+// Author: arr
+//
+
+#ifndef _DISVM_SRC_VM_INSTRUCTION_DECODER_HPP_
+#define _DISVM_SRC_VM_INSTRUCTION_DECODER_HPP_
+
+#include <runtime.hpp>
+
+namespace disvm
+{
+    namespace runtime
+    {
+        // Operand of an instruction that holds a type ID
+        enum class type_operand_t
+        {
+            none,
+            source,
+            middle,
+        };
+
+        // Get the operand of the supplied instruction that holds a type ID in the module's type section.
+        type_operand_t get_type_operand(opcode_t opcode);
+
+        // Width in bytes of the values accessed through the operands of an instruction.
+        // Memory operands (e.g. 'movm') have a width of zero as their size is given by the middle operand.
+        struct operand_widths_t
+        {
+            std::size_t source;
+            std::size_t middle;
+            std::size_t destination;
+        };
+
+        // Get the width of the values accessed through the operands of the supplied instruction.
+        operand_widths_t get_operand_widths(opcode_t opcode);
+
+        // Returns 'true' if the destination operand of the supplied instruction is a program counter in the same module.
+        bool is_branch(opcode_t opcode);
+
+        // Returns 'true' if the destination operand of the supplied instruction is a case table.
+        bool is_case(opcode_t opcode);
+
+        // Get the point at which the supplied instruction charges the thread quanta.
+        // Defined here so the interpreter loops can resolve it at compile time.
+        constexpr vm_preemption_t get_preemption(opcode_t opcode)
+        {
+            switch (opcode)
+            {
+            case opcode_t::beqb: case opcode_t::bneb: case opcode_t::bltb: case opcode_t::bleb: case opcode_t::bgtb: case opcode_t::bgeb:
+            case opcode_t::beqw: case opcode_t::bnew: case opcode_t::bltw: case opcode_t::blew: case opcode_t::bgtw: case opcode_t::bgew:
+            case opcode_t::beqf: case opcode_t::bnef: case opcode_t::bltf: case opcode_t::blef: case opcode_t::bgtf: case opcode_t::bgef:
+            case opcode_t::beqc: case opcode_t::bnec: case opcode_t::bltc: case opcode_t::blec: case opcode_t::bgtc: case opcode_t::bgec:
+            case opcode_t::beql: case opcode_t::bnel: case opcode_t::bltl: case opcode_t::blel: case opcode_t::bgtl: case opcode_t::bgel:
+            case opcode_t::jmp:
+            case opcode_t::goto_:
+            case opcode_t::casew: case opcode_t::casel: case opcode_t::casec:
+                return vm_preemption_t::back_edge;
+
+            // Calls, returns, and instructions that may block or change the thread state
+            case opcode_t::call: case opcode_t::mcall: case opcode_t::ret:
+            case opcode_t::spawn: case opcode_t::mspawn:
+            case opcode_t::send: case opcode_t::recv: case opcode_t::alt: case opcode_t::nbalt:
+            case opcode_t::raise: case opcode_t::exit:
+                return vm_preemption_t::always;
+
+            // The original instruction under a breakpoint may be any of the above
+            case opcode_t::brkpt:
+                return vm_preemption_t::always;
+
+            default:
+                return vm_preemption_t::none;
+            }
+        }
+
+        // Prepare the code section of the supplied module to be translated into the pre-decoded form.
+        // Each function is translated the first time one of its instructions is executed.
+        // Built-in modules and modules that have already been decoded are left untouched.
+        // Operands of modules that failed verification are checked as each instruction is decoded.
+        void decode_code_section(vm_module_t &module);
+
+        // Update the pre-decoded instruction at the supplied program counter.
+        // This should be called after an instruction in the code section has been patched (e.g. breakpoint).
+        void decode_instruction(vm_module_t &module, vm_pc_t pc);
+    }
+}
+
+#endif // _DISVM_SRC_VM_INSTRUCTION_DECODER_HPP_
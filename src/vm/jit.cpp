@@ -0,0 +1,888 @@
+//
+// Dis VM
+// File: jit.cpp
+// Author: arr
+//
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <vector>
+#include <disvm.hpp>
+#include <opcodes.hpp>
+#include <debug.hpp>
+#include <utils.hpp>
+#include "execution_table.hpp"
+#include "jit.hpp"
+
+#if defined(_M_IX86) || defined(__i386__)
+#define JIT_TARGET_X86
+#endif
+
+// [PAL] Executable memory
+#ifdef JIT_TARGET_X86
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+#endif
+
+using disvm::vm_t;
+using disvm::opcode_t;
+
+using disvm::debug::component_trace_t;
+using disvm::debug::log_level_t;
+
+using disvm::runtime::word_t;
+using disvm::runtime::pointer_t;
+using disvm::runtime::vm_pc_t;
+using disvm::runtime::vm_exec_t;
+using disvm::runtime::vm_exec_op_t;
+using disvm::runtime::vm_decoded_inst_t;
+using disvm::runtime::vm_module_t;
+using disvm::runtime::vm_module_ref_t;
+using disvm::runtime::vm_native_code_t;
+using disvm::runtime::vm_registers_t;
+using disvm::runtime::vm_preemption_t;
+using disvm::runtime::vm_thread_state_t;
+using disvm::runtime::runtime_flags_t;
+using disvm::runtime::address_mode_t;
+using disvm::runtime::address_mode_middle_t;
+using disvm::runtime::inst_data_generic_t;
+using disvm::runtime::middle_data_t;
+
+namespace
+{
+    // Number of back-edges and calls interpreted in a module before it is compiled.
+    const auto default_compile_threshold = uint32_t{ 1 << 10 };
+    const auto compile_disabled = std::numeric_limits<uint32_t>::max();
+
+    // Exceptions are unable to unwind through native frames. They are captured
+    // in the helper functions and re-thrown once native code has returned.
+    thread_local std::exception_ptr pending_exception;
+
+    // Native code state that is needed by the helper functions.
+    // The layout of this structure is known to the generated code.
+    struct native_frame_t
+    {
+        pointer_t fp;
+        pointer_t mp;
+        vm_module_ref_t *module_ref;
+    };
+
+#ifdef JIT_TARGET_X86
+
+#ifdef _MSC_VER
+#define NATIVE_CALL __cdecl
+#else
+#define NATIVE_CALL __attribute__((cdecl))
+#endif
+
+    void load_frame(const vm_registers_t &r, native_frame_t &frame)
+    {
+        frame.fp = r.fp;
+        frame.mp = r.mp;
+        frame.module_ref = r.module_ref;
+    }
+
+    void NATIVE_CALL native_enter(vm_registers_t &r, native_frame_t &frame)
+    {
+        load_frame(r, frame);
+    }
+
+    // Execute an instruction that has no native translation.
+    // Returns 'false' if control should be returned to the interpreter.
+    bool NATIVE_CALL native_exec(vm_registers_t &r, vm_t &vm, const vm_decoded_inst_t &inst, native_frame_t &frame)
+    {
+        const auto pc = r.pc;
+        auto preemption = vm_preemption_t::none;
+        try
+        {
+            // The instruction is only known once decoded, see decode_code_section()
+            inst.decode.load(std::memory_order_acquire)(inst, r);
+            preemption = inst.preemption;
+            r.next_pc = (r.pc + 1);
+            inst.exec(r, vm);
+        }
+        catch (...)
+        {
+            pending_exception = std::current_exception();
+            return false;
+        }
+
+        r.pc = r.next_pc;
+        if (preemption != vm_preemption_t::none && disvm::runtime::is_preempted(r, preemption, pc))
+            return false;
+
+        if (r.module_ref != frame.module_ref)
+            return false;
+
+        load_frame(r, frame);
+        return true;
+    }
+
+    void *alloc_executable(std::size_t size)
+    {
+#ifdef _WIN32
+        return ::VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+        auto mem = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        return (mem != MAP_FAILED) ? mem : nullptr;
+#endif
+    }
+
+    bool protect_executable(void *mem, std::size_t size)
+    {
+#ifdef _WIN32
+        DWORD old_protect;
+        if (!::VirtualProtect(mem, size, PAGE_EXECUTE_READ, &old_protect))
+            return false;
+
+        return ::FlushInstructionCache(::GetCurrentProcess(), mem, size) != FALSE;
+#else
+        return ::mprotect(mem, size, PROT_READ | PROT_EXEC) == 0;
+#endif
+    }
+
+    void free_executable(void *mem, std::size_t size)
+    {
+#ifdef _WIN32
+        (void)size;
+        ::VirtualFree(mem, 0, MEM_RELEASE);
+#else
+        ::munmap(mem, size);
+#endif
+    }
+
+    enum class reg_t : uint8_t
+    {
+        eax = 0,
+        ecx = 1,
+        edx = 2,
+        ebx = 3,
+        esp = 4,
+        ebp = 5,
+        esi = 6,
+        edi = 7,
+    };
+
+    // Condition codes for 'jcc'
+    enum class cc_t : uint8_t
+    {
+        ae = 0x3,
+        e = 0x4,
+        ne = 0x5,
+        l = 0xc,
+        ge = 0xd,
+        le = 0xe,
+        g = 0xf,
+    };
+
+    // Condition codes differ from their inverse in the lowest bit
+    cc_t invert(cc_t cc)
+    {
+        return static_cast<cc_t>(static_cast<uint8_t>(cc) ^ 1);
+    }
+
+    const auto unbound = ~std::size_t{ 0 };
+
+    // IA-32 machine code emitter
+    class x86_emitter_t final
+    {
+    public:
+        using label_t = std::size_t;
+
+        x86_emitter_t(std::size_t label_count)
+            : _labels(label_count, unbound)
+        { }
+
+        label_t new_label()
+        {
+            _labels.push_back(unbound);
+            return (_labels.size() - 1);
+        }
+
+        void bind(label_t l)
+        {
+            assert(_labels[l] == unbound);
+            _labels[l] = _code.size();
+        }
+
+        void push(reg_t r) { emit8(0x50 | as_byte(r)); }
+        void pop(reg_t r) { emit8(0x58 | as_byte(r)); }
+        void ret() { emit8(0xc3); }
+
+        // mov ebp, esp
+        void mov_ebp_esp() { emit8(0x89); emit8(0xe5); }
+
+        // sub/add esp, imm8
+        void sub_esp(uint8_t imm) { emit8(0x83); emit8(0xec); emit8(imm); }
+        void add_esp(uint8_t imm) { emit8(0x83); emit8(0xc4); emit8(imm); }
+
+        // mov dest, src
+        void mov_reg(reg_t dest, reg_t src) { emit_alu(0x89, dest, src); }
+
+        // mov r, imm32
+        void mov_imm(reg_t r, uint32_t imm) { emit8(0xb8 | as_byte(r)); emit32(imm); }
+
+        // mov r, [base + disp32]
+        void mov_load(reg_t r, reg_t base, int32_t disp) { emit8(0x8b); emit_mem(r, base, disp); }
+
+        // movzx r, byte [base + disp32]
+        void movzx_load8(reg_t r, reg_t base, int32_t disp) { emit8(0x0f); emit8(0xb6); emit_mem(r, base, disp); }
+
+        // mov [base + disp32], r
+        void mov_store(reg_t base, int32_t disp, reg_t r) { emit8(0x89); emit_mem(r, base, disp); }
+
+        // mov byte [base + disp32], r8
+        void mov_store8(reg_t base, int32_t disp, reg_t r)
+        {
+            assert(r == reg_t::eax || r == reg_t::ecx || r == reg_t::edx || r == reg_t::ebx);
+            emit8(0x88);
+            emit_mem(r, base, disp);
+        }
+
+        // mov dword [base + disp32], imm32
+        void mov_store_imm(reg_t base, int32_t disp, uint32_t imm) { emit8(0xc7); emit_mem(reg_t::eax, base, disp); emit32(imm); }
+
+        // lea r, [base + disp32]
+        void lea(reg_t r, reg_t base, int32_t disp) { emit8(0x8d); emit_mem(r, base, disp); }
+
+        // mov [esp + 4 * index], r
+        void mov_arg(uint8_t index, reg_t r) { emit8(0x89); emit_arg(r, index); }
+
+        // mov dword [esp + 4 * index], imm32
+        void mov_arg_imm(uint8_t index, uint32_t imm) { emit8(0xc7); emit_arg(reg_t::eax, index); emit32(imm); }
+
+        // sub word [base + disp32], 1
+        void dec_mem16(reg_t base, int32_t disp) { emit8(0x66); emit8(0x83); emit_mem(static_cast<reg_t>(5), base, disp); emit8(1); }
+
+        // <op> dest, src
+        void add(reg_t dest, reg_t src) { emit_alu(0x01, dest, src); }
+        void sub(reg_t dest, reg_t src) { emit_alu(0x29, dest, src); }
+        void and_(reg_t dest, reg_t src) { emit_alu(0x21, dest, src); }
+        void or_(reg_t dest, reg_t src) { emit_alu(0x09, dest, src); }
+        void xor_(reg_t dest, reg_t src) { emit_alu(0x31, dest, src); }
+        void cmp(reg_t dest, reg_t src) { emit_alu(0x39, dest, src); }
+        void imul(reg_t dest, reg_t src) { emit8(0x0f); emit8(0xaf); emit8(0xc0 | (as_byte(dest) << 3) | as_byte(src)); }
+
+        // test al, al
+        void test_al() { emit8(0x84); emit8(0xc0); }
+
+        // cmp eax, imm32
+        void cmp_eax_imm(uint32_t imm) { emit8(0x3d); emit32(imm); }
+
+        // call absolute address
+        template<typename F>
+        void call(F fn)
+        {
+            mov_imm(reg_t::eax, static_cast<uint32_t>(reinterpret_cast<std::uintptr_t>(fn)));
+            emit8(0xff);
+            emit8(0xd0);
+        }
+
+        void jmp(label_t l) { emit8(0xe9); emit_rel32(l); }
+        void jcc(cc_t cc, label_t l) { emit8(0x0f); emit8(0x80 | static_cast<uint8_t>(cc)); emit_rel32(l); }
+
+        // jmp [table + eax * 4]
+        void jmp_table_eax() { emit8(0xff); emit8(0x24); emit8(0x85); _table_fixups.push_back(_code.size()); emit32(0); }
+
+        // Size of the code and the trailing jump table.
+        std::size_t get_size(std::size_t table_length) const
+        {
+            return table_offset() + (table_length * sizeof(uint32_t));
+        }
+
+        // Copy the code into the supplied memory, resolve all fix-ups, and append a jump table
+        // with an entry for each label in [0, table_length).
+        bool finalize(uint8_t *mem, std::size_t table_length) const
+        {
+            std::memcpy(mem, _code.data(), _code.size());
+
+            for (const auto &f : _rel_fixups)
+            {
+                if (_labels[f.second] == unbound)
+                    return false;
+
+                const auto rel = static_cast<int32_t>(_labels[f.second]) - static_cast<int32_t>(f.first + sizeof(int32_t));
+                write32(mem + f.first, static_cast<uint32_t>(rel));
+            }
+
+            const auto table = mem + table_offset();
+            for (auto p : _table_fixups)
+                write32(mem + p, static_cast<uint32_t>(reinterpret_cast<std::uintptr_t>(table)));
+
+            for (auto i = std::size_t{ 0 }; i < table_length; ++i)
+            {
+                if (_labels[i] == unbound)
+                    return false;
+
+                write32(table + (i * sizeof(uint32_t)), static_cast<uint32_t>(reinterpret_cast<std::uintptr_t>(mem + _labels[i])));
+            }
+
+            return true;
+        }
+
+    private:
+        static uint8_t as_byte(reg_t r) { return static_cast<uint8_t>(r); }
+
+        static void write32(uint8_t *p, uint32_t v)
+        {
+            p[0] = static_cast<uint8_t>(v);
+            p[1] = static_cast<uint8_t>(v >> 8);
+            p[2] = static_cast<uint8_t>(v >> 16);
+            p[3] = static_cast<uint8_t>(v >> 24);
+        }
+
+        std::size_t table_offset() const
+        {
+            // Align the jump table
+            return (_code.size() + (sizeof(uint32_t) - 1)) & ~(sizeof(uint32_t) - 1);
+        }
+
+        void emit8(uint8_t b) { _code.push_back(b); }
+
+        void emit32(uint32_t v)
+        {
+            emit8(static_cast<uint8_t>(v));
+            emit8(static_cast<uint8_t>(v >> 8));
+            emit8(static_cast<uint8_t>(v >> 16));
+            emit8(static_cast<uint8_t>(v >> 24));
+        }
+
+        void emit_rel32(label_t l)
+        {
+            _rel_fixups.push_back({ _code.size(), l });
+            emit32(0);
+        }
+
+        // ModRM for [base + disp32]
+        void emit_mem(reg_t r, reg_t base, int32_t disp)
+        {
+            assert(base != reg_t::esp && "ESP based addressing requires a SIB byte");
+            emit8(0x80 | (as_byte(r) << 3) | as_byte(base));
+            emit32(static_cast<uint32_t>(disp));
+        }
+
+        // ModRM and SIB for [esp + disp8]
+        void emit_arg(reg_t r, uint8_t index)
+        {
+            emit8(0x44 | (as_byte(r) << 3));
+            emit8(0x24);
+            emit8(static_cast<uint8_t>(index * sizeof(uint32_t)));
+        }
+
+        void emit_alu(uint8_t op, reg_t dest, reg_t src)
+        {
+            emit8(op);
+            emit8(0xc0 | (as_byte(src) << 3) | as_byte(dest));
+        }
+
+        std::vector<uint8_t> _code;
+        std::vector<std::size_t> _labels;
+        std::vector<std::pair<std::size_t, label_t>> _rel_fixups;
+        std::vector<std::size_t> _table_fixups;
+    };
+
+    // Stack layout of the native entry function.
+    //   [ebp + 12] vm_t &
+    //   [ebp + 8] vm_registers_t &
+    //   [ebp - 12, ebp - 4] saved EBX, ESI, EDI
+    //   [ebp - 40] native_frame_t
+    //   [esp, esp + 16) outgoing arguments
+    // Registers in native code.
+    //   EBX - vm_registers_t &
+    //   ESI - frame pointer (FP) base
+    //   EDI - module data (MP) base
+    const auto local_size = uint8_t{ 44 };
+    const auto native_frame_offset = int32_t{ -40 };
+    const auto vm_arg_offset = int32_t{ 12 };
+    const auto registers_arg_offset = int32_t{ 8 };
+
+    static_assert(sizeof(native_frame_t) <= (local_size - (4 * sizeof(uint32_t))), "Native frame doesn't fit in local storage");
+
+    // Offsets of register fields used by native code
+    struct register_offsets_t
+    {
+        int32_t pc;
+        int32_t quanta;
+    };
+
+    template<typename T>
+    int32_t field_offset(const vm_registers_t &r, const T &field)
+    {
+        return static_cast<int32_t>(reinterpret_cast<const uint8_t *>(&field) - reinterpret_cast<const uint8_t *>(&r));
+    }
+
+    class module_compiler_t final
+    {
+    public:
+        module_compiler_t(const vm_module_t &module, const vm_registers_t &r)
+            : _module{ module }
+            , _instruction_count{ module.code_section.size() }
+            , _e{ module.code_section.size() + 2 }
+            , _inlined_count{ 0 }
+        {
+            _offsets.pc = field_offset(r, r.pc);
+            _offsets.quanta = field_offset(r, r.current_thread_quanta);
+        }
+
+        // Returns the number of bytes needed for the native code.
+        std::size_t compile()
+        {
+            emit_prologue();
+
+            for (auto i = std::size_t{ 0 }; i < _instruction_count; ++i)
+            {
+                _e.bind(i);
+                const auto pc = static_cast<vm_pc_t>(i);
+                if (try_emit_inline(pc, _module.code_section[i].op))
+                    ++_inlined_count;
+                else
+                    emit_exec(pc);
+            }
+
+            // Execution fell off the end of the code section
+            _e.bind(fall_off_label());
+            _e.mov_store_imm(reg_t::ebx, _offsets.pc, static_cast<uint32_t>(_instruction_count));
+            _e.jmp(exit_label());
+
+            emit_epilogue();
+
+            return _e.get_size(_instruction_count);
+        }
+
+        bool finalize(uint8_t *mem) const
+        {
+            return _e.finalize(mem, _instruction_count);
+        }
+
+        std::size_t get_inlined_count() const
+        {
+            return _inlined_count;
+        }
+
+    private:
+        x86_emitter_t::label_t fall_off_label() const { return _instruction_count; }
+        x86_emitter_t::label_t exit_label() const { return _instruction_count + 1; }
+
+        void emit_prologue()
+        {
+            _e.push(reg_t::ebp);
+            _e.mov_ebp_esp();
+            _e.push(reg_t::ebx);
+            _e.push(reg_t::esi);
+            _e.push(reg_t::edi);
+            _e.sub_esp(local_size);
+
+            _e.mov_load(reg_t::ebx, reg_t::ebp, registers_arg_offset);
+
+            _e.mov_arg(0, reg_t::ebx);
+            _e.lea(reg_t::eax, reg_t::ebp, native_frame_offset);
+            _e.mov_arg(1, reg_t::eax);
+            _e.call(native_enter);
+            emit_reload_bases();
+
+            // Dispatch to the current program counter
+            _e.mov_load(reg_t::eax, reg_t::ebx, _offsets.pc);
+            _e.jmp_table_eax();
+        }
+
+        void emit_epilogue()
+        {
+            _e.bind(exit_label());
+            _e.add_esp(local_size);
+            _e.pop(reg_t::edi);
+            _e.pop(reg_t::esi);
+            _e.pop(reg_t::ebx);
+            _e.pop(reg_t::ebp);
+            _e.ret();
+        }
+
+        void emit_reload_bases()
+        {
+            _e.mov_load(reg_t::esi, reg_t::ebp, native_frame_offset + offsetof(native_frame_t, fp));
+            _e.mov_load(reg_t::edi, reg_t::ebp, native_frame_offset + offsetof(native_frame_t, mp));
+        }
+
+        // Call back into the execution table for the instruction
+        void emit_exec(vm_pc_t pc)
+        {
+            const auto &inst = _module.decoded_section[pc];
+
+            _e.mov_store_imm(reg_t::ebx, _offsets.pc, static_cast<uint32_t>(pc));
+            _e.mov_arg(0, reg_t::ebx);
+            _e.mov_load(reg_t::eax, reg_t::ebp, vm_arg_offset);
+            _e.mov_arg(1, reg_t::eax);
+            _e.mov_arg_imm(2, static_cast<uint32_t>(reinterpret_cast<std::uintptr_t>(&inst)));
+            _e.lea(reg_t::eax, reg_t::ebp, native_frame_offset);
+            _e.mov_arg(3, reg_t::eax);
+            _e.call(native_exec);
+            _e.test_al();
+            _e.jcc(cc_t::e, exit_label());
+            emit_reload_bases();
+
+            // Continue with the next instruction or dispatch to the branch target
+            _e.mov_load(reg_t::eax, reg_t::ebx, _offsets.pc);
+            _e.cmp_eax_imm(static_cast<uint32_t>(pc + 1));
+            _e.jcc(cc_t::e, static_cast<x86_emitter_t::label_t>(pc + 1));
+            _e.cmp_eax_imm(static_cast<uint32_t>(_instruction_count));
+            _e.jcc(cc_t::ae, exit_label());
+            _e.jmp_table_eax();
+        }
+
+        // Consume a quanta and continue at the supplied backward branch target.
+        void emit_back_edge(vm_pc_t target)
+        {
+            assert(0 <= target && static_cast<std::size_t>(target) < _instruction_count);
+            _e.dec_mem16(reg_t::ebx, _offsets.quanta);
+            _e.jcc(cc_t::ne, static_cast<x86_emitter_t::label_t>(target));
+            _e.mov_store_imm(reg_t::ebx, _offsets.pc, static_cast<uint32_t>(target));
+            _e.jmp(exit_label());
+        }
+
+        static bool is_word_readable(const inst_data_generic_t &d)
+        {
+            return d.mode == address_mode_t::offset_indirect_fp
+                || d.mode == address_mode_t::offset_indirect_mp
+                || d.mode == address_mode_t::immediate;
+        }
+
+        static bool is_word_writable(const inst_data_generic_t &d)
+        {
+            return d.mode == address_mode_t::offset_indirect_fp
+                || d.mode == address_mode_t::offset_indirect_mp;
+        }
+
+        // [SPEC] Middle operand defaults to the destination if not supplied.
+        static bool is_middle_readable(const vm_exec_op_t &op)
+        {
+            return op.middle().mode != address_mode_middle_t::none || is_word_writable(op.destination());
+        }
+
+        bool is_branch_target(const inst_data_generic_t &d) const
+        {
+            return d.mode == address_mode_t::immediate
+                && 0 <= d.register1
+                && static_cast<std::size_t>(d.register1) < _instruction_count;
+        }
+
+        static reg_t base_register(address_mode_t mode)
+        {
+            return (mode == address_mode_t::offset_indirect_fp) ? reg_t::esi : reg_t::edi;
+        }
+
+        void emit_load(reg_t r, const inst_data_generic_t &d)
+        {
+            if (d.mode == address_mode_t::immediate)
+                _e.mov_imm(r, static_cast<uint32_t>(d.register1));
+            else
+                _e.mov_load(r, base_register(d.mode), d.register1);
+        }
+
+        void emit_load_middle(reg_t r, const vm_exec_op_t &op)
+        {
+            switch (op.middle().mode)
+            {
+            case address_mode_middle_t::none:
+                emit_load(r, op.destination());
+                break;
+            case address_mode_middle_t::small_immediate:
+                _e.mov_imm(r, static_cast<uint32_t>(op.middle().register1));
+                break;
+            case address_mode_middle_t::small_offset_indirect_fp:
+                _e.mov_load(r, reg_t::esi, op.middle().register1);
+                break;
+            case address_mode_middle_t::small_offset_indirect_mp:
+                _e.mov_load(r, reg_t::edi, op.middle().register1);
+                break;
+            }
+        }
+
+        void emit_store(const inst_data_generic_t &d, reg_t r)
+        {
+            assert(is_word_writable(d));
+            _e.mov_store(base_register(d.mode), d.register1, r);
+        }
+
+        bool try_emit_inline(vm_pc_t pc, const vm_exec_op_t &op)
+        {
+            switch (op.opcode)
+            {
+            case opcode_t::movw:
+                if (!is_word_readable(op.source()) || !is_word_writable(op.destination()))
+                    return false;
+
+                emit_load(reg_t::eax, op.source());
+                emit_store(op.destination(), reg_t::eax);
+                break;
+
+            case opcode_t::movb:
+                if (!is_word_readable(op.source()) || !is_word_writable(op.destination()))
+                    return false;
+
+                if (op.source().mode == address_mode_t::immediate)
+                    _e.mov_imm(reg_t::eax, static_cast<uint32_t>(op.source().register1));
+                else
+                    _e.movzx_load8(reg_t::eax, base_register(op.source().mode), op.source().register1);
+
+                _e.mov_store8(base_register(op.destination().mode), op.destination().register1, reg_t::eax);
+                break;
+
+            case opcode_t::addw:
+            case opcode_t::subw:
+            case opcode_t::mulw:
+            case opcode_t::andw:
+            case opcode_t::orw:
+            case opcode_t::xorw:
+                if (!is_word_readable(op.source()) || !is_middle_readable(op) || !is_word_writable(op.destination()))
+                    return false;
+
+                emit_load(reg_t::eax, op.source());
+                emit_load_middle(reg_t::ecx, op);
+                switch (op.opcode)
+                {
+                case opcode_t::addw: _e.add(reg_t::eax, reg_t::ecx); break;
+                case opcode_t::mulw: _e.imul(reg_t::eax, reg_t::ecx); break;
+                case opcode_t::andw: _e.and_(reg_t::eax, reg_t::ecx); break;
+                case opcode_t::orw: _e.or_(reg_t::eax, reg_t::ecx); break;
+                case opcode_t::xorw: _e.xor_(reg_t::eax, reg_t::ecx); break;
+                case opcode_t::subw:
+                    // The source is subtracted from the middle operand
+                    _e.sub(reg_t::ecx, reg_t::eax);
+                    _e.mov_reg(reg_t::eax, reg_t::ecx);
+                    break;
+                default:
+                    assert(false && "Unexpected opcode");
+                }
+
+                emit_store(op.destination(), reg_t::eax);
+                break;
+
+            case opcode_t::beqw:
+            case opcode_t::bnew:
+            case opcode_t::bltw:
+            case opcode_t::blew:
+            case opcode_t::bgtw:
+            case opcode_t::bgew:
+            {
+                if (!is_word_readable(op.source()) || !is_middle_readable(op) || !is_branch_target(op.destination()))
+                    return false;
+
+                auto cc = cc_t::e;
+                switch (op.opcode)
+                {
+                case opcode_t::beqw: cc = cc_t::e; break;
+                case opcode_t::bnew: cc = cc_t::ne; break;
+                case opcode_t::bltw: cc = cc_t::l; break;
+                case opcode_t::blew: cc = cc_t::le; break;
+                case opcode_t::bgtw: cc = cc_t::g; break;
+                case opcode_t::bgew: cc = cc_t::ge; break;
+                default:
+                    assert(false && "Unexpected opcode");
+                }
+
+                emit_load(reg_t::eax, op.source());
+                emit_load_middle(reg_t::ecx, op);
+                _e.cmp(reg_t::eax, reg_t::ecx);
+
+                const auto target = static_cast<vm_pc_t>(op.destination().register1);
+                if (pc < target)
+                {
+                    _e.jcc(cc, static_cast<x86_emitter_t::label_t>(target));
+                }
+                else
+                {
+                    // Only the taken back-edge consumes a quanta
+                    const auto not_taken_label = _e.new_label();
+                    _e.jcc(invert(cc), not_taken_label);
+                    emit_back_edge(target);
+                    _e.bind(not_taken_label);
+                }
+
+                break;
+            }
+
+            case opcode_t::jmp:
+            {
+                if (!is_branch_target(op.destination()))
+                    return false;
+
+                const auto target = static_cast<vm_pc_t>(op.destination().register1);
+                if (pc < target)
+                    _e.jmp(static_cast<x86_emitter_t::label_t>(target));
+                else
+                    emit_back_edge(target);
+
+                break;
+            }
+
+            default:
+                return false;
+            }
+
+            // Straight-line code falls through to the next instruction
+            return true;
+        }
+
+        const vm_module_t &_module;
+        const std::size_t _instruction_count;
+        x86_emitter_t _e;
+        register_offsets_t _offsets;
+        std::size_t _inlined_count;
+    };
+
+#endif // JIT_TARGET_X86
+}
+
+bool vm_native_code_t::is_supported()
+{
+#ifdef JIT_TARGET_X86
+    return true;
+#else
+    return false;
+#endif
+}
+
+vm_native_code_t::vm_native_code_t(const vm_module_t &module)
+    : _module{ module }
+    , _entry{ nullptr }
+    , _hotness_count{ 0 }
+    , _compile_threshold{ default_compile_threshold }
+    , _code{ nullptr }
+    , _code_size{ 0 }
+{
+    if (util::has_flag(module.header.runtime_flag, runtime_flags_t::must_compile))
+        _compile_threshold = 0;
+}
+
+vm_native_code_t::~vm_native_code_t()
+{
+#ifdef JIT_TARGET_X86
+    if (_code != nullptr)
+        free_executable(_code, _code_size);
+#endif
+}
+
+bool vm_native_code_t::try_execute(vm_registers_t &r, vm_t &vm)
+{
+    auto entry = _entry.load(std::memory_order_acquire);
+    if (entry == nullptr)
+    {
+        if (_hotness_count.load(std::memory_order_relaxed) < _compile_threshold.load(std::memory_order_relaxed))
+            return false;
+
+        entry = compile(r);
+        if (entry == nullptr)
+            return false;
+    }
+
+    assert(r.module_ref->module.get() == &_module);
+    assert(static_cast<std::size_t>(r.pc) < _module.code_section.size());
+    entry(r, vm);
+
+    if (pending_exception != nullptr)
+    {
+        auto ex = pending_exception;
+        pending_exception = nullptr;
+        std::rethrow_exception(ex);
+    }
+
+    return true;
+}
+
+bool vm_native_code_t::is_hot()
+{
+    if (_entry.load(std::memory_order_acquire) != nullptr)
+        return true;
+
+    const auto threshold = _compile_threshold.load(std::memory_order_relaxed);
+    if (threshold == compile_disabled)
+        return false;
+
+    // The count is only a heuristic so lost updates are acceptable.
+    const auto count = _hotness_count.load(std::memory_order_relaxed) + 1;
+    _hotness_count.store(count, std::memory_order_relaxed);
+    return (threshold <= count);
+}
+
+vm_exec_t vm_native_code_t::compile(const vm_registers_t &r)
+{
+    std::lock_guard<std::mutex> lock{ _compile_lock };
+
+    auto entry = _entry.load(std::memory_order_acquire);
+    if (entry != nullptr || _compile_threshold == compile_disabled)
+        return entry;
+
+    // Only attempt compilation once
+    _compile_threshold = compile_disabled;
+
+#ifdef JIT_TARGET_X86
+    assert(_module.decoded_section.size() == _module.code_section.size());
+
+    module_compiler_t compiler{ _module, r };
+    const auto size = compiler.compile();
+
+    auto mem = alloc_executable(size);
+    if (mem == nullptr)
+        return nullptr;
+
+    if (!compiler.finalize(static_cast<uint8_t *>(mem)) || !protect_executable(mem, size))
+    {
+        free_executable(mem, size);
+        return nullptr;
+    }
+
+    _code = mem;
+    _code_size = size;
+    entry = reinterpret_cast<vm_exec_t>(mem);
+    _entry.store(entry, std::memory_order_release);
+
+    if (disvm::debug::is_component_tracing_enabled<component_trace_t::module>())
+    {
+        disvm::debug::log_msg(
+            component_trace_t::module,
+            log_level_t::debug,
+            "jit: compile: >>%s<< %d instructions %d inlined %d bytes",
+            _module.module_name->str(),
+            _module.code_section.size(),
+            compiler.get_inlined_count(),
+            size);
+    }
+#endif
+
+    return entry;
+}
+
+void disvm::runtime::prepare_native_code(vm_module_t &module)
+{
+    const auto flags = module.header.runtime_flag;
+    if (util::has_flag(flags, runtime_flags_t::builtin)
+        || util::has_flag(flags, runtime_flags_t::dont_compile)
+        || module.native_code != nullptr)
+        return;
+
+    // Native code trusts operands so only verified modules are compiled
+    if (!module.verified)
+    {
+        if (util::has_flag(flags, runtime_flags_t::must_compile))
+            disvm::debug::log_msg(component_trace_t::module, log_level_t::warning, "jit: module not verified: >>%s<<", module.module_name->str());
+
+        return;
+    }
+
+    if (!vm_native_code_t::is_supported())
+    {
+        if (util::has_flag(flags, runtime_flags_t::must_compile))
+            disvm::debug::log_msg(component_trace_t::module, log_level_t::warning, "jit: not supported on host: >>%s<<", module.module_name->str());
+
+        return;
+    }
+
+    module.native_code = std::make_shared<vm_native_code_t>(module);
+}
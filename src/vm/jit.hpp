@@ -0,0 +1,70 @@
+//
+// Dis VM
+// File: jit.hpp
+// Author: arr
+//
+
+#ifndef _DISVM_SRC_VM_JIT_HPP_
+#define _DISVM_SRC_VM_JIT_HPP_
+
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <runtime.hpp>
+
+namespace disvm
+{
+    namespace runtime
+    {
+        // Native code compiled from the code section of a module.
+        //
+        // Compilation is deferred until the interpreter has executed a number of back-edges
+        // and calls in the module or immediately if the module is marked 'must_compile'.
+        // Simple word operations and branches are translated directly, all other
+        // instructions call back into the execution table.
+        class vm_native_code_t final
+        {
+        public: // static
+            // Returns 'true' if native code can be generated on the host architecture.
+            static bool is_supported();
+
+        public:
+            vm_native_code_t(const vm_module_t &module);
+            vm_native_code_t(const vm_native_code_t &) = delete;
+            vm_native_code_t &operator=(const vm_native_code_t &) = delete;
+
+            ~vm_native_code_t();
+
+            // Record a back-edge or call interpreted in the module. Returns 'true' if the
+            // module has been compiled, or is now hot enough to be, and the interpreter
+            // should return so native code can be entered.
+            bool is_hot();
+
+            // Execute native code at the current program counter. Returns 'false' if the
+            // module hasn't been compiled and isn't hot yet, in which case the caller should
+            // interpret the instruction at the current program counter.
+            //
+            // Native code returns when control leaves the module, a branch target can't be
+            // determined, the thread quanta is consumed, or the thread is no longer running.
+            bool try_execute(vm_registers_t &r, vm_t &vm);
+
+        private:
+            vm_exec_t compile(const vm_registers_t &r);
+
+            const vm_module_t &_module;
+            std::atomic<vm_exec_t> _entry;
+            std::atomic<uint32_t> _hotness_count;
+            std::atomic<uint32_t> _compile_threshold;
+
+            std::mutex _compile_lock;
+            void *_code;
+            std::size_t _code_size;
+        };
+
+        // Create the native code state for the supplied module.
+        // Modules marked 'dont_compile', unverified modules, and built-in modules are never compiled.
+        void prepare_native_code(vm_module_t &module);
+    }
+}
+
+#endif // _DISVM_SRC_VM_JIT_HPP_
@@ -0,0 +1,188 @@
+//
+// Dis VM
+// File: mapped_file.cpp
+// Author: arr
+//
+
+#include <cassert>
+#include <sstream>
+#include "mapped_file.hpp"
+
+// [PAL] Memory mapped files
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using disvm::runtime::byte_t;
+using disvm::util::mapped_file_t;
+
+namespace
+{
+#ifdef _WIN32
+    bool map_file(const char *path, const byte_t *&data, std::size_t &size, int64_t &modified_time)
+    {
+        auto file = ::CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+
+        auto success = false;
+        LARGE_INTEGER file_size;
+        FILETIME write_time;
+        if (::GetFileSizeEx(file, &file_size)
+            && static_cast<ULONGLONG>(file_size.QuadPart) <= SIZE_MAX
+            && ::GetFileTime(file, nullptr, nullptr, &write_time))
+        {
+            size = static_cast<std::size_t>(file_size.QuadPart);
+            modified_time = (static_cast<int64_t>(write_time.dwHighDateTime) << 32) | write_time.dwLowDateTime;
+            success = true;
+
+            // Empty files can't be mapped
+            if (size != 0)
+            {
+                auto mapping = ::CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                if (mapping != nullptr)
+                {
+                    data = static_cast<const byte_t *>(::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+                    ::CloseHandle(mapping);
+                }
+
+                success = (data != nullptr);
+            }
+        }
+
+        ::CloseHandle(file);
+        return success;
+    }
+
+    void unmap_file(const byte_t *data, std::size_t)
+    {
+        ::UnmapViewOfFile(data);
+    }
+
+    bool write_file_identity(const char *path, std::stringstream &identity)
+    {
+        auto file = ::CreateFileA(path, 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+
+        BY_HANDLE_FILE_INFORMATION info;
+        const auto success = ::GetFileInformationByHandle(file, &info) != FALSE
+            && (info.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0;
+
+        ::CloseHandle(file);
+        if (!success)
+            return false;
+
+        identity << info.dwVolumeSerialNumber
+            << ':' << info.nFileIndexHigh << ':' << info.nFileIndexLow
+            << ':' << info.ftLastWriteTime.dwHighDateTime << ':' << info.ftLastWriteTime.dwLowDateTime
+            << ':' << info.nFileSizeHigh << ':' << info.nFileSizeLow;
+        return true;
+    }
+#else
+    bool map_file(const char *path, const byte_t *&data, std::size_t &size, int64_t &modified_time)
+    {
+        const auto fd = ::open(path, O_RDONLY);
+        if (fd == -1)
+            return false;
+
+        auto success = false;
+        struct stat file_stat;
+        if (::fstat(fd, &file_stat) == 0 && S_ISREG(file_stat.st_mode))
+        {
+            size = static_cast<std::size_t>(file_stat.st_size);
+            modified_time = static_cast<int64_t>(file_stat.st_mtime);
+            success = true;
+
+            // Empty files can't be mapped
+            if (size != 0)
+            {
+                auto mem = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (mem != MAP_FAILED)
+                    data = static_cast<const byte_t *>(mem);
+
+                success = (data != nullptr);
+            }
+        }
+
+        ::close(fd);
+        return success;
+    }
+
+    void unmap_file(const byte_t *data, std::size_t size)
+    {
+        ::munmap(const_cast<byte_t *>(data), size);
+    }
+
+    bool write_file_identity(const char *path, std::stringstream &identity)
+    {
+        struct stat file_stat;
+        if (::stat(path, &file_stat) != 0 || !S_ISREG(file_stat.st_mode))
+            return false;
+
+        identity << file_stat.st_dev << ':' << file_stat.st_ino
+            << ':' << file_stat.st_mtime << ':' << file_stat.st_size;
+        return true;
+    }
+#endif
+}
+
+mapped_file_t::mapped_file_t(const char *path)
+    : _open{ false }
+    , _data{ nullptr }
+    , _size{ 0 }
+    , _modified_time{ 0 }
+{
+    assert(path != nullptr);
+    _open = map_file(path, _data, _size, _modified_time);
+    if (!_open)
+    {
+        _data = nullptr;
+        _size = 0;
+        _modified_time = 0;
+    }
+}
+
+mapped_file_t::~mapped_file_t()
+{
+    if (_data != nullptr)
+        unmap_file(_data, _size);
+}
+
+bool mapped_file_t::is_open() const
+{
+    return _open;
+}
+
+const byte_t *mapped_file_t::data() const
+{
+    return _data;
+}
+
+std::size_t mapped_file_t::size() const
+{
+    return _size;
+}
+
+int64_t mapped_file_t::modified_time() const
+{
+    return _modified_time;
+}
+
+bool disvm::util::get_file_identity(const char *path, std::string &identity)
+{
+    assert(path != nullptr);
+    std::stringstream identity_stream;
+    if (!write_file_identity(path, identity_stream))
+        return false;
+
+    identity = identity_stream.str();
+    return true;
+}
@@ -0,0 +1,51 @@
+//
+// Dis VM
+// File: mapped_file.hpp
+// Author: arr
+//
+
+#ifndef _DISVM_SRC_VM_MAPPED_FILE_HPP_
+#define _DISVM_SRC_VM_MAPPED_FILE_HPP_
+
+#include <cstdint>
+#include <string>
+#include <runtime.hpp>
+
+namespace disvm
+{
+    namespace util
+    {
+        // Read-only view of an entire file mapped into memory
+        class mapped_file_t final
+        {
+        public:
+            // Map the file at the supplied path. Check is_open() to determine if the file was mapped.
+            mapped_file_t(const char *path);
+            mapped_file_t(const mapped_file_t &) = delete;
+            mapped_file_t &operator=(const mapped_file_t &) = delete;
+
+            ~mapped_file_t();
+
+            bool is_open() const;
+
+            const runtime::byte_t *data() const;
+
+            std::size_t size() const;
+
+            // Last modification time of the file in platform specific units.
+            int64_t modified_time() const;
+
+        private:
+            bool _open;
+            const runtime::byte_t *_data;
+            std::size_t _size;
+            int64_t _modified_time;
+        };
+
+        // Get a string identifying the regular file at the supplied path, that changes if the file is modified.
+        // Paths referring to the same file have the same identity. Returns 'false' if the file doesn't exist.
+        bool get_file_identity(const char *path, std::string &identity);
+    }
+}
+
+#endif // _DISVM_SRC_VM_MAPPED_FILE_HPP_
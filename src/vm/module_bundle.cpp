@@ -0,0 +1,265 @@
+//
+// Dis VM
+// File: module_bundle.cpp
+// Author: arr
+//
+
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+#include <ostream>
+#include <disvm.hpp>
+#include <debug.hpp>
+#include <exceptions.hpp>
+#include <module_bundle.hpp>
+#include "mapped_file.hpp"
+
+using disvm::debug::component_trace_t;
+using disvm::debug::log_level_t;
+
+using disvm::runtime::byte_t;
+using disvm::runtime::vm_module_t;
+using disvm::runtime::bundle_file_t;
+using disvm::runtime::bundle_resolver_t;
+using disvm::runtime::vm_module_exception;
+using disvm::runtime::vm_system_exception;
+using disvm::util::mapped_file_t;
+
+namespace
+{
+    const auto bundle_magic = uint32_t{ 0x424d5644 }; // 'DVMB'
+    const auto bundle_version = uint32_t{ 1 };
+
+    // File contents are aligned so they can be read in place.
+    const auto file_alignment = uint32_t{ 8 };
+
+    struct bundle_header_t
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t file_count;
+    };
+
+    // Offsets are from the beginning of the bundle
+    struct bundle_index_entry_t
+    {
+        uint32_t name_offset;
+        uint32_t name_length;
+        uint32_t data_offset;
+        uint32_t data_size;
+    };
+
+    uint32_t align_offset(uint32_t offset)
+    {
+        return (offset + (file_alignment - 1)) & ~(file_alignment - 1);
+    }
+
+    // Split a path into its components. Either '/' or '\\' separate components, empty
+    // and '.' components are dropped, and '..' removes the preceding component.
+    std::vector<std::string> split_path(const char *path)
+    {
+        auto components = std::vector<std::string>{};
+        auto component = std::string{};
+        for (auto c = path; ; ++c)
+        {
+            if (*c != '\0' && *c != '/' && *c != '\\')
+            {
+                component.push_back(*c);
+                continue;
+            }
+
+            if (component == "..")
+            {
+                if (!components.empty())
+                    components.pop_back();
+            }
+            else if (!component.empty() && component != ".")
+            {
+                components.push_back(std::move(component));
+            }
+
+            component.clear();
+            if (*c == '\0')
+                break;
+        }
+
+        return components;
+    }
+
+    std::string join_path(const std::vector<std::string> &components)
+    {
+        auto path = std::string{};
+        for (const auto &c : components)
+        {
+            if (!path.empty())
+                path.push_back('/');
+
+            path.append(c);
+        }
+
+        return path;
+    }
+
+    // Returns 'true' if the shorter path is made up of the trailing components of the longer path.
+    bool is_component_suffix(const std::vector<std::string> &a, const std::vector<std::string> &b)
+    {
+        const auto &longer = (a.size() < b.size()) ? b : a;
+        const auto &shorter = (a.size() < b.size()) ? a : b;
+        return std::equal(shorter.crbegin(), shorter.crend(), longer.crbegin());
+    }
+}
+
+void disvm::runtime::write_module_bundle(std::ostream &bundle, const std::vector<bundle_file_t> &files)
+{
+    auto header = bundle_header_t{};
+    header.magic = bundle_magic;
+    header.version = bundle_version;
+    header.file_count = static_cast<uint32_t>(files.size());
+
+    // Names follow the index and the contents of each file follow the names
+    auto offset = static_cast<uint64_t>(sizeof(header) + (files.size() * sizeof(bundle_index_entry_t)));
+    auto index = std::vector<bundle_index_entry_t>(files.size());
+    for (auto i = std::size_t{ 0 }; i < files.size(); ++i)
+    {
+        index[i].name_offset = static_cast<uint32_t>(offset);
+        index[i].name_length = static_cast<uint32_t>(files[i].name.size());
+        offset += files[i].name.size();
+    }
+
+    const auto names_end = offset;
+
+    for (auto i = std::size_t{ 0 }; i < files.size(); ++i)
+    {
+        offset = align_offset(static_cast<uint32_t>(offset));
+        index[i].data_offset = static_cast<uint32_t>(offset);
+        index[i].data_size = static_cast<uint32_t>(files[i].contents.size());
+        offset += files[i].contents.size();
+
+        if (offset > UINT32_MAX)
+            throw vm_system_exception{ "Module bundle too large" };
+    }
+
+    bundle.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    bundle.write(reinterpret_cast<const char *>(index.data()), index.size() * sizeof(bundle_index_entry_t));
+    for (const auto &f : files)
+        bundle.write(f.name.data(), f.name.size());
+
+    auto written = static_cast<uint32_t>(names_end);
+    for (auto i = std::size_t{ 0 }; i < files.size(); ++i)
+    {
+        const char padding[file_alignment] = {};
+        bundle.write(padding, index[i].data_offset - written);
+        bundle.write(reinterpret_cast<const char *>(files[i].contents.data()), files[i].contents.size());
+        written = index[i].data_offset + index[i].data_size;
+    }
+
+    if (!bundle.good())
+        throw vm_system_exception{ "Failed to write module bundle" };
+}
+
+bundle_resolver_t::bundle_resolver_t(const char *bundle_path)
+    : _bundle{ std::make_unique<mapped_file_t>(bundle_path) }
+{
+    assert(bundle_path != nullptr);
+    if (!_bundle->is_open())
+        throw vm_module_exception{ "Unable to open module bundle" };
+
+    const auto data = _bundle->data();
+    const auto size = _bundle->size();
+
+    auto header = bundle_header_t{};
+    if (size < sizeof(header))
+        throw vm_module_exception{ "Invalid module bundle" };
+
+    std::memcpy(&header, data, sizeof(header));
+    if (header.magic != bundle_magic || header.version != bundle_version)
+        throw vm_module_exception{ "Invalid module bundle" };
+
+    if (((size - sizeof(header)) / sizeof(bundle_index_entry_t)) < header.file_count)
+        throw vm_module_exception{ "Invalid module bundle index" };
+
+    _files.reserve(header.file_count);
+    for (auto i = uint32_t{ 0 }; i < header.file_count; ++i)
+    {
+        auto entry = bundle_index_entry_t{};
+        std::memcpy(&entry, data + sizeof(header) + (i * sizeof(entry)), sizeof(entry));
+
+        if (size < entry.name_offset || (size - entry.name_offset) < entry.name_length
+            || size < entry.data_offset || (size - entry.data_offset) < entry.data_size)
+            throw vm_module_exception{ "Invalid module bundle entry" };
+
+        const auto name = std::string{ reinterpret_cast<const char *>(data + entry.name_offset), entry.name_length };
+        const auto components = split_path(name.c_str());
+        if (components.empty())
+            throw vm_module_exception{ "Invalid module bundle entry" };
+
+        auto path = join_path(components);
+        if (_files.find(path) == _files.cend())
+            _paths_by_file_name.emplace(components.back(), path);
+
+        _files[std::move(path)] = file_t{ data + entry.data_offset, entry.data_size };
+    }
+
+    if (disvm::debug::is_component_tracing_enabled<component_trace_t::module>())
+        disvm::debug::log_msg(component_trace_t::module, log_level_t::debug, "bundle: open: >>%s<< %d files", bundle_path, _files.size());
+}
+
+bundle_resolver_t::~bundle_resolver_t()
+{ }
+
+bool bundle_resolver_t::try_resolve_module(const char *path, std::unique_ptr<vm_module_t> &new_module)
+{
+    assert(path != nullptr);
+
+    const auto file = find_module_file(path);
+    if (file == nullptr)
+        return false;
+
+    if (disvm::debug::is_component_tracing_enabled<component_trace_t::module>())
+        disvm::debug::log_msg(component_trace_t::module, log_level_t::debug, "bundle: resolve: >>%s<<", path);
+
+    new_module = disvm::read_module(file->data, file->size);
+    assert(new_module != nullptr);
+
+    return true;
+}
+
+const bundle_resolver_t::file_t *bundle_resolver_t::find_module_file(const char *path) const
+{
+    const auto components = split_path(path);
+    if (components.empty())
+        return nullptr;
+
+    const auto iter = _files.find(join_path(components));
+    if (iter != _files.cend())
+        return &iter->second;
+
+    // Bundle paths and requested paths may be relative to different roots
+    auto match = static_cast<const file_t *>(nullptr);
+    const auto candidates = _paths_by_file_name.equal_range(components.back());
+    for (auto c = candidates.first; c != candidates.second; ++c)
+    {
+        if (!is_component_suffix(components, split_path(c->second.c_str())))
+            continue;
+
+        if (match != nullptr)
+            throw vm_module_exception{ "Module path matches more than one file in bundle" };
+
+        match = &_files.at(c->second);
+    }
+
+    return match;
+}
+
+bool bundle_resolver_t::try_get_file(const char *name, const byte_t *&data, std::size_t &size) const
+{
+    assert(name != nullptr);
+
+    const auto iter = _files.find(join_path(split_path(name)));
+    if (iter == _files.cend())
+        return false;
+
+    data = iter->second.data;
+    size = iter->second.size;
+    return true;
+}
@@ -0,0 +1,759 @@
+//
+// Dis VM
+// File: module_image.cpp
+// Author: arr
+//
+
+#include <cassert>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <vector>
+#include <debug.hpp>
+#include <disvm.hpp>
+#include <exceptions.hpp>
+#include "mapped_file.hpp"
+#include "module_image.hpp"
+
+using disvm::debug::component_trace_t;
+using disvm::debug::log_level_t;
+
+using disvm::runtime::byte_t;
+using disvm::runtime::word_t;
+using disvm::runtime::pointer_t;
+using disvm::runtime::vm_pc_t;
+using disvm::runtime::vm_alloc_t;
+using disvm::runtime::vm_array_t;
+using disvm::runtime::vm_string_t;
+using disvm::runtime::vm_module_t;
+using disvm::runtime::vm_instruction_t;
+using disvm::runtime::runtime_flags_t;
+using disvm::runtime::type_descriptor_t;
+using disvm::runtime::export_function_t;
+using disvm::runtime::module_image_key_t;
+using disvm::runtime::module_image_cache_t;
+using disvm::runtime::module_reader_exception;
+using disvm::util::mapped_file_t;
+
+namespace
+{
+    const auto image_magic = uint32_t{ 0x494d5644 }; // 'DVMI'
+    const auto image_version = uint32_t{ 3 };
+    const auto image_extension = ".dmi";
+
+    const auto no_string = uint32_t{ ~0u };
+    const auto no_type = word_t{ -1 };
+    const auto end_of_pointers = word_t{ -1 };
+
+    struct image_header_t
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t pointer_size;
+        uint32_t instruction_size;
+        module_image_key_t key;
+        uint64_t checksum; // Hash of the image contents following the header
+    };
+
+    // FNV-1a
+    uint64_t compute_hash(const byte_t *data, std::size_t size)
+    {
+        auto hash = uint64_t{ 0xcbf29ce484222325 };
+        for (auto i = std::size_t{ 0 }; i < size; ++i)
+        {
+            hash ^= data[i];
+            hash *= uint64_t{ 0x100000001b3 };
+        }
+
+        return hash;
+    }
+
+    enum class object_kind_t : byte_t
+    {
+        string = 1,
+        array = 2,
+    };
+
+    // Byte offsets of the pointers in the supplied type
+    std::vector<std::size_t> get_pointer_offsets(const type_descriptor_t &type)
+    {
+        auto offsets = std::vector<std::size_t>{};
+        for (auto i = word_t{ 0 }; i < type.map_in_bytes; ++i)
+        {
+            const auto words8 = type.pointer_map[i];
+            if (words8 == 0)
+                continue;
+
+            // Highest order bit is the first field
+            for (auto b = std::size_t{ 0 }; b < 8; ++b)
+            {
+                if ((words8 & (0x80 >> b)) == 0)
+                    continue;
+
+                const auto offset = ((i * 8) + b) * sizeof(pointer_t);
+                if ((offset + sizeof(pointer_t)) <= static_cast<std::size_t>(type.size_in_bytes))
+                    offsets.push_back(offset);
+            }
+        }
+
+        return offsets;
+    }
+
+    word_t find_type_id(const vm_module_t &module, const type_descriptor_t *type)
+    {
+        for (auto i = std::size_t{ 0 }; i < module.type_section.size(); ++i)
+        {
+            if (module.type_section[i].get() == type)
+                return static_cast<word_t>(i);
+        }
+
+        return no_type;
+    }
+
+    class image_writer_t final
+    {
+    public:
+        image_writer_t(const vm_module_t &module)
+            : _module{ module }
+        { }
+
+        template<typename T>
+        void write(const T &value)
+        {
+            write_bytes(&value, sizeof(value));
+        }
+
+        void write_bytes(const void *data, std::size_t size)
+        {
+            const auto bytes = static_cast<const byte_t *>(data);
+            _buffer.insert(_buffer.end(), bytes, bytes + size);
+        }
+
+        void write_string(const vm_string_t *str)
+        {
+            if (str == nullptr)
+            {
+                write(no_string);
+                return;
+            }
+
+            const auto encoded = str->str();
+            const auto length = static_cast<uint32_t>(std::strlen(encoded));
+            write(length);
+            write_bytes(encoded, length);
+        }
+
+        // Write the contents of memory described by the supplied type and the objects it references.
+        bool write_data(const type_descriptor_t &type, const byte_t *base)
+        {
+            const auto pointer_offsets = get_pointer_offsets(type);
+
+            // Pointers are recreated when the image is loaded
+            auto contents = std::vector<byte_t>(base, base + type.size_in_bytes);
+            for (auto offset : pointer_offsets)
+                std::memset(contents.data() + offset, 0, sizeof(pointer_t));
+
+            write_bytes(contents.data(), contents.size());
+
+            for (auto offset : pointer_offsets)
+            {
+                const auto allocation = *reinterpret_cast<const pointer_t *>(base + offset);
+                if (allocation == reinterpret_cast<pointer_t>(disvm::runtime::runtime_constants::nil))
+                    continue;
+
+                write(static_cast<word_t>(offset));
+                if (!write_object(*vm_alloc_t::from_allocation(allocation)))
+                    return false;
+            }
+
+            write(end_of_pointers);
+            return true;
+        }
+
+        const std::vector<byte_t> &get_buffer() const
+        {
+            return _buffer;
+        }
+
+        // Record the hash of the contents following the header
+        void write_checksum()
+        {
+            assert(_buffer.size() >= sizeof(image_header_t));
+            const auto checksum = compute_hash(_buffer.data() + sizeof(image_header_t), _buffer.size() - sizeof(image_header_t));
+            std::memcpy(_buffer.data() + offsetof(image_header_t, checksum), &checksum, sizeof(checksum));
+        }
+
+    private:
+        // Only the objects created by the data section of a module are supported.
+        bool write_object(const vm_alloc_t &alloc)
+        {
+            if (alloc.alloc_type == vm_string_t::type_desc().get())
+            {
+                const auto &str = static_cast<const vm_string_t &>(alloc);
+
+                // Encoded strings are null terminated
+                for (auto i = word_t{ 0 }; i < str.get_length(); ++i)
+                {
+                    if (str.get_rune(i) == 0)
+                        return false;
+                }
+
+                write(object_kind_t::string);
+                write_string(&str);
+                return true;
+            }
+
+            if (alloc.alloc_type == vm_array_t::type_desc().get())
+            {
+                const auto &arr = static_cast<const vm_array_t &>(alloc);
+                const auto element_type = arr.get_element_type();
+                const auto type_id = find_type_id(_module, element_type.get());
+                if (type_id == no_type)
+                    return false;
+
+                const auto length = arr.get_length();
+                write(object_kind_t::array);
+                write(type_id);
+                write(length);
+
+                if (length == 0)
+                    return true;
+
+                if (get_pointer_offsets(*element_type).empty())
+                {
+                    write_bytes(arr.at(0), static_cast<std::size_t>(length) * element_type->size_in_bytes);
+                    return true;
+                }
+
+                for (auto i = word_t{ 0 }; i < length; ++i)
+                {
+                    if (!write_data(*element_type, reinterpret_cast<const byte_t *>(arr.at(i))))
+                        return false;
+                }
+
+                return true;
+            }
+
+            return false;
+        }
+
+        const vm_module_t &_module;
+        std::vector<byte_t> _buffer;
+    };
+
+    class image_reader_t final
+    {
+    public:
+        image_reader_t(const byte_t *data, std::size_t size, vm_module_t &module)
+            : _data{ data }
+            , _size{ size }
+            , _offset{ 0 }
+            , _module{ module }
+        { }
+
+        template<typename T>
+        T read()
+        {
+            auto value = T{};
+            read_bytes(&value, sizeof(value));
+            return value;
+        }
+
+        void read_bytes(void *dest, std::size_t size)
+        {
+            std::memcpy(dest, get_bytes(size), size);
+        }
+
+        const byte_t *get_bytes(std::size_t size)
+        {
+            if ((_size - _offset) < size)
+                throw module_reader_exception{ "Truncated module image" };
+
+            const auto bytes = _data + _offset;
+            _offset += size;
+            return bytes;
+        }
+
+        // Read the number of items that follow, each of which is at least the supplied size
+        uint32_t read_count(std::size_t min_item_size)
+        {
+            const auto count = read<uint32_t>();
+            if ((_size - _offset) / min_item_size < count)
+                throw module_reader_exception{ "Truncated module image" };
+
+            return count;
+        }
+
+        std::unique_ptr<vm_string_t> read_string()
+        {
+            const auto length = read<uint32_t>();
+            if (length == no_string)
+                return{};
+
+            return std::make_unique<vm_string_t>(length, get_bytes(length));
+        }
+
+        std::shared_ptr<const type_descriptor_t> read_type_id()
+        {
+            const auto type_id = read<word_t>();
+            if (type_id == no_type)
+                return{};
+
+            if (type_id < 0 || _module.type_section.size() <= static_cast<std::size_t>(type_id) || _module.type_section[type_id] == nullptr)
+                throw module_reader_exception{ "Invalid type in module image" };
+
+            return _module.type_section[type_id];
+        }
+
+        // Read the contents of memory described by the supplied type and the objects it references.
+        void read_data(const type_descriptor_t &type, byte_t *base)
+        {
+            read_bytes(base, type.size_in_bytes);
+
+            for (;;)
+            {
+                const auto offset = read<word_t>();
+                if (offset == end_of_pointers)
+                    break;
+
+                if (offset < 0 || type.size_in_bytes < offset || (type.size_in_bytes - offset) < static_cast<word_t>(sizeof(pointer_t)))
+                    throw module_reader_exception{ "Invalid pointer offset in module image" };
+
+                read_object(*reinterpret_cast<pointer_t *>(base + offset));
+            }
+        }
+
+        bool is_complete() const
+        {
+            return _offset == _size;
+        }
+
+    private:
+        // The object is stored in the destination before it is populated so it is
+        // released with the containing memory if the image is invalid.
+        void read_object(pointer_t &dest)
+        {
+            switch (read<object_kind_t>())
+            {
+            case object_kind_t::string:
+            {
+                auto str = read_string();
+                if (str == nullptr)
+                    throw module_reader_exception{ "Invalid string in module image" };
+
+                dest = str.release()->get_allocation();
+                break;
+            }
+            case object_kind_t::array:
+            {
+                const auto element_type = read_type_id();
+                const auto length = read<word_t>();
+                if (element_type == nullptr || length < 0)
+                    throw module_reader_exception{ "Invalid array in module image" };
+
+                auto arr = new vm_array_t(element_type, length);
+                dest = arr->get_allocation();
+
+                if (length == 0)
+                    break;
+
+                if (get_pointer_offsets(*element_type).empty())
+                {
+                    read_bytes(arr->at(0), static_cast<std::size_t>(length) * element_type->size_in_bytes);
+                    break;
+                }
+
+                for (auto i = word_t{ 0 }; i < length; ++i)
+                    read_data(*element_type, reinterpret_cast<byte_t *>(arr->at(i)));
+
+                break;
+            }
+            default:
+                throw module_reader_exception{ "Unknown object in module image" };
+            }
+        }
+
+        const byte_t *_data;
+        const std::size_t _size;
+        std::size_t _offset;
+        vm_module_t &_module;
+    };
+
+    std::string append_separator(std::string path)
+    {
+        if (!path.empty() && path.back() != '/' && path.back() != '\\')
+            path.push_back('/');
+
+        return path;
+    }
+
+    image_header_t create_image_header(const module_image_key_t &key)
+    {
+        auto header = image_header_t{};
+        header.magic = image_magic;
+        header.version = image_version;
+        header.pointer_size = sizeof(pointer_t);
+        header.instruction_size = sizeof(vm_instruction_t);
+        header.key = key;
+        return header;
+    }
+
+    bool write_module_image(image_writer_t &writer, const module_image_key_t &key, const vm_module_t &module)
+    {
+        writer.write(create_image_header(key));
+
+        const auto &header = module.header;
+        writer.write(header.magic_number);
+        writer.write(header.Signature.length);
+        writer.write_bytes(header.Signature.signature.get(), header.Signature.length);
+        writer.write(header.runtime_flag);
+        writer.write(header.stack_extent);
+        writer.write(header.code_size);
+        writer.write(header.data_size);
+        writer.write(header.type_size);
+        writer.write(header.export_size);
+        writer.write(header.entry_pc);
+        writer.write(header.entry_type);
+
+        // Instructions are stored in their packed form
+        writer.write(static_cast<uint32_t>(module.code_section.size()));
+        writer.write_bytes(module.code_section.data(), module.code_section.size() * sizeof(vm_instruction_t));
+
+        writer.write(static_cast<uint32_t>(module.type_section.size()));
+        for (const auto &type : module.type_section)
+        {
+            if (type == nullptr)
+            {
+                writer.write(no_type);
+                continue;
+            }
+
+            writer.write(type->size_in_bytes);
+            writer.write(type->map_in_bytes);
+            writer.write_bytes(type->pointer_map, type->map_in_bytes);
+        }
+
+        writer.write_string(module.module_name.get());
+
+        writer.write(static_cast<uint32_t>(module.export_section.size()));
+        for (const auto &e : module.export_section)
+        {
+            writer.write(e.second.pc);
+            writer.write(e.second.frame_type);
+            writer.write(e.second.sig);
+            writer.write_string(e.second.name.get());
+        }
+
+        writer.write(static_cast<uint32_t>(module.import_section.size()));
+        for (const auto &import_module : module.import_section)
+        {
+            writer.write(static_cast<uint32_t>(import_module.functions.size()));
+            for (const auto &func : import_module.functions)
+            {
+                writer.write(func.sig);
+                writer.write_string(func.name.get());
+            }
+        }
+
+        writer.write(static_cast<uint32_t>(module.handler_section.size()));
+        for (const auto &handler : module.handler_section)
+        {
+            writer.write(handler.exception_offset);
+            writer.write(handler.begin_pc);
+            writer.write(handler.end_pc);
+            writer.write(handler.exception_type_count);
+
+            const auto type_id = (handler.type_desc == nullptr) ? no_type : find_type_id(module, handler.type_desc.get());
+            if (handler.type_desc != nullptr && type_id == no_type)
+                return false;
+
+            writer.write(type_id);
+
+            writer.write(static_cast<uint32_t>(handler.exception_table.size()));
+            for (const auto &except : handler.exception_table)
+            {
+                writer.write(except.pc);
+                writer.write_string(except.name.get());
+            }
+        }
+
+        writer.write(static_cast<byte_t>(module.original_mp != nullptr));
+        if (module.original_mp != nullptr
+            && !writer.write_data(*module.original_mp->alloc_type, module.original_mp->get_allocation<byte_t>()))
+            return false;
+
+        writer.write_checksum();
+        return true;
+    }
+
+    bool is_pc_valid(vm_pc_t pc, const vm_module_t &module)
+    {
+        return 0 <= pc && static_cast<std::size_t>(pc) < module.code_section.size();
+    }
+
+    bool is_frame_type_valid(word_t type_id, const vm_module_t &module)
+    {
+        return 0 <= type_id
+            && static_cast<std::size_t>(type_id) < module.type_section.size()
+            && module.type_section[type_id] != nullptr;
+    }
+
+    // Confirm the indices in the image refer to the module's code and types. Operands
+    // are proven valid by the verifier once the module is complete.
+    void validate_module_indices(const vm_module_t &module)
+    {
+        const auto &header = module.header;
+        if (header.code_size < 0 || module.code_section.size() != static_cast<std::size_t>(header.code_size)
+            || header.type_size < 0 || module.type_section.size() != static_cast<std::size_t>(header.type_size))
+            throw module_reader_exception{ "Invalid section size in module image" };
+
+        if (header.entry_pc != disvm::runtime::runtime_constants::invalid_program_counter
+            && (!is_pc_valid(header.entry_pc, module) || !is_frame_type_valid(header.entry_type, module)))
+            throw module_reader_exception{ "Invalid entry in module image" };
+
+        for (const auto &e : module.export_section)
+        {
+            if (!is_pc_valid(e.second.pc, module) || !is_frame_type_valid(e.second.frame_type, module))
+                throw module_reader_exception{ "Invalid export in module image" };
+        }
+
+        for (const auto &handler : module.handler_section)
+        {
+            if (!is_pc_valid(handler.begin_pc, module)
+                || handler.end_pc < handler.begin_pc
+                || module.code_section.size() < static_cast<std::size_t>(handler.end_pc)
+                || handler.exception_type_count < 0
+                || handler.exception_table.size() < static_cast<std::size_t>(handler.exception_type_count))
+                throw module_reader_exception{ "Invalid handler in module image" };
+
+            for (const auto &except : handler.exception_table)
+            {
+                if (except.pc != disvm::runtime::runtime_constants::invalid_program_counter && !is_pc_valid(except.pc, module))
+                    throw module_reader_exception{ "Invalid handler in module image" };
+            }
+        }
+    }
+
+    std::unique_ptr<vm_module_t> read_module_image(const byte_t *data, std::size_t size, const module_image_key_t &key)
+    {
+        auto modobj = std::make_unique<vm_module_t>();
+        auto reader = image_reader_t{ data, size, *modobj };
+
+        const auto expected_header = create_image_header(key);
+        const auto image_header = reader.read<image_header_t>();
+        if (image_header.magic != expected_header.magic
+            || image_header.version != expected_header.version
+            || image_header.pointer_size != expected_header.pointer_size
+            || image_header.instruction_size != expected_header.instruction_size
+            || image_header.key.hash != expected_header.key.hash
+            || image_header.key.modified_time != expected_header.key.modified_time
+            || image_header.key.size != expected_header.key.size)
+            return{};
+
+        if (image_header.checksum != compute_hash(data + sizeof(image_header_t), size - sizeof(image_header_t)))
+            throw module_reader_exception{ "Corrupt module image" };
+
+        auto &header = modobj->header;
+        header.magic_number = reader.read<word_t>();
+        header.Signature.length = reader.read<word_t>();
+        if (header.Signature.length < 0)
+            throw module_reader_exception{ "Invalid signature in module image" };
+
+        header.Signature.signature = std::make_unique<byte_t[]>(header.Signature.length);
+        reader.read_bytes(header.Signature.signature.get(), header.Signature.length);
+        header.runtime_flag = reader.read<runtime_flags_t>();
+        header.stack_extent = reader.read<word_t>();
+        header.code_size = reader.read<word_t>();
+        header.data_size = reader.read<word_t>();
+        header.type_size = reader.read<word_t>();
+        header.export_size = reader.read<word_t>();
+        header.entry_pc = reader.read<vm_pc_t>();
+        header.entry_type = reader.read<word_t>();
+
+        const auto code_count = reader.read_count(sizeof(vm_instruction_t));
+        modobj->code_section.resize(code_count);
+        reader.read_bytes(modobj->code_section.data(), code_count * sizeof(vm_instruction_t));
+
+        const auto type_count = reader.read_count(sizeof(word_t));
+        modobj->type_section.resize(type_count);
+        for (auto &type : modobj->type_section)
+        {
+            const auto size = reader.read<word_t>();
+            if (size == no_type)
+                continue;
+
+            const auto map_in_bytes = reader.read<word_t>();
+            if (size < 0 || map_in_bytes < 0)
+                throw module_reader_exception{ "Invalid type in module image" };
+
+            const auto pointer_map = reader.get_bytes(map_in_bytes);
+            type = type_descriptor_t::create(size, std::vector<byte_t>(pointer_map, pointer_map + map_in_bytes));
+        }
+
+        modobj->module_name = reader.read_string();
+
+        const auto export_count = reader.read_count(sizeof(vm_pc_t) + 2 * sizeof(word_t) + sizeof(uint32_t));
+        modobj->export_section.reserve(export_count);
+        for (auto i = uint32_t{ 0 }; i < export_count; ++i)
+        {
+            auto item = export_function_t{};
+            item.pc = reader.read<vm_pc_t>();
+            item.frame_type = reader.read<word_t>();
+            item.sig = reader.read<word_t>();
+            item.name = reader.read_string();
+
+            const auto sig = item.sig;
+            modobj->export_section.emplace(sig, std::move(item));
+        }
+
+        const auto import_module_count = reader.read_count(sizeof(uint32_t));
+        modobj->import_section.resize(import_module_count);
+        for (auto &import_module : modobj->import_section)
+        {
+            const auto function_count = reader.read_count(sizeof(word_t) + sizeof(uint32_t));
+            import_module.functions.resize(function_count);
+            for (auto &func : import_module.functions)
+            {
+                func.sig = reader.read<word_t>();
+                func.name = reader.read_string();
+            }
+        }
+
+        const auto handler_count = reader.read_count(sizeof(word_t));
+        modobj->handler_section.resize(handler_count);
+        for (auto &handler : modobj->handler_section)
+        {
+            handler.exception_offset = reader.read<word_t>();
+            handler.begin_pc = reader.read<vm_pc_t>();
+            handler.end_pc = reader.read<vm_pc_t>();
+            handler.exception_type_count = reader.read<word_t>();
+            handler.type_desc = reader.read_type_id();
+
+            const auto exception_count = reader.read_count(sizeof(vm_pc_t) + sizeof(uint32_t));
+            handler.exception_table.resize(exception_count);
+            for (auto &except : handler.exception_table)
+            {
+                except.pc = reader.read<vm_pc_t>();
+                except.name = reader.read_string();
+            }
+        }
+
+        if (reader.read<byte_t>() != 0)
+        {
+            if (modobj->type_section.empty() || modobj->type_section[0] == nullptr)
+                throw module_reader_exception{ "Invalid type desc for MP" };
+
+            modobj->original_mp.reset(vm_alloc_t::allocate(modobj->type_section[0]));
+            reader.read_data(*modobj->original_mp->alloc_type, modobj->original_mp->get_allocation<byte_t>());
+        }
+
+        if (!reader.is_complete())
+            throw module_reader_exception{ "Unexpected data at end of module image" };
+
+        validate_module_indices(*modobj);
+
+        // Verification isn't recorded in the image so a modified image can't mark its code as trusted
+        modobj->verified = disvm::verify_module(*modobj);
+
+        return modobj;
+    }
+}
+
+module_image_key_t disvm::runtime::compute_module_image_key(const byte_t *data, std::size_t size, int64_t modified_time)
+{
+    auto key = module_image_key_t{};
+    key.hash = compute_hash(data, size);
+    key.modified_time = modified_time;
+    key.size = size;
+    return key;
+}
+
+module_image_cache_t::module_image_cache_t(std::string cache_path)
+    : _cache_path{ append_separator(std::move(cache_path)) }
+{ }
+
+std::unique_ptr<vm_module_t> module_image_cache_t::try_load(const module_image_key_t &key) const
+{
+    const auto image_path = get_image_path(key);
+    auto image = std::make_unique<mapped_file_t>(image_path.c_str());
+    if (!image->is_open())
+        return{};
+
+    try
+    {
+        auto module = read_module_image(image->data(), image->size(), key);
+        if (module != nullptr && disvm::debug::is_component_tracing_enabled<component_trace_t::module>())
+            disvm::debug::log_msg(component_trace_t::module, log_level_t::debug, "image: load: >>%s<<", image_path.c_str());
+
+        return module;
+    }
+    catch (const module_reader_exception &e)
+    {
+        if (disvm::debug::is_component_tracing_enabled<component_trace_t::module>())
+            disvm::debug::log_msg(component_trace_t::module, log_level_t::warning, "image: invalid: %s %s", image_path.c_str(), e.what());
+
+        return{};
+    }
+}
+
+bool module_image_cache_t::try_store(const module_image_key_t &key, const vm_module_t &module) const
+{
+    auto writer = image_writer_t{ module };
+    if (!write_module_image(writer, key, module))
+    {
+        if (disvm::debug::is_component_tracing_enabled<component_trace_t::module>())
+            disvm::debug::log_msg(component_trace_t::module, log_level_t::debug, "image: module data not supported");
+
+        return false;
+    }
+
+    // Write to a temporary file so a partial image is never observed
+    const auto image_path = get_image_path(key);
+    auto temp_path = image_path;
+    temp_path.append(".").append(std::to_string(std::random_device{}()));
+
+    const auto &buffer = writer.get_buffer();
+    {
+        auto image_file = std::ofstream{ temp_path, std::ios::binary | std::ios::trunc };
+        if (image_file.is_open())
+            image_file.write(reinterpret_cast<const char *>(buffer.data()), buffer.size());
+
+        if (!image_file.is_open() || !image_file.good())
+        {
+            if (image_file.is_open())
+            {
+                image_file.close();
+                std::remove(temp_path.c_str());
+            }
+
+            if (disvm::debug::is_component_tracing_enabled<component_trace_t::module>())
+                disvm::debug::log_msg(component_trace_t::module, log_level_t::warning, "image: failed to write: >>%s<<", temp_path.c_str());
+
+            return false;
+        }
+    }
+
+    // [PAL] On Windows rename fails if the image already exists, in which case the existing image is kept.
+    if (std::rename(temp_path.c_str(), image_path.c_str()) != 0)
+    {
+        std::remove(temp_path.c_str());
+        return false;
+    }
+
+    if (disvm::debug::is_component_tracing_enabled<component_trace_t::module>())
+        disvm::debug::log_msg(component_trace_t::module, log_level_t::debug, "image: store: >>%s<<", image_path.c_str());
+
+    return true;
+}
+
+std::string module_image_cache_t::get_image_path(const module_image_key_t &key) const
+{
+    char name[sizeof(key.hash) * 2 + 1];
+    std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key.hash));
+
+    auto path = _cache_path;
+    path.append(name).append(image_extension);
+    return path;
+}
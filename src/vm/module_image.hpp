@@ -0,0 +1,60 @@
+//
+// Dis VM
+// File: module_image.hpp
+// Author: arr
+//
+
+#ifndef _DISVM_SRC_VM_MODULE_IMAGE_HPP_
+#define _DISVM_SRC_VM_MODULE_IMAGE_HPP_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <runtime.hpp>
+
+namespace disvm
+{
+    namespace runtime
+    {
+        // Identifies the module file an image was created from
+        struct module_image_key_t
+        {
+            uint64_t hash; // Hash of the module file contents
+            int64_t modified_time;
+            uint64_t size;
+        };
+
+        // Compute the image key for the supplied module file contents.
+        module_image_key_t compute_module_image_key(const byte_t *data, std::size_t size, int64_t modified_time);
+
+        // Cache of module images on disk.
+        //
+        // An image stores a module after it has been read (i.e. instructions, type maps, MP contents,
+        // and exports) so it can be loaded without parsing the module file. The result of verification
+        // isn't stored, loaded modules are verified again. Images are named by the hash of the module
+        // file contents, include a checksum of their own contents, and are only valid for the build of
+        // the VM that created them.
+        class module_image_cache_t final
+        {
+        public:
+            module_image_cache_t(std::string cache_path);
+            module_image_cache_t(const module_image_cache_t &) = delete;
+            module_image_cache_t &operator=(const module_image_cache_t &) = delete;
+
+            // Load the image for the supplied key.
+            // Returns null if an image doesn't exist, is stale, or is invalid.
+            std::unique_ptr<vm_module_t> try_load(const module_image_key_t &key) const;
+
+            // Store an image of the supplied module.
+            // Returns 'false' if the module contains data that can't be stored or the image couldn't be written.
+            bool try_store(const module_image_key_t &key, const vm_module_t &module) const;
+
+        private:
+            std::string get_image_path(const module_image_key_t &key) const;
+
+            const std::string _cache_path;
+        };
+    }
+}
+
+#endif // _DISVM_SRC_VM_MODULE_IMAGE_HPP_
@@ -5,21 +5,28 @@
 //
 
 #include <cassert>
+#include <algorithm>
 #include <limits>
 #include <memory>
 #include <iostream>
 #include <sstream>
 #include <array>
 #include <tuple>
+#include <map>
 #include <disvm.hpp>
+#include <debug.hpp>
 #include <exceptions.hpp>
 #include <vm_memory.hpp>
 #include <utils.hpp>
 #include <module_reader.hpp>
 #include "buffered_reader.hpp"
+#include "instruction_decoder.hpp"
 
 using disvm::opcode_t;
 
+using disvm::debug::component_trace_t;
+using disvm::debug::log_level_t;
+
 using disvm::format::operand_t;
 
 using disvm::runtime::addr_code_t;
@@ -43,6 +50,13 @@ using disvm::runtime::import_vm_module_t;
 using disvm::runtime::handler_entry_t;
 using disvm::runtime::exception_entry_t;
 using disvm::runtime::vm_instruction_t;
+using disvm::runtime::vm_exec_op_t;
+using disvm::runtime::inst_data_generic_t;
+using disvm::runtime::src_data_t;
+using disvm::runtime::middle_data_t;
+using disvm::runtime::dest_data_t;
+using disvm::runtime::type_operand_t;
+using disvm::runtime::operand_widths_t;
 using disvm::runtime::vm_module_exception;
 using disvm::runtime::module_reader_exception;
 
@@ -72,18 +86,32 @@ namespace
         value_bit64 = 8
     };
 
-    // Read the next operand as defined in the Dis VM specification.
-    std::tuple<bool, operand_t> read_next_operand(disvm::util::buffered_reader_t &reader)
+    // Number of bytes in an operand as indicated by the first byte.
+    std::size_t operand_length(byte_t first)
     {
-        operand_t result;
+        switch (first & 0xc0)
+        {
+        case 0x80:
+            return 2;
+        case 0xc0:
+            return 4;
+        default:
+            return 1;
+        }
+    }
 
-        // Converting stack allocation to buffer since max size of operand is a machine word
-        byte_t buffer[sizeof(result)];
+    // Decode an operand as defined in the Dis VM specification from contiguous bytes.
+    // Returns the number of bytes consumed or 0 if fewer bytes are available than the operand requires.
+    std::size_t decode_operand(const byte_t *bytes, std::size_t available, operand_t &result)
+    {
+        if (available == 0)
+            return 0;
 
-        if (!reader.get_next_bytes(1, buffer))
-            return std::make_tuple(false, 0);
+        const auto length = operand_length(bytes[0]);
+        if (available < length)
+            return 0;
 
-        result = buffer[0];
+        result = bytes[0];
         switch (result & 0xc0)
         {
         case 0x00:
@@ -97,9 +125,6 @@ namespace
 
         case 0x80:
             // 2 byte operand
-            if (!reader.get_next_bytes(1, buffer + 1))
-                return std::make_tuple(false, 0);
-
             // Preserve sign
             if ((result & 0x20) != 0)
                 result |= ~0x3f;
@@ -107,14 +132,11 @@ namespace
                 result &= 0x3f;
 
             result = (result << 8);
-            result |= buffer[1];
+            result |= bytes[1];
             break;
 
         case 0xc0:
             // 4 byte operand
-            if (!reader.get_next_bytes(3, buffer + 1))
-                return std::make_tuple(false, 0);
-
             // Preserve sign
             if ((result & 0x20) != 0)
                 result |= ~0x3f;
@@ -122,15 +144,45 @@ namespace
                 result &= 0x3f;
 
             result = (result << 24);
-            result |= (buffer[1] << 16);
-            result |= (buffer[2] << 8);
-            result |= buffer[3];
+            result |= (bytes[1] << 16);
+            result |= (bytes[2] << 8);
+            result |= bytes[3];
             break;
 
         default:
             assert(false && "Should not be possible");
         }
 
+        return length;
+    }
+
+    // Read the next operand as defined in the Dis VM specification.
+    std::tuple<bool, operand_t> read_next_operand(disvm::util::buffered_reader_t &reader)
+    {
+        auto result = operand_t{};
+
+        // Decode in place if the entire operand is available
+        const byte_t *bytes;
+        const auto available = reader.peek_bytes(bytes);
+        auto length = decode_operand(bytes, available, result);
+        if (length != 0)
+        {
+            reader.skip_bytes(length);
+            return std::make_tuple(true, result);
+        }
+
+        // The operand spans the end of the read buffer
+        // Converting stack allocation to buffer since max size of operand is a machine word
+        byte_t buffer[sizeof(result)];
+
+        if (!reader.get_next_bytes(1, buffer))
+            return std::make_tuple(false, 0);
+
+        length = operand_length(buffer[0]);
+        if (length > 1 && !reader.get_next_bytes(static_cast<uint32_t>(length - 1), buffer + 1))
+            return std::make_tuple(false, 0);
+
+        decode_operand(buffer, length, result);
         return std::make_tuple(true, result);
     }
 
@@ -213,6 +265,13 @@ namespace
         return std::make_tuple(mid, src, dest);
     }
 
+    // Double indirect offsets are packed into 16 bits each.
+    bool is_double_indirect_offset_valid(const inst_data_generic_t &data)
+    {
+        return 0 <= data.register1 && data.register1 <= std::numeric_limits<uint16_t>::max()
+            && 0 <= data.register2 && data.register2 <= std::numeric_limits<uint16_t>::max();
+    }
+
     // See header format definition in Dis VM specification (http://www.vitanuova.com/inferno/man/6/dis.html)
     void read_header(disvm::util::buffered_reader_t &reader, vm_module_t &modobj)
     {
@@ -271,72 +330,125 @@ namespace
         if (!success) throw module_reader_exception{ "Failed to read entry type" };
     }
 
-    // See code section layout in Dis VM specification (http://www.vitanuova.com/inferno/man/6/dis.html)
-    void read_code_section(disvm::util::buffered_reader_t &reader, vm_module_t &modobj)
+    // Decode an instruction from contiguous bytes.
+    // Returns the number of bytes consumed or 0 if the entire instruction isn't available.
+    std::size_t decode_instruction(const byte_t *bytes, std::size_t available, opcode_t &opcode, src_data_t &source, middle_data_t &middle, dest_data_t &destination)
     {
-        auto success = bool{};
-        const auto instruction_count = modobj.header.code_size;
+        if (available < 2)
+            return 0;
 
-        // Allocate memory for the instructions
-        modobj.code_section.resize(instruction_count);
+        opcode = static_cast<opcode_t>(bytes[0]);
+        std::tie(middle.mode, source.mode, destination.mode) = convert_to_address_mode(bytes[1]);
 
-        for (auto c = word_t{ 0 }; c < instruction_count; ++c)
+        auto offset = std::size_t{ 2 };
+        auto decode_next = [&](operand_t &value)
+        {
+            const auto length = decode_operand(bytes + offset, available - offset, value);
+            offset += length;
+            return length != 0;
+        };
+
+        if (middle.mode != address_mode_middle_t::none && !decode_next(middle.register1))
+            return 0;
+
+        if (source.mode != address_mode_t::none)
+        {
+            if (!decode_next(source.register1))
+                return 0;
+
+            if (is_double_indirect(source.mode) && !decode_next(source.register2))
+                return 0;
+        }
+
+        if (destination.mode != address_mode_t::none)
         {
-            // Read in a single instruction
-            byte_t op_and_addrmode[2] = {};
-            const auto bytesRead = reader.get_next_bytes(sizeof(op_and_addrmode), op_and_addrmode);
-            if (bytesRead != sizeof(op_and_addrmode)) throw module_reader_exception{ "Failed to read op code and address mode" };
+            if (!decode_next(destination.register1))
+                return 0;
+
+            if (is_double_indirect(destination.mode) && !decode_next(destination.register2))
+                return 0;
+        }
+
+        return offset;
+    }
+
+    // Read an instruction one field at a time.
+    void read_instruction(disvm::util::buffered_reader_t &reader, opcode_t &opcode, src_data_t &source, middle_data_t &middle, dest_data_t &destination)
+    {
+        auto success = bool{};
 
-            auto vm_instr = vm_instruction_t{};
-            auto &instr = vm_instr.op;
+        byte_t op_and_addrmode[2] = {};
+        const auto bytesRead = reader.get_next_bytes(sizeof(op_and_addrmode), op_and_addrmode);
+        if (bytesRead != sizeof(op_and_addrmode)) throw module_reader_exception{ "Failed to read op code and address mode" };
 
-            instr.opcode = static_cast<opcode_t>(op_and_addrmode[0]);
-            assert(opcode_t::first_opcode <= instr.opcode && instr.opcode <= opcode_t::last_opcode);
-            instr.addr_code = op_and_addrmode[1];
+        opcode = static_cast<opcode_t>(op_and_addrmode[0]);
+        std::tie(middle.mode, source.mode, destination.mode) = convert_to_address_mode(op_and_addrmode[1]);
 
-            std::tie(instr.middle.mode, instr.source.mode, instr.destination.mode) = convert_to_address_mode(op_and_addrmode[1]);
+        if (middle.mode != address_mode_middle_t::none)
+        {
+            std::tie(success, middle.register1) = read_next_operand(reader);
+            if (!success) throw module_reader_exception{ "Failed to read middle register" };
+        }
+
+        if (source.mode != address_mode_t::none)
+        {
+            std::tie(success, source.register1) = read_next_operand(reader);
+            if (!success) throw module_reader_exception{ "Failed to read source register 1" };
 
-            if (instr.middle.mode != address_mode_middle_t::none)
+            if (is_double_indirect(source.mode))
             {
-                std::tie(success, instr.middle.register1) = read_next_operand(reader);
-                if (!success) throw module_reader_exception{ "Failed to read middle register" };
+                std::tie(success, source.register2) = read_next_operand(reader);
+                if (!success) throw module_reader_exception{ "Failed to read source register 2" };
             }
+        }
+
+        if (destination.mode != address_mode_t::none)
+        {
+            std::tie(success, destination.register1) = read_next_operand(reader);
+            if (!success) throw module_reader_exception{ "Failed to read destination register 1" };
 
-            if (instr.source.mode != address_mode_t::none)
+            if (is_double_indirect(destination.mode))
             {
-                std::tie(success, instr.source.register1) = read_next_operand(reader);
-                if (!success) throw module_reader_exception{ "Failed to read source register 1" };
+                std::tie(success, destination.register2) = read_next_operand(reader);
+                if (!success) throw module_reader_exception{ "Failed to destination register 2" };
+            }
+        }
+    }
 
-                if (instr.source.mode == address_mode_t::offset_double_indirect_fp ||
-                    instr.source.mode == address_mode_t::offset_double_indirect_mp)
-                {
-                    std::tie(success, instr.source.register2) = read_next_operand(reader);
-                    if (!success) throw module_reader_exception{ "Failed to read source register 2" };
+    // See code section layout in Dis VM specification (http://www.vitanuova.com/inferno/man/6/dis.html)
+    void read_code_section(disvm::util::buffered_reader_t &reader, vm_module_t &modobj)
+    {
+        const auto instruction_count = modobj.header.code_size;
 
-                    // Double indirect offsets need to be < 2^16-1.
-                    assert(instr.source.register1 <= std::numeric_limits<uint16_t>::max());
-                    assert(instr.source.register2 <= std::numeric_limits<uint16_t>::max());
-                }
-            }
+        // Allocate memory for the instructions
+        modobj.code_section.resize(instruction_count);
 
-            if (instr.destination.mode != address_mode_t::none)
-            {
-                std::tie(success, instr.destination.register1) = read_next_operand(reader);
-                if (!success) throw module_reader_exception{ "Failed to read destination register 1" };
+        for (auto c = word_t{ 0 }; c < instruction_count; ++c)
+        {
+            auto opcode = opcode_t{};
+            auto source = src_data_t{};
+            auto middle = middle_data_t{};
+            auto destination = dest_data_t{};
+
+            // Decode the instruction in place if it is entirely buffered, which is always
+            // the case when reading from memory.
+            const byte_t *bytes;
+            const auto available = reader.peek_bytes(bytes);
+            const auto length = decode_instruction(bytes, available, opcode, source, middle, destination);
+            if (length != 0)
+                reader.skip_bytes(length);
+            else
+                read_instruction(reader, opcode, source, middle, destination);
 
-                if (instr.destination.mode == address_mode_t::offset_double_indirect_fp ||
-                    instr.destination.mode == address_mode_t::offset_double_indirect_mp)
-                {
-                    std::tie(success, instr.destination.register2) = read_next_operand(reader);
-                    if (!success) throw module_reader_exception{ "Failed to destination register 2" };
+            assert(opcode_t::first_opcode <= opcode && opcode <= opcode_t::last_opcode);
 
-                    // Double indirect offsets need to be < 2^16-1.
-                    assert(instr.destination.register1 <= std::numeric_limits<uint16_t>::max());
-                    assert(instr.destination.register2 <= std::numeric_limits<uint16_t>::max());
-                }
-            }
+            if (is_double_indirect(source.mode) && !is_double_indirect_offset_valid(source))
+                throw module_reader_exception{ "Invalid source double indirect offset" };
 
-            modobj.code_section[c] = std::move(vm_instr);
+            if (is_double_indirect(destination.mode) && !is_double_indirect_offset_valid(destination))
+                throw module_reader_exception{ "Invalid destination double indirect offset" };
+
+            modobj.code_section[c].op = vm_exec_op_t{ opcode, source, middle, destination };
         }
 
         if (modobj.header.entry_pc != module_constants::no_entry_pc && static_cast<std::size_t>(modobj.header.entry_pc) >= modobj.code_section.size())
@@ -482,7 +594,7 @@ namespace
                 auto arr_maybe = vm_alloc_t::from_allocation(*reinterpret_cast<pointer_t *>(data_dest));
                 assert(arr_maybe != nullptr);
 
-                if (arr_maybe->alloc_type != vm_array_t::type_desc())
+                if (arr_maybe->alloc_type != vm_array_t::type_desc().get())
                     throw module_reader_exception{ "Data index not an array type" };
 
                 auto arr = static_cast<vm_array_t *>(arr_maybe);
@@ -756,35 +868,467 @@ vm_module_t::~vm_module_t()
     if (module_name != nullptr)
         module_name->release();
 
+    // Module references can share the original module data, see vm_module_ref_t
     if (original_mp != nullptr)
-        original_mp->release();
+        dec_ref_count_and_free(original_mp.release());
 }
 
-std::unique_ptr<vm_module_t> disvm::read_module(std::istream &data)
+namespace
 {
-    disvm::util::buffered_reader_t reader{ data };
+    //
+    // Code section verification
+    //
+    // Verified modules have their operands trusted by the interpreter, see decode_code_section().
+    //
+
+    bool verification_failed(vm_pc_t pc, const char *reason)
+    {
+        if (disvm::debug::is_component_tracing_enabled<component_trace_t::module>())
+            disvm::debug::log_msg(component_trace_t::module, log_level_t::debug, "verify: failed: %d: %s", pc, reason);
+
+        return false;
+    }
+
+    bool is_offset_valid(word_t offset, std::size_t size, std::size_t access_size)
+    {
+        return 0 <= offset && access_size <= size && static_cast<std::size_t>(offset) <= (size - access_size);
+    }
+
+    bool is_pc_valid(big_t pc, const vm_module_t &modobj)
+    {
+        return 0 <= pc && static_cast<std::size_t>(pc) < modobj.code_section.size();
+    }
 
-    auto modobj = std::make_unique<vm_module_t>();
+    bool is_type_id_valid(word_t type_id, const vm_module_t &modobj)
+    {
+        return 0 <= type_id
+            && static_cast<std::size_t>(type_id) < modobj.type_section.size()
+            && modobj.type_section[type_id] != nullptr;
+    }
+
+    std::size_t get_mp_size(const vm_module_t &modobj)
+    {
+        return (modobj.original_mp != nullptr) ? modobj.original_mp->alloc_type->size_in_bytes : 0;
+    }
+
+    bool is_operand_valid(const inst_data_generic_t &operand, std::size_t width, std::size_t frame_size, std::size_t mp_size)
+    {
+        switch (operand.mode)
+        {
+        case address_mode_t::offset_indirect_fp:
+            return is_offset_valid(operand.register1, frame_size, width);
+        case address_mode_t::offset_double_indirect_fp:
+            return is_offset_valid(operand.register1, frame_size, sizeof(pointer_t));
+        case address_mode_t::offset_indirect_mp:
+            return is_offset_valid(operand.register1, mp_size, width);
+        case address_mode_t::offset_double_indirect_mp:
+            return is_offset_valid(operand.register1, mp_size, sizeof(pointer_t));
+        case address_mode_t::immediate:
+        case address_mode_t::none:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    bool is_middle_operand_valid(const vm_exec_op_t &op, std::size_t width, std::size_t frame_size, std::size_t mp_size)
+    {
+        switch (op.middle().mode)
+        {
+        case address_mode_middle_t::small_offset_indirect_fp:
+            return is_offset_valid(op.middle().register1, frame_size, width);
+        case address_mode_middle_t::small_offset_indirect_mp:
+            return is_offset_valid(op.middle().register1, mp_size, width);
+        default:
+            return true;
+        }
+    }
+
+    // Get the size of the block of memory accessed through the memory operands of an instruction (e.g. 'movm').
+    // The size is either an immediate or the size of a type. Type IDs must be validated first.
+    bool get_memory_size(const vm_exec_op_t &op, const vm_module_t &modobj, std::size_t &size)
+    {
+        if (disvm::runtime::get_type_operand(op.opcode) == type_operand_t::middle)
+        {
+            size = static_cast<std::size_t>(modobj.type_section[op.middle().register1]->size_in_bytes);
+            return true;
+        }
 
-    read_header(reader, *modobj);
+        if (op.middle().mode != address_mode_middle_t::small_immediate || op.middle().register1 < 0)
+            return false;
 
-    if (disvm::util::has_flag(modobj->header.runtime_flag, runtime_flags_t::has_import_deprecated))
-        throw module_reader_exception{ "Obsolete module" };
+        size = static_cast<std::size_t>(op.middle().register1);
+        return true;
+    }
 
-    read_code_section(reader, *modobj);
-    read_type_section(reader, *modobj);
-    read_data_section(reader, *modobj);
-    read_module_name(reader, *modobj);
-    read_link_section(reader, *modobj);
+    // Range of module data in bytes [begin, end)
+    struct mp_range_t
+    {
+        std::size_t begin;
+        std::size_t end;
+    };
 
-    if (disvm::util::has_flag(modobj->header.runtime_flag, runtime_flags_t::has_import))
-        read_import_section(reader, *modobj);
+    bool overlaps(word_t offset, std::size_t width, const std::vector<mp_range_t> &ranges)
+    {
+        const auto begin = static_cast<std::size_t>(offset);
+        for (const auto &range : ranges)
+        {
+            if (begin < range.end && range.begin < (begin + width))
+                return true;
+        }
 
-    if (disvm::util::has_flag(modobj->header.runtime_flag, runtime_flags_t::has_handler))
-        read_handler_section(reader, *modobj);
+        return false;
+    }
 
-    // [TODO] Native code generation - runtime_flags_t::must_compile
-    assert(!disvm::util::has_flag(modobj->header.runtime_flag, runtime_flags_t::must_compile));
+    // Returns 'true' if the instruction may write to any of the supplied ranges of module data.
+    // Operand offsets must be validated first.
+    bool may_write_mp_ranges(const vm_exec_op_t &op, const operand_widths_t &widths, const std::vector<mp_range_t> &ranges)
+    {
+        switch (op.opcode)
+        {
+        case opcode_t::lea:
+            // The address may be used to write anywhere in module data
+            return op.source().mode == address_mode_t::offset_indirect_mp;
+        case opcode_t::indb:
+        case opcode_t::indw:
+        case opcode_t::indf:
+        case opcode_t::indl:
+        case opcode_t::indx:
+            return op.middle().mode == address_mode_middle_t::small_offset_indirect_mp
+                && overlaps(op.middle().register1, widths.middle, ranges);
+        case opcode_t::goto_:
+        case opcode_t::send:
+        case opcode_t::mcall:
+        case opcode_t::mspawn:
+        case opcode_t::tcmp:
+            // Destination is only read
+            return false;
+        default:
+            if (disvm::runtime::is_branch(op.opcode) || disvm::runtime::is_case(op.opcode))
+                return false;
 
-    return modobj;
-}
\ No newline at end of file
+            return op.destination().mode == address_mode_t::offset_indirect_mp
+                && overlaps(op.destination().register1, widths.destination, ranges);
+        }
+    }
+
+    // Collect the targets of a case table in module data.
+    // Case tables are laid out as: count, (low, high, pc) * count, default pc
+    template<typename T>
+    bool get_case_targets(const vm_exec_op_t &op, const vm_module_t &modobj, std::vector<big_t> &targets, std::vector<mp_range_t> &tables)
+    {
+        const auto mp_size = get_mp_size(modobj);
+        if (op.destination().mode != address_mode_t::offset_indirect_mp
+            || !is_offset_valid(op.destination().register1, mp_size, 2 * sizeof(T)))
+            return false;
+
+        const auto entries = reinterpret_cast<const T *>(modobj.original_mp->get_allocation<uint8_t>() + op.destination().register1);
+        const auto available = (mp_size - op.destination().register1) / sizeof(T);
+        const auto count = entries[0];
+        if (count < 0 || ((available - 2) / 3) < static_cast<std::size_t>(count))
+            return false;
+
+        for (auto i = std::size_t{ 0 }; i < static_cast<std::size_t>(count); ++i)
+            targets.push_back(entries[1 + (i * 3) + 2]);
+
+        targets.push_back(entries[1 + (count * 3)]);
+
+        const auto begin = static_cast<std::size_t>(op.destination().register1);
+        tables.push_back({ begin, begin + ((2 + (static_cast<std::size_t>(count) * 3)) * sizeof(T)) });
+        return true;
+    }
+
+    bool get_case_targets(const vm_exec_op_t &op, const vm_module_t &modobj, std::vector<big_t> &targets, std::vector<mp_range_t> &tables)
+    {
+        if (op.opcode == opcode_t::casel)
+            return get_case_targets<big_t>(op, modobj, targets, tables);
+
+        return get_case_targets<word_t>(op, modobj, targets, tables);
+    }
+
+    bool is_same_location(const inst_data_generic_t &a, const inst_data_generic_t &b)
+    {
+        return a.mode == b.mode && a.register1 == b.register1;
+    }
+
+    // Returns 'true' if the instruction may write to frame or module data other than its destination operand.
+    bool may_alias_write(const vm_exec_op_t &op)
+    {
+        return op.opcode == opcode_t::lea
+            || op.opcode == opcode_t::movm
+            || op.opcode == opcode_t::movmp
+            || op.destination().mode == address_mode_t::offset_double_indirect_fp
+            || op.destination().mode == address_mode_t::offset_double_indirect_mp;
+    }
+
+    // Find the type ID of the frame consumed by the 'call' or 'spawn' at the supplied program counter.
+    // The frame must be allocated by a preceding 'frame' instruction that is the only way into the
+    // instructions leading to the call and the frame location must not be written in between.
+    bool get_call_frame_type(const vm_module_t &modobj, vm_pc_t call_pc, const std::vector<std::vector<vm_pc_t>> &branch_sources, word_t &type_id)
+    {
+        const auto frame_location = modobj.code_section[call_pc].op.source();
+        if (frame_location.mode != address_mode_t::offset_indirect_fp && frame_location.mode != address_mode_t::offset_indirect_mp)
+            return false;
+
+        auto frame_pc = call_pc - 1;
+        for (; 0 <= frame_pc; --frame_pc)
+        {
+            const auto &op = modobj.code_section[frame_pc].op;
+            if (op.opcode == opcode_t::frame && is_same_location(op.destination(), frame_location))
+                break;
+
+            if (is_same_location(op.destination(), frame_location) || may_alias_write(op))
+                return false;
+        }
+
+        if (frame_pc < 0)
+            return false;
+
+        const auto &frame_op = modobj.code_section[frame_pc].op;
+        if (frame_op.source().mode != address_mode_t::immediate)
+            return false;
+
+        // Control must not enter between the 'frame' and the call from elsewhere
+        for (auto pc = frame_pc + 1; pc <= call_pc; ++pc)
+        {
+            for (auto source : branch_sources[pc])
+            {
+                if (source < frame_pc || call_pc < source)
+                    return false;
+            }
+        }
+
+        type_id = frame_op.source().register1;
+        return true;
+    }
+
+    // Compute the frame size for the function containing each instruction and collect the case tables.
+    // Function entry points are the module entry, exports, and targets of 'call' and 'spawn'.
+    bool get_frame_sizes(const vm_module_t &modobj, std::vector<std::size_t> &frame_sizes, std::vector<mp_range_t> &case_tables)
+    {
+        const auto code_size = modobj.code_section.size();
+        auto function_frames = std::map<vm_pc_t, std::size_t>{};
+
+        auto add_function = [&](big_t pc, word_t type_id)
+        {
+            if (!is_pc_valid(pc, modobj) || !is_type_id_valid(type_id, modobj))
+                return false;
+
+            const auto frame_size = static_cast<std::size_t>(modobj.type_section[type_id]->size_in_bytes);
+            const auto result = function_frames.emplace(static_cast<vm_pc_t>(pc), frame_size);
+            return result.second || result.first->second == frame_size;
+        };
+
+        if (modobj.header.entry_pc != module_constants::no_entry_pc
+            && !add_function(modobj.header.entry_pc, modobj.header.entry_type))
+            return verification_failed(modobj.header.entry_pc, "entry frame");
+
+        for (const auto &e : modobj.export_section)
+        {
+            if (!add_function(e.second.pc, e.second.frame_type))
+                return verification_failed(e.second.pc, "export frame");
+        }
+
+        // Record the sources of all branches. Exception handlers can be entered from anywhere.
+        const auto external_source = vm_pc_t{ -1 };
+        auto branch_sources = std::vector<std::vector<vm_pc_t>>(code_size);
+        auto case_targets = std::vector<big_t>{};
+        for (auto pc = vm_pc_t{ 0 }; static_cast<std::size_t>(pc) < code_size; ++pc)
+        {
+            const auto &op = modobj.code_section[pc].op;
+            if (disvm::runtime::is_branch(op.opcode))
+            {
+                if (op.destination().mode != address_mode_t::immediate || !is_pc_valid(op.destination().register1, modobj))
+                    return verification_failed(pc, "branch target");
+
+                branch_sources[op.destination().register1].push_back(pc);
+            }
+            else if (disvm::runtime::is_case(op.opcode))
+            {
+                case_targets.clear();
+                if (!get_case_targets(op, modobj, case_targets, case_tables))
+                    return verification_failed(pc, "case table");
+
+                for (auto target : case_targets)
+                {
+                    if (!is_pc_valid(target, modobj))
+                        return verification_failed(pc, "case target");
+
+                    branch_sources[static_cast<std::size_t>(target)].push_back(pc);
+                }
+            }
+            else if (op.opcode == opcode_t::goto_)
+            {
+                // [TODO] The length of a 'goto' table isn't encoded so its targets
+                // can't be confined to the containing function.
+                return verification_failed(pc, "goto table");
+            }
+        }
+
+        for (const auto &handler : modobj.handler_section)
+        {
+            for (const auto &e : handler.exception_table)
+            {
+                if (e.pc == disvm::runtime::runtime_constants::invalid_program_counter)
+                    continue;
+
+                if (!is_pc_valid(e.pc, modobj))
+                    return verification_failed(e.pc, "exception handler");
+
+                branch_sources[e.pc].push_back(external_source);
+            }
+        }
+
+        for (auto pc = vm_pc_t{ 0 }; static_cast<std::size_t>(pc) < code_size; ++pc)
+        {
+            const auto &op = modobj.code_section[pc].op;
+            if (op.opcode != opcode_t::call && op.opcode != opcode_t::spawn)
+                continue;
+
+            auto type_id = word_t{};
+            if (!get_call_frame_type(modobj, pc, branch_sources, type_id))
+                return verification_failed(pc, "unknown call frame");
+
+            if (!add_function(op.destination().register1, type_id))
+                return verification_failed(pc, "call frame");
+        }
+
+        if (code_size == 0)
+            return true;
+
+        // Functions are contiguous so each extends to the next entry point
+        if (function_frames.empty() || function_frames.cbegin()->first != 0)
+            return verification_failed(0, "no function entry");
+
+        frame_sizes.resize(code_size);
+        auto next_function = function_frames.cbegin();
+        auto frame_size = std::size_t{ 0 };
+        for (auto pc = vm_pc_t{ 0 }; static_cast<std::size_t>(pc) < code_size; ++pc)
+        {
+            if (next_function != function_frames.cend() && next_function->first == pc)
+            {
+                frame_size = next_function->second;
+                ++next_function;
+            }
+
+            frame_sizes[pc] = frame_size;
+        }
+
+        return true;
+    }
+
+    // Prove operand offsets are within the frame and module data, type IDs are valid,
+    // branch targets are within the code section, and case tables are never written.
+    bool verify_code_section(const vm_module_t &modobj)
+    {
+        auto frame_sizes = std::vector<std::size_t>{};
+        auto case_tables = std::vector<mp_range_t>{};
+        if (!get_frame_sizes(modobj, frame_sizes, case_tables))
+            return false;
+
+        const auto mp_size = get_mp_size(modobj);
+        for (auto pc = vm_pc_t{ 0 }; static_cast<std::size_t>(pc) < modobj.code_section.size(); ++pc)
+        {
+            const auto &op = modobj.code_section[pc].op;
+            if (op.opcode < opcode_t::first_opcode || opcode_t::last_opcode < op.opcode)
+                return verification_failed(pc, "opcode");
+
+            switch (disvm::runtime::get_type_operand(op.opcode))
+            {
+            case type_operand_t::source:
+                if (op.source().mode != address_mode_t::immediate || !is_type_id_valid(op.source().register1, modobj))
+                    return verification_failed(pc, "type ID");
+                break;
+            case type_operand_t::middle:
+                if (op.middle().mode != address_mode_middle_t::small_immediate || !is_type_id_valid(op.middle().register1, modobj))
+                    return verification_failed(pc, "type ID");
+                break;
+            case type_operand_t::none:
+                break;
+            }
+
+            // A missing middle operand refers to the destination
+            auto widths = disvm::runtime::get_operand_widths(op.opcode);
+            if (op.middle().mode == address_mode_middle_t::none && widths.destination != 0)
+                widths.destination = std::max(widths.destination, widths.middle);
+
+            if (widths.source == 0 || widths.destination == 0)
+            {
+                auto memory_size = std::size_t{};
+                if (!get_memory_size(op, modobj, memory_size))
+                    return verification_failed(pc, "memory size");
+
+                if (widths.source == 0)
+                    widths.source = memory_size;
+
+                if (widths.destination == 0)
+                    widths.destination = memory_size;
+            }
+
+            const auto frame_size = frame_sizes[pc];
+            if (!is_operand_valid(op.source(), widths.source, frame_size, mp_size)
+                || !is_middle_operand_valid(op, widths.middle, frame_size, mp_size)
+                || !is_operand_valid(op.destination(), widths.destination, frame_size, mp_size))
+                return verification_failed(pc, "operand offset");
+
+            if (!case_tables.empty() && may_write_mp_ranges(op, widths, case_tables))
+                return verification_failed(pc, "case table write");
+        }
+
+        // The exception is stored in the frame of the function containing the handler
+        for (const auto &handler : modobj.handler_section)
+        {
+            if (!is_pc_valid(handler.begin_pc, modobj)
+                || !is_offset_valid(handler.exception_offset, frame_sizes[handler.begin_pc], sizeof(pointer_t)))
+                return verification_failed(handler.begin_pc, "exception offset");
+        }
+
+        return true;
+    }
+}
+
+namespace
+{
+    std::unique_ptr<vm_module_t> read_module_sections(disvm::util::buffered_reader_t &reader)
+    {
+        auto modobj = std::make_unique<vm_module_t>();
+
+        read_header(reader, *modobj);
+
+        if (disvm::util::has_flag(modobj->header.runtime_flag, runtime_flags_t::has_import_deprecated))
+            throw module_reader_exception{ "Obsolete module" };
+
+        read_code_section(reader, *modobj);
+        read_type_section(reader, *modobj);
+        read_data_section(reader, *modobj);
+        read_module_name(reader, *modobj);
+        read_link_section(reader, *modobj);
+
+        if (disvm::util::has_flag(modobj->header.runtime_flag, runtime_flags_t::has_import))
+            read_import_section(reader, *modobj);
+
+        if (disvm::util::has_flag(modobj->header.runtime_flag, runtime_flags_t::has_handler))
+            read_handler_section(reader, *modobj);
+
+        modobj->verified = verify_code_section(*modobj);
+
+        return modobj;
+    }
+}
+
+std::unique_ptr<vm_module_t> disvm::read_module(std::istream &data)
+{
+    disvm::util::buffered_reader_t reader{ data };
+    return read_module_sections(reader);
+}
+
+std::unique_ptr<vm_module_t> disvm::read_module(const byte_t *data, std::size_t size)
+{
+    disvm::util::buffered_reader_t reader{ data, size };
+    return read_module_sections(reader);
+}
+
+bool disvm::verify_module(const vm_module_t &module)
+{
+    return verify_code_section(module);
+}
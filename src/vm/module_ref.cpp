@@ -17,6 +17,7 @@ using disvm::runtime::type_descriptor_t;
 using disvm::runtime::intrinsic_type_desc;
 using disvm::runtime::byte_t;
 using disvm::runtime::word_t;
+using disvm::runtime::vm_alloc_t;
 using disvm::runtime::vm_array_t;
 using disvm::runtime::vm_string_t;
 using disvm::runtime::vm_module_t;
@@ -24,15 +25,45 @@ using disvm::runtime::vm_module_ref_t;
 using disvm::runtime::export_section_t;
 using disvm::runtime::import_vm_module_t;
 using disvm::runtime::vm_module_function_ref_t;
+using disvm::runtime::vm_function_refs_t;
+using disvm::runtime::vm_import_cache_t;
 using disvm::runtime::vm_system_exception;
 using disvm::runtime::vm_user_exception;
 
 namespace
 {
-    std::unique_ptr<vm_array_t> resolve_imports(const export_section_t &exports, const import_vm_module_t &imports)
+    // 64-bit IDs don't wrap within the lifetime of a process, so an ID in a call site
+    // cache never matches a module reference created after the cached one was freed.
+    std::atomic<uint64_t> last_instance_id{ 0 };
+
+    uint64_t get_next_instance_id()
+    {
+        // Zero is reserved for an empty call site cache
+        return ++last_instance_id;
+    }
+
+    // Get the initial module data for a reference to the supplied module.
+    vm_alloc_t *init_mp(const vm_module_t &module, std::atomic<bool> &shared)
+    {
+        if (module.original_mp == nullptr)
+            return nullptr;
+
+        // [PERF] Copying the module data copies it and adds a reference to every pointer in it, so
+        // the original is shared until the module data is written (see instruction_decoder.cpp).
+        // Native code retains the MP register so compiled modules are given a private copy.
+        if (module.native_code == nullptr)
+        {
+            module.original_mp->add_ref();
+            shared = true;
+            return module.original_mp.get();
+        }
+
+        return vm_alloc_t::copy(*module.original_mp);
+    }
+
+    std::shared_ptr<const vm_function_refs_t> resolve_imports(const export_section_t &exports, const import_vm_module_t &imports)
     {
-        static auto function_ref_type_desc = type_descriptor_t::create(sizeof(vm_module_function_ref_t), std::vector<byte_t>{});
-        auto refs = std::make_unique<vm_array_t>(function_ref_type_desc, imports.functions.size());
+        auto refs = std::make_shared<vm_function_refs_t>(imports.functions.size());
 
         for (auto index = std::size_t{ 0 }; index < imports.functions.size(); ++index)
         {
@@ -57,7 +88,7 @@ namespace
 
             const auto &export_entry = export_match->second;
 
-            auto &ref = refs->at<vm_module_function_ref_t>(index);
+            auto &ref = (*refs)[index];
             ref.entry_pc = export_entry.pc;
             ref.frame_type = export_entry.frame_type;
 
@@ -85,42 +116,44 @@ std::shared_ptr<const type_descriptor_t> vm_module_ref_t::type_desc()
 vm_module_ref_t::vm_module_ref_t(std::shared_ptr<const vm_module_t> module)
     : vm_alloc_t(vm_module_ref_t::type_desc())
     , code_section{ module->code_section }
+    , decoded_section{ module->decoded_section }
     , module{ module }
     , mp_base{ nullptr }
+    , instance_id{ get_next_instance_id() }
     , type_section{ module->type_section }
     , _builtin_module{ util::has_flag(module->header.runtime_flag, runtime_flags_t::builtin) }
+    , _mp_shared{ false }
 {
-    if (module->original_mp != nullptr)
-        mp_base = vm_alloc_t::copy(*module->original_mp);
+    mp_base = init_mp(*module, _mp_shared);
 
     if (disvm::debug::is_component_tracing_enabled<component_trace_t::memory>())
         disvm::debug::log_msg(component_trace_t::memory, log_level_t::debug, "init: vm module ref");
 }
 
-vm_module_ref_t::vm_module_ref_t(std::shared_ptr<const vm_module_t> module, const import_vm_module_t &imports)
+vm_module_ref_t::vm_module_ref_t(std::shared_ptr<const vm_module_t> module, std::shared_ptr<const vm_function_refs_t> function_refs)
     : vm_alloc_t(vm_module_ref_t::type_desc())
     , code_section{ module->code_section }
+    , decoded_section{ module->decoded_section }
     , module{ module }
     , mp_base{ nullptr }
+    , instance_id{ get_next_instance_id() }
     , type_section{ module->type_section }
-    , _function_refs{ resolve_imports(module->export_section, imports) }
+    , _function_refs{ std::move(function_refs) }
     , _builtin_module{ util::has_flag(module->header.runtime_flag, runtime_flags_t::builtin) }
+    , _mp_shared{ false }
 {
     assert(module->header.data_size == 0 || module->original_mp != nullptr);
+    assert(_function_refs != nullptr);
 
-    if (module->original_mp != nullptr)
-        mp_base = vm_alloc_t::copy(*module->original_mp);
+    mp_base = init_mp(*module, _mp_shared);
 
     if (disvm::debug::is_component_tracing_enabled<component_trace_t::memory>())
-        disvm::debug::log_msg(component_trace_t::memory, log_level_t::debug, "init: vm module ref: exported %d", _function_refs->get_length());
+        disvm::debug::log_msg(component_trace_t::memory, log_level_t::debug, "init: vm module ref: exported %d", _function_refs->size());
 }
 
 vm_module_ref_t::~vm_module_ref_t()
 {
-    dec_ref_count_and_free(mp_base);
-
-    if (_function_refs != nullptr)
-        _function_refs->release();
+    dec_ref_count_and_free(mp_base.load());
 
     if (disvm::debug::is_component_tracing_enabled<component_trace_t::memory>())
         disvm::debug::log_msg(component_trace_t::memory, log_level_t::debug, "destroy: vm module ref");
@@ -131,13 +164,64 @@ bool vm_module_ref_t::is_builtin_module() const
     return _builtin_module;
 }
 
+bool vm_module_ref_t::is_mp_shared() const
+{
+    return _mp_shared.load(std::memory_order_acquire);
+}
+
+void vm_module_ref_t::make_mp_private()
+{
+    std::lock_guard<std::mutex> lock{ _mp_lock };
+
+    // Another thread may have copied the module data
+    if (!_mp_shared)
+        return;
+
+    auto original = mp_base.load();
+    assert(original != nullptr);
+
+    // Threads executing in this module may still reference the original
+    // module data, they switch to the copy when they next access it.
+    mp_base.store(vm_alloc_t::copy(*original), std::memory_order_release);
+    _mp_shared.store(false, std::memory_order_release);
+    dec_ref_count_and_free(original);
+
+    if (disvm::debug::is_component_tracing_enabled<component_trace_t::memory>())
+        disvm::debug::log_msg(component_trace_t::memory, log_level_t::debug, "copy: vm module ref: module data");
+}
+
 const vm_module_function_ref_t& vm_module_ref_t::get_function_ref(word_t index) const
 {
     assert(_function_refs != nullptr);
 
-    if (index < 0 || _function_refs->get_length() <= index)
+    if (index < 0 || static_cast<word_t>(_function_refs->size()) <= index)
         throw vm_system_exception{ "Invalid function reference index into module reference functions" };
 
-    return _function_refs->at<vm_module_function_ref_t>(index);
+    return (*_function_refs)[index];
+}
+
+std::shared_ptr<const vm_function_refs_t> vm_import_cache_t::resolve(
+    const vm_module_t &importing_module,
+    std::size_t import_index,
+    const std::shared_ptr<const vm_module_t> &module) const
+{
+    assert(module != nullptr);
+    if (importing_module.import_section.size() <= import_index)
+        throw vm_system_exception{ "Invalid import table index" };
+
+    std::lock_guard<std::mutex> lock{ _lock };
+    if (_entries.empty())
+        _entries.resize(importing_module.import_section.size());
+
+    // [PERF] Modules that are loaded repeatedly (e.g. per request) are linked once.
+    // The weak reference ensures the cached functions are for the same instance of the module.
+    auto &entry = _entries[import_index];
+    if (entry.function_refs != nullptr && entry.module.lock() == module)
+        return entry.function_refs;
+
+    entry.function_refs = resolve_imports(module->export_section, importing_module.import_section[import_index]);
+    entry.module = module;
+
+    return entry.function_refs;
 }
 
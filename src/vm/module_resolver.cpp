@@ -5,24 +5,46 @@
 //
 
 #include <cassert>
-#include <fstream>
-#include <sstream>
+#include <string>
+#include <vector>
 #include <disvm.hpp>
 #include <debug.hpp>
 #include <exceptions.hpp>
+#include "mapped_file.hpp"
+#include "module_image.hpp"
 #include "module_resolver.hpp"
 
 using disvm::debug::component_trace_t;
 using disvm::debug::log_level_t;
 
 using disvm::runtime::default_resolver_t;
+using disvm::runtime::module_image_cache_t;
 using disvm::runtime::vm_module_t;
 using disvm::runtime::vm_module_resolver_t;
+using disvm::util::directory_index_t;
+using disvm::util::file_lookup_t;
+using disvm::util::mapped_file_t;
+
+namespace
+{
+    void index_probing_paths(directory_index_t &index, const std::vector<std::string> &probing_paths)
+    {
+        for (auto &p : probing_paths)
+            index.index_directory_of(p);
+    }
+}
 
 // Empty destructor for vm module resolver 'interface'
 vm_module_resolver_t::~vm_module_resolver_t()
 { }
 
+bool vm_module_resolver_t::try_get_module_identity(const char *, std::string &identity)
+{
+    // Resolvers that can't identify files may still resolve the path
+    identity.clear();
+    return true;
+}
+
 default_resolver_t::default_resolver_t(disvm::vm_t &vm)
     : _vm{ vm }
 { }
@@ -30,7 +52,17 @@ default_resolver_t::default_resolver_t(disvm::vm_t &vm)
 default_resolver_t::default_resolver_t(disvm::vm_t &vm, std::vector<std::string> probing_paths)
     : _probing_paths{ std::move(probing_paths) }
     , _vm{ vm }
-{ }
+{
+    index_probing_paths(_probing_index, _probing_paths);
+}
+
+default_resolver_t::default_resolver_t(disvm::vm_t &vm, std::vector<std::string> probing_paths, std::string image_cache_path)
+    : _probing_paths{ std::move(probing_paths) }
+    , _image_cache{ image_cache_path.empty() ? nullptr : std::make_unique<module_image_cache_t>(std::move(image_cache_path)) }
+    , _vm{ vm }
+{
+    index_probing_paths(_probing_index, _probing_paths);
+}
 
 default_resolver_t::~default_resolver_t()
 { }
@@ -43,35 +75,100 @@ bool default_resolver_t::try_resolve_module(const char *path, std::unique_ptr<vm
     if (log)
         disvm::debug::log_msg(component_trace_t::module, log_level_t::debug, "resolve: try module path: >>%s<<", path);
 
-    auto module_file = std::ifstream{ path, std::ifstream::binary };
-    if (!module_file.is_open())
+    // The module is parsed directly from the mapped file
+    auto module_file = std::make_unique<mapped_file_t>(path);
+    if (!module_file->is_open())
     {
         // The raw path isn't valid, try using probing paths
-        for (auto p : _probing_paths)
-        {
-            p.append(path);
-            if (log)
-                disvm::debug::log_msg(component_trace_t::module, log_level_t::debug, "resolve: try module path: >>%s<<", p.c_str());
-
-            module_file = std::ifstream{ p, std::ifstream::binary };
-            if (module_file.is_open())
-            {
-                if (log)
-                    disvm::debug::log_msg(component_trace_t::module, log_level_t::debug, "resolve: successful modified module path: >>%s<< >>%s<<", path, p.c_str());
-
-                break;
-            }
-        }
-
-        if (!module_file.is_open())
+        module_file = map_from_probing_paths(path);
+        if (module_file == nullptr)
         {
             push_syscall_error_message(_vm, "Unable to resolve path");
             return false;
         }
     }
 
-    new_module = disvm::read_module(module_file);
+    if (_image_cache == nullptr)
+    {
+        new_module = disvm::read_module(module_file->data(), module_file->size());
+        assert(new_module != nullptr);
+        return true;
+    }
+
+    // [PERF] Loading an image avoids parsing the module
+    const auto image_key = disvm::runtime::compute_module_image_key(module_file->data(), module_file->size(), module_file->modified_time());
+    new_module = _image_cache->try_load(image_key);
+    if (new_module != nullptr)
+        return true;
+
+    new_module = disvm::read_module(module_file->data(), module_file->size());
     assert(new_module != nullptr);
 
+    _image_cache->try_store(image_key, *new_module);
+
     return true;
 }
+
+template<typename TryOpen>
+bool default_resolver_t::probe_paths(const char *path, TryOpen try_open)
+{
+    // [PERF] Probing paths the index reports as missing the module aren't opened
+    for (auto p : _probing_paths)
+    {
+        p.append(path);
+
+        const auto lookup = _probing_index.lookup(p);
+        if (lookup == file_lookup_t::missing)
+            continue;
+
+        if (try_open(p))
+            return true;
+
+        // The index is out of date. A name only matching when case is ignored is
+        // expected to fail on file systems that compare names exactly.
+        if (lookup == file_lookup_t::found)
+            _probing_index.invalidate_directory_of(p);
+    }
+
+    return false;
+}
+
+bool default_resolver_t::try_get_module_identity(const char *path, std::string &identity)
+{
+    assert(path != nullptr);
+
+    // The file is found the same way as try_resolve_module()
+    if (disvm::util::get_file_identity(path, identity))
+        return true;
+
+    return probe_paths(path, [&](const std::string &p)
+    {
+        return disvm::util::get_file_identity(p.c_str(), identity);
+    });
+}
+
+std::unique_ptr<mapped_file_t> default_resolver_t::map_from_probing_paths(const char *path)
+{
+    auto log = disvm::debug::is_component_tracing_enabled<component_trace_t::module>();
+
+    auto module_file = std::unique_ptr<mapped_file_t>{};
+    probe_paths(path, [&](const std::string &p)
+    {
+        if (log)
+            disvm::debug::log_msg(component_trace_t::module, log_level_t::debug, "resolve: try module path: >>%s<<", p.c_str());
+
+        module_file = std::make_unique<mapped_file_t>(p.c_str());
+        if (!module_file->is_open())
+        {
+            module_file.reset();
+            return false;
+        }
+
+        if (log)
+            disvm::debug::log_msg(component_trace_t::module, log_level_t::debug, "resolve: successful modified module path: >>%s<< >>%s<<", path, p.c_str());
+
+        return true;
+    });
+
+    return module_file;
+}
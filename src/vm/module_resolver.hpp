@@ -11,9 +11,16 @@
 #include <string>
 #include <vector>
 #include <runtime.hpp>
+#include "directory_index.hpp"
+#include "module_image.hpp"
 
 namespace disvm
 {
+    namespace util
+    {
+        class mapped_file_t;
+    }
+
     namespace runtime
     {
         // Default module resolver
@@ -22,13 +29,25 @@ namespace disvm
         public:
             default_resolver_t(disvm::vm_t &vm);
             default_resolver_t(disvm::vm_t &vm, std::vector<std::string> probing_paths);
+
+            // Module images are read from and stored in the supplied cache path if it isn't empty.
+            default_resolver_t(disvm::vm_t &vm, std::vector<std::string> probing_paths, std::string image_cache_path);
             ~default_resolver_t();
 
         public: // vm_module_resolver_t
             bool try_resolve_module(const char *path, std::unique_ptr<vm_module_t> &new_module);
+            bool try_get_module_identity(const char *path, std::string &identity);
 
         private:
+            std::unique_ptr<disvm::util::mapped_file_t> map_from_probing_paths(const char *path);
+
+            // Call 'try_open' with each probing path joined with the supplied path until it returns 'true'.
+            template<typename TryOpen>
+            bool probe_paths(const char *path, TryOpen try_open);
+
             const std::vector<std::string> _probing_paths;
+            disvm::util::directory_index_t _probing_index;
+            std::unique_ptr<const module_image_cache_t> _image_cache;
             disvm::vm_t &_vm;
         };
     }
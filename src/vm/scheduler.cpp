@@ -9,6 +9,7 @@
 #include <sstream>
 #include <queue>
 #include <exceptions.hpp>
+#include <vm_memory.hpp>
 #include "scheduler.hpp"
 
 using disvm::vm_t;
@@ -16,6 +17,7 @@ using disvm::vm_t;
 using disvm::debug::component_trace_t;
 using disvm::debug::log_level_t;
 
+using disvm::runtime::vm_alloc_t;
 using disvm::runtime::vm_thread_t;
 using disvm::runtime::vm_scheduler_t;
 using disvm::runtime::vm_scheduler_control_t;
@@ -32,6 +34,13 @@ vm_scheduler_control_t::~vm_scheduler_control_t()
 {
 }
 
+namespace
+{
+    // [PERF] Maximum number of queued allocations a worker frees after each thread quantum.
+    // Freeing large structures is spread across quanta rather than pausing the releasing thread.
+    const std::size_t pending_frees_per_quantum = 1024;
+}
+
 void default_scheduler_t::worker_main(default_scheduler_t &instance)
 {
     disvm::debug::log_msg(component_trace_t::scheduler, log_level_t::debug, "scheduler: worker: start");
@@ -54,6 +63,7 @@ void default_scheduler_t::worker_main(default_scheduler_t &instance)
                 disvm::debug::log_msg(component_trace_t::scheduler, log_level_t::debug, "scheduler: worker: execute: %d", current_thread->vm_thread->get_thread_id());
 
             current_thread->vm_thread->execute(instance._vm, instance._vm_thread_quanta);
+            disvm::runtime::free_pending_allocs(pending_frees_per_quantum);
         }
     }
     catch (const vm_term_request &te)
@@ -347,10 +357,21 @@ std::shared_ptr<default_scheduler_t::thread_instance_t> default_scheduler_t::nex
         if (_terminating)
             return{};
 
+        // Merge releases from other threads and free the remaining queued allocations before waiting
+        // so an idle worker doesn't hold memory. While parked, other threads merge their own releases.
+        if (!disvm::runtime::park_system_thread())
+        {
+            lock.unlock();
+            vm_alloc_t::process_deferred_releases();
+            disvm::runtime::free_pending_allocs();
+            continue;
+        }
+
         if (disvm::debug::is_component_tracing_enabled<component_trace_t::scheduler>())
             disvm::debug::log_msg(component_trace_t::scheduler, log_level_t::debug, "scheduler: worker: waiting");
 
         _worker_event.wait(lock);
+        disvm::runtime::unpark_system_thread();
 
         if (_terminating)
             return{};
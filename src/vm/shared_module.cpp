@@ -0,0 +1,152 @@
+//
+// Dis VM
+// File: shared_module.cpp
+// Author: arr
+//
+
+#include <cassert>
+#include <atomic>
+#include <cstring>
+#include <forward_list>
+#include <future>
+#include <mutex>
+#include <string>
+#include <debug.hpp>
+#include "shared_module.hpp"
+
+using disvm::debug::component_trace_t;
+using disvm::debug::log_level_t;
+
+using disvm::runtime::module_id_t;
+using disvm::runtime::vm_module_t;
+using disvm::runtime::vm_memory_allocator_t;
+using disvm::runtime::load_shared_module_callback_t;
+
+namespace
+{
+    std::atomic<module_id_t> last_module_id{ 0 };
+
+    struct shared_module_entry_t
+    {
+        std::string identity;
+        bool jit_enabled;
+        vm_memory_allocator_t allocator;
+        module_id_t vm_id;
+
+        // Null once the module is no longer used by any VM
+        std::weak_ptr<vm_module_t> module;
+
+        // Set while a VM is loading the module. VMs requesting the module at the same
+        // time wait for the result instead of reading the module again.
+        std::shared_future<std::shared_ptr<vm_module_t>> loading;
+    };
+
+    // Modules are loaded without holding the lock so loading one module doesn't block
+    // VMs requesting other modules.
+    std::mutex shared_modules_lock;
+    std::forward_list<shared_module_entry_t> shared_modules;
+}
+
+module_id_t disvm::runtime::get_next_module_id()
+{
+    return ++last_module_id;
+}
+
+std::shared_ptr<vm_module_t> disvm::runtime::get_shared_module(
+    const std::string &identity,
+    bool jit_enabled,
+    vm_memory_allocator_t allocator,
+    const load_shared_module_callback_t &load_module)
+{
+    assert(!identity.empty() && load_module != nullptr);
+
+    auto entry = static_cast<shared_module_entry_t *>(nullptr);
+    auto loaded = std::promise<std::shared_ptr<vm_module_t>>{};
+    for (;;)
+    {
+        auto loading = std::shared_future<std::shared_ptr<vm_module_t>>{};
+        {
+            std::lock_guard<std::mutex> lock{ shared_modules_lock };
+
+            for (auto &e : shared_modules)
+            {
+                if (e.jit_enabled == jit_enabled
+                    && e.allocator.alloc == allocator.alloc
+                    && e.allocator.free == allocator.free
+                    && e.identity == identity)
+                {
+                    entry = &e;
+                    break;
+                }
+            }
+
+            if (entry == nullptr)
+            {
+                shared_modules.push_front(shared_module_entry_t{ identity, jit_enabled, allocator, get_next_module_id(), {}, {} });
+                entry = &shared_modules.front();
+            }
+
+            auto module = entry->module.lock();
+            if (module != nullptr)
+            {
+                if (disvm::debug::is_component_tracing_enabled<component_trace_t::module>())
+                    disvm::debug::log_msg(component_trace_t::module, log_level_t::debug, "shared: vm module: >>%s<<", identity.c_str());
+
+                return module;
+            }
+
+            // This VM loads the module if no other VM is
+            if (!entry->loading.valid())
+            {
+                entry->loading = loaded.get_future().share();
+                break;
+            }
+
+            loading = entry->loading;
+        }
+
+        // If the other VM fails to load the module, this VM tries to load it instead
+        auto module = loading.get();
+        if (module != nullptr)
+            return module;
+    }
+
+    auto module = std::shared_ptr<vm_module_t>{};
+    try
+    {
+        module = load_module();
+        assert(module != nullptr);
+        module->vm_id = entry->vm_id;
+    }
+    catch (...)
+    {
+        {
+            std::lock_guard<std::mutex> lock{ shared_modules_lock };
+            entry->loading = {};
+        }
+
+        loaded.set_value(nullptr);
+        throw;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{ shared_modules_lock };
+        entry->module = module;
+        entry->loading = {};
+    }
+
+    loaded.set_value(module);
+    return module;
+}
+
+bool disvm::runtime::is_shared_module(const vm_module_t &module)
+{
+    std::lock_guard<std::mutex> lock{ shared_modules_lock };
+    for (auto &e : shared_modules)
+    {
+        if (e.module.lock().get() == &module)
+            return true;
+    }
+
+    return false;
+}
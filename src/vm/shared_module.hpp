@@ -0,0 +1,41 @@
+//
+// Dis VM
+// File: shared_module.hpp
+// Author: arr
+//
+
+#ifndef _DISVM_SRC_VM_SHARED_MODULE_HPP_
+#define _DISVM_SRC_VM_SHARED_MODULE_HPP_
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <runtime.hpp>
+
+namespace disvm
+{
+    namespace runtime
+    {
+        // Callback to load a module that will be shared
+        using load_shared_module_callback_t = std::function<std::shared_ptr<vm_module_t>()>;
+
+        // Get a module ID that is unique within the process.
+        module_id_t get_next_module_id();
+
+        // Get the module loaded from the file with the supplied identity (see vm_module_resolver_t::try_get_module_identity())
+        // that is shared by all VMs in the process. If the module isn't loaded, the supplied callback is used to load it,
+        // and VMs requesting the same module at the same time wait for it. The module ID is assigned by this function
+        // and is the same each time a file is loaded. Modules are only shared between VMs with the same JIT setting
+        // and memory allocator.
+        std::shared_ptr<vm_module_t> get_shared_module(
+            const std::string &identity,
+            bool jit_enabled,
+            vm_memory_allocator_t allocator,
+            const load_shared_module_callback_t &load_module);
+
+        // Returns 'true' if the supplied module is shared between VMs.
+        bool is_shared_module(const vm_module_t &module);
+    }
+}
+
+#endif // _DISVM_SRC_VM_SHARED_MODULE_HPP_
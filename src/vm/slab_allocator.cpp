@@ -0,0 +1,313 @@
+//
+// Dis VM
+// File: slab_allocator.cpp
+// Author: arr
+//
+
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include "slab_allocator.hpp"
+
+using disvm::runtime::vm_memory_allocator_t;
+
+namespace
+{
+    // Sizes of the allocation classes, in multiples of 16 bytes
+    const std::size_t size_classes[] =
+    {
+        16, 32, 48, 64, 80, 96, 112, 128,
+        160, 192, 224, 256, 320, 384, 448, 512,
+        640, 768, 896, 1024, 1280, 1536, 1792, 2048,
+    };
+
+    const std::size_t size_class_count = sizeof(size_classes) / sizeof(size_classes[0]);
+    const std::size_t size_class_granularity = 16;
+    const std::size_t max_class_size = size_classes[size_class_count - 1];
+
+    // Allocations larger than the largest class are passed to the system
+    const uint32_t large_class = static_cast<uint32_t>(size_class_count);
+
+    const std::size_t slab_size = 64 * 1024;
+
+    // Every block is preceded by a header that identifies its class
+    struct block_header_t
+    {
+        uint32_t size_class;
+
+        // Set if the block contents are zero, other than the free list link
+        uint32_t is_zeroed;
+    };
+
+    const std::size_t header_size = ((sizeof(block_header_t) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t)) * alignof(std::max_align_t);
+
+    struct free_block_t
+    {
+        free_block_t *next;
+    };
+
+    block_header_t *get_header(void *block)
+    {
+        return reinterpret_cast<block_header_t *>(reinterpret_cast<uint8_t *>(block) - header_size);
+    }
+
+    std::size_t get_block_stride(std::size_t size_class)
+    {
+        return header_size + size_classes[size_class];
+    }
+
+    // Number of blocks moved between a thread cache and the shared lists at once
+    std::size_t get_batch_count(std::size_t size_class)
+    {
+        const auto count = (16 * 1024) / get_block_stride(size_class);
+        return (count < 4) ? 4 : ((count > 64) ? 64 : count);
+    }
+
+    // Find the smallest class that can hold the supplied size
+    uint32_t get_size_class(std::size_t size_in_bytes)
+    {
+        struct class_table_t
+        {
+            class_table_t()
+            {
+                auto size_class = std::size_t{ 0 };
+                for (auto i = std::size_t{ 0 }; i < sizeof(classes); ++i)
+                {
+                    while (size_classes[size_class] < (i * size_class_granularity))
+                        ++size_class;
+
+                    classes[i] = static_cast<uint8_t>(size_class);
+                }
+            }
+
+            uint8_t classes[(max_class_size / size_class_granularity) + 1];
+        };
+
+        static const class_table_t table;
+        assert(size_in_bytes <= max_class_size);
+        return table.classes[(size_in_bytes + size_class_granularity - 1) / size_class_granularity];
+    }
+
+    struct free_list_t
+    {
+        free_block_t *head;
+        std::size_t count;
+
+        void push(free_block_t *block)
+        {
+            block->next = head;
+            head = block;
+            ++count;
+        }
+
+        free_block_t *pop()
+        {
+            auto block = head;
+            if (block != nullptr)
+            {
+                head = block->next;
+                --count;
+            }
+
+            return block;
+        }
+
+        // Move up to the supplied number of blocks to another list
+        void move_to(free_list_t &other, std::size_t max_count)
+        {
+            while (max_count-- > 0 && head != nullptr)
+                other.push(pop());
+        }
+    };
+
+    // Blocks shared by all system threads
+    class central_heap_t final
+    {
+    public:
+        // Move a batch of blocks of the supplied class to the supplied list
+        void refill(uint32_t size_class, free_list_t &list)
+        {
+            const auto batch_count = get_batch_count(size_class);
+            auto &central = _classes[size_class];
+
+            std::lock_guard<std::mutex> lock{ central.lock };
+            if (central.blocks.count < batch_count)
+                add_slab(size_class, central.blocks);
+
+            central.blocks.move_to(list, batch_count);
+        }
+
+        // Allocate and free single blocks without a thread cache
+        free_block_t *alloc(uint32_t size_class)
+        {
+            auto &central = _classes[size_class];
+
+            std::lock_guard<std::mutex> lock{ central.lock };
+            if (central.blocks.head == nullptr)
+                add_slab(size_class, central.blocks);
+
+            return central.blocks.pop();
+        }
+
+        void free(uint32_t size_class, free_block_t *block)
+        {
+            auto &central = _classes[size_class];
+
+            std::lock_guard<std::mutex> lock{ central.lock };
+            central.blocks.push(block);
+        }
+
+        // Return blocks of the supplied class from the supplied list
+        void release(uint32_t size_class, free_list_t &list, std::size_t count)
+        {
+            auto &central = _classes[size_class];
+
+            std::lock_guard<std::mutex> lock{ central.lock };
+            list.move_to(central.blocks, count);
+        }
+
+    private:
+        // [PERF] Slabs are zeroed by the system in bulk, so new blocks don't need to be cleared.
+        static void add_slab(uint32_t size_class, free_list_t &list)
+        {
+            auto slab = static_cast<uint8_t *>(std::calloc(1, slab_size));
+            if (slab == nullptr)
+                return;
+
+            const auto stride = get_block_stride(size_class);
+            for (auto offset = std::size_t{ 0 }; (offset + stride) <= slab_size; offset += stride)
+            {
+                auto header = reinterpret_cast<block_header_t *>(slab + offset);
+                header->size_class = size_class;
+                header->is_zeroed = 1;
+                list.push(reinterpret_cast<free_block_t *>(slab + offset + header_size));
+            }
+        }
+
+        struct central_class_t
+        {
+            std::mutex lock;
+            free_list_t blocks;
+        };
+
+        central_class_t _classes[size_class_count];
+    };
+
+    central_heap_t &get_central_heap()
+    {
+        // The heap is never destroyed since blocks may be freed during process exit
+        static auto heap = new central_heap_t{};
+        return *heap;
+    }
+
+    // Set once the cache of the current system thread has been destroyed (i.e. during thread exit)
+    thread_local bool thread_cache_released = false;
+
+    // Blocks cached by a system thread
+    class thread_cache_t final
+    {
+    public:
+        thread_cache_t()
+            : _classes{}
+        { }
+
+        ~thread_cache_t()
+        {
+            thread_cache_released = true;
+
+            auto &heap = get_central_heap();
+            for (auto i = uint32_t{ 0 }; i < size_class_count; ++i)
+            {
+                if (_classes[i].count > 0)
+                    heap.release(i, _classes[i], _classes[i].count);
+            }
+        }
+
+        free_block_t *alloc(uint32_t size_class)
+        {
+            auto &list = _classes[size_class];
+            if (list.head == nullptr)
+                get_central_heap().refill(size_class, list);
+
+            return list.pop();
+        }
+
+        void free(uint32_t size_class, free_block_t *block)
+        {
+            auto &list = _classes[size_class];
+            list.push(block);
+
+            // Blocks freed on this thread that were allocated on another thread
+            // accumulate here, so the excess is returned to the shared lists.
+            const auto batch_count = get_batch_count(size_class);
+            if (list.count > (2 * batch_count))
+                get_central_heap().release(size_class, list, batch_count);
+        }
+
+    private:
+        free_list_t _classes[size_class_count];
+    };
+
+    thread_local thread_cache_t thread_cache;
+}
+
+void *disvm::runtime::slab_alloc(std::size_t element_count, std::size_t element_size)
+{
+    if (element_size != 0 && element_count > (std::numeric_limits<std::size_t>::max() - header_size) / element_size)
+        return nullptr;
+
+    const auto size_in_bytes = element_count * element_size;
+    if (size_in_bytes > max_class_size)
+    {
+        auto header = static_cast<block_header_t *>(std::calloc(1, header_size + size_in_bytes));
+        if (header == nullptr)
+            return nullptr;
+
+        header->size_class = large_class;
+        return reinterpret_cast<uint8_t *>(header) + header_size;
+    }
+
+    const auto size_class = get_size_class(size_in_bytes);
+    auto block = thread_cache_released ? get_central_heap().alloc(size_class) : thread_cache.alloc(size_class);
+    if (block == nullptr)
+        return nullptr;
+
+    // Only the free list link needs to be cleared in a block from a new slab
+    auto header = get_header(block);
+    if (header->is_zeroed != 0)
+        block->next = nullptr;
+    else
+        std::memset(block, 0, (size_in_bytes < sizeof(free_block_t)) ? sizeof(free_block_t) : size_in_bytes);
+
+    return block;
+}
+
+void disvm::runtime::slab_free(void *memory)
+{
+    if (memory == nullptr)
+        return;
+
+    auto header = get_header(memory);
+    if (header->size_class == large_class)
+    {
+        std::free(header);
+        return;
+    }
+
+    assert(header->size_class < size_class_count);
+    header->is_zeroed = 0;
+
+    auto block = static_cast<free_block_t *>(memory);
+    if (thread_cache_released)
+        get_central_heap().free(header->size_class, block);
+    else
+        thread_cache.free(header->size_class, block);
+}
+
+vm_memory_allocator_t disvm::runtime::get_slab_allocator()
+{
+    return{ disvm::runtime::slab_alloc, disvm::runtime::slab_free };
+}
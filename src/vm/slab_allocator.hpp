@@ -0,0 +1,30 @@
+//
+// Dis VM
+// File: slab_allocator.hpp
+// Author: arr
+//
+
+#ifndef _DISVM_SRC_VM_SLAB_ALLOCATOR_HPP_
+#define _DISVM_SRC_VM_SLAB_ALLOCATOR_HPP_
+
+#include <cstddef>
+#include <runtime.hpp>
+
+namespace disvm
+{
+    namespace runtime
+    {
+        // Size-class slab allocator with the semantics of std::calloc and std::free.
+        //
+        // Small allocations are carved from slabs shared by the process and cached per
+        // system thread, so most allocations and frees don't take a lock. Memory may be freed
+        // on any thread. Slabs are zeroed in bulk when created and are not returned to the system.
+        void *slab_alloc(std::size_t element_count, std::size_t element_size);
+        void slab_free(void *memory);
+
+        // Get the slab allocator functions.
+        vm_memory_allocator_t get_slab_allocator();
+    }
+}
+
+#endif // _DISVM_SRC_VM_SLAB_ALLOCATOR_HPP_
@@ -529,7 +529,7 @@ Sys_fprint(vm_registers_t &r, vm_t &vm)
     auto fp_base = r.stack.peek_frame()->base();
     auto &fp = r.stack.peek_frame()->base<F_Sys_fprint>();
     auto fd_alloc = vm_alloc_t::from_allocation(fp.fd);
-    assert(fd_alloc->alloc_type == T_FD);
+    assert(fd_alloc->alloc_type == T_FD.get());
     auto fd = fd_alloc->get_allocation<Sys_FD_Impl>();
     auto str = vm_alloc_t::from_allocation<vm_string_t>(fp.s);
     if (str == nullptr)
@@ -703,7 +703,7 @@ Sys_read(vm_registers_t &r, vm_t &vm)
     if (fd_alloc == nullptr)
         throw dereference_nil{ "Read from file descriptor" };
 
-    assert(fd_alloc->alloc_type == T_FD);
+    assert(fd_alloc->alloc_type == T_FD.get());
 
     auto fd = fd_alloc->get_allocation<Sys_FD_Impl>();
     *fp.ret = fd->impl->read(vm, n, buffer->at(0));
@@ -738,7 +738,7 @@ Sys_seek(vm_registers_t &r, vm_t &vm)
     if (fd_alloc == nullptr)
         throw dereference_nil{ "Seek in file descriptor" };
 
-    assert(fd_alloc->alloc_type == T_FD);
+    assert(fd_alloc->alloc_type == T_FD.get());
     auto fd = fd_alloc->get_allocation<Sys_FD_Impl>();
 
     const auto start = convert_to_seekdir(fp.start);
@@ -1020,7 +1020,7 @@ Sys_write(vm_registers_t &r, vm_t &vm)
     if (fd_alloc == nullptr)
         throw dereference_nil{ "Write to file descriptor" };
 
-    assert(fd_alloc->alloc_type == T_FD);
+    assert(fd_alloc->alloc_type == T_FD.get());
 
     auto fd = fd_alloc->get_allocation<Sys_FD_Impl>();
     fd->impl->write(vm, n, buffer->at(0));
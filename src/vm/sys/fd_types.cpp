@@ -21,6 +21,7 @@ using disvm::debug::log_level_t;
 using disvm::runtime::big_t;
 using disvm::runtime::byte_t;
 using disvm::runtime::type_descriptor_t;
+using disvm::runtime::vm_alloc_t;
 using disvm::runtime::vm_string_t;
 using disvm::runtime::word_t;
 using disvm::runtime::vm_system_exception;
@@ -40,7 +41,8 @@ namespace
 {
     namespace hidden_type_desc
     {
-        const type_descriptor_t vm_fd_t{ 0, 0, nullptr, type_descriptor_t::no_finalizer, "vm_fd_t" };
+        // File descriptors are closed by their destructors so they are freed eagerly (see dec_ref_count_and_free()).
+        const type_descriptor_t vm_fd_t{ 0, 0, nullptr, 0, nullptr, type_descriptor_t::no_finalizer, true, "vm_fd_t" };
 
         struct
         {
@@ -171,7 +171,7 @@ word_t disvm::runtime::sys::printf_to_buffer(
                 if (alloc != nullptr)
                 {
                     rc = alloc->get_ref_count();
-                    type_alloc = alloc->alloc_type.get();
+                    type_alloc = alloc->alloc_type;
                 }
 
                 wb = std::snprintf(b_curr, (b_end - b_curr), "%" PRIuPTR ".%#08" PRIxPTR, static_cast<std::uintptr_t>(rc), reinterpret_cast<std::uintptr_t>(type_alloc));
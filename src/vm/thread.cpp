@@ -26,14 +26,11 @@ using disvm::runtime::type_descriptor_t;
 using disvm::runtime::word_t;
 using disvm::runtime::pointer_t;
 using disvm::runtime::vm_pc_t;
-using disvm::runtime::vm_exec_op_t;
 using disvm::runtime::vm_thread_t;
 using disvm::runtime::vm_frame_t;
 using disvm::runtime::vm_module_t;
 using disvm::runtime::vm_module_ref_t;
 using disvm::runtime::vm_registers_t;
-using disvm::runtime::address_mode_t;
-using disvm::runtime::address_mode_middle_t;
 using disvm::runtime::vm_trap_flags_t;
 using disvm::runtime::vm_thread_state_t;
 using disvm::runtime::vm_tool_dispatch_t;
@@ -41,29 +38,6 @@ using disvm::runtime::vm_system_exception;
 
 namespace
 {
-#include "address_decoding.inc"
-
-    // Update VM registers based on the instruction.
-    void decode_address(const vm_exec_op_t &inst, vm_registers_t &reg)
-    {
-        decode_table[inst.addr_code](inst, reg);
-
-#ifndef NDEBUG
-        // This is a perf critical function so logging is only available in debug builds
-        if (disvm::debug::is_component_tracing_enabled<component_trace_t::addressing>())
-        {
-            disvm::debug::log_msg(
-                component_trace_t::addressing,
-                log_level_t::debug,
-                "decode: registers: %d (%#" PRIxPTR " %#" PRIxPTR " %#" PRIxPTR ")",
-                inst.opcode,
-                reg.src,
-                reg.mid,
-                reg.dest);
-        }
-#endif
-    }
-
     uint32_t get_unique_thread_id()
     {
         static std::atomic<uint32_t> thread_id_counter{ 1 };
@@ -87,12 +61,16 @@ vm_registers_t::vm_registers_t(
     , src{ nullptr }
     , mid{ nullptr }
     , dest{ nullptr }
+    , fp{ nullptr }
+    , mp{ nullptr }
 {
     // Add a reference to the module ref and MP register
     if (mp_base != nullptr)
         mp_base->add_ref();
 
     module_ref->add_ref();
+
+    update_mp();
 }
 
 vm_registers_t::~vm_registers_t()
@@ -104,6 +82,17 @@ vm_registers_t::~vm_registers_t()
     debug::assign_debug_pointer(&module_ref);
 }
 
+void vm_registers_t::update_fp()
+{
+    auto top_frame = stack.peek_frame();
+    fp = (top_frame != nullptr) ? top_frame->base() : nullptr;
+}
+
+void vm_registers_t::update_mp()
+{
+    mp = (mp_base != nullptr) ? mp_base->get_allocation() : nullptr;
+}
+
 void disvm::runtime::walk_stack(const vm_registers_t &r, vm_stack_walk_callback_t callback)
 {
     assert(callback != nullptr);
@@ -149,6 +138,7 @@ vm_thread_t::vm_thread_t(
 
     // Pushing the initial frame sets the FP register
     _registers.stack.push_frame();
+    _registers.update_fp();
 
     disvm::debug::log_msg(component_trace_t::thread, log_level_t::debug, "init: vm thread: %d %d", _thread_id, _parent_thread_id);
 }
@@ -175,6 +165,7 @@ vm_thread_t::vm_thread_t(
 
     // Pushing the initial frame sets the FP register
     auto current_frame = _registers.stack.push_frame();
+    _registers.update_fp();
 
     //  Copy over the frame into this thread - pass arguments to the thread
     current_frame->copy_frame_contents(initial_frame);
@@ -192,67 +183,6 @@ vm_thread_t::~vm_thread_t()
     debug::assign_debug_pointer(&_error_message);
 }
 
-namespace
-{
-    struct execute_with_tool_t final
-    {
-        static void begin_exec_loop(vm_registers_t &r, vm_t &)
-        {
-            auto tool_dispatch = r.tool_dispatch.load();
-            assert(tool_dispatch != nullptr);
-
-            tool_dispatch->block_if_thread_suspended(r.thread.get_thread_id());
-        }
-
-        static void after_exec(vm_registers_t &r, vm_t &)
-        {
-            if (r.trap_flags == vm_trap_flags_t::none
-                || !disvm::util::has_flag(r.trap_flags, vm_trap_flags_t::instruction))
-                return;
-
-            auto tool_dispatch = r.tool_dispatch.load();
-            assert(tool_dispatch != nullptr);
-
-            tool_dispatch->on_trap(r, vm_trap_flags_t::instruction);
-        }
-    };
-
-    struct execute_normal_t final
-    {
-        static void begin_exec_loop(vm_registers_t &, vm_t &) { }
-        static void after_exec(vm_registers_t &, vm_t &) { }
-    };
-
-    template<typename EXEC_DETOUR>
-    void execute_impl(vm_registers_t &r, vm_t &vm)
-    {
-        for (; 0 != r.current_thread_quanta; --r.current_thread_quanta)
-        {
-            EXEC_DETOUR::begin_exec_loop(r, vm);
-            assert(r.stack.peek_frame() != nullptr && "Thread state should not be running with empty stack");
-
-            const auto &code_section = r.module_ref->code_section;
-            assert(static_cast<std::size_t>(r.pc) < code_section.size());
-
-            assert(!r.module_ref->is_builtin_module() && "Interpreter thread is unable to execute native instructions");
-            const auto &inst = code_section[r.pc].op;
-            const auto opcode = static_cast<std::size_t>(inst.opcode);
-            assert(opcode <= static_cast<std::size_t>(opcode_t::last_opcode));
-
-            // Instruction is valid, decode and update registers for operation
-            decode_address(inst, r);
-            r.next_pc = (r.pc + 1);
-            disvm::runtime::vm_exec_table[opcode](r, vm);
-            r.pc = r.next_pc;
-
-            EXEC_DETOUR::after_exec(r, vm);
-
-            if (r.current_thread_state != vm_thread_state_t::running)
-                break;
-        }
-    }
-}
-
 vm_thread_state_t vm_thread_t::execute(vm_t &vm, const uint32_t quanta)
 {
     const auto max_error_message = std::size_t{ 1024 };
@@ -264,10 +194,8 @@ vm_thread_state_t vm_thread_t::execute(vm_t &vm, const uint32_t quanta)
 
     try
     {
-        if (tool_dispatch == nullptr)
-            execute_impl<execute_normal_t>(_registers, vm);
-        else
-            execute_impl<execute_with_tool_t>(_registers, vm);
+        const auto interpreter = disvm::runtime::get_interpreter(vm.get_dispatch_strategy(), tool_dispatch != nullptr, vm.is_jit_enabled());
+        interpreter(_registers, vm);
     }
     catch (const vm_term_request &)
     {
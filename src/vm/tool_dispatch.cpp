@@ -13,6 +13,8 @@
 #include <exceptions.hpp>
 #include <utils.hpp>
 #include "tool_dispatch.hpp"
+#include "instruction_decoder.hpp"
+#include "shared_module.hpp"
 
 using disvm::vm_t;
 using disvm::opcode_t;
@@ -35,6 +37,7 @@ using disvm::runtime::vm_event_t;
 using disvm::runtime::vm_event_context_t;
 using disvm::runtime::vm_event_callback_t;
 using disvm::runtime::breakpoint_details_t;
+using disvm::runtime::decode_instruction;
 
 // Empty destructor for vm tool 'interface'
 vm_tool_t::~vm_tool_t()
@@ -270,6 +273,10 @@ cookie_t vm_tool_dispatch_t::set_breakpoint(std::shared_ptr<vm_module_t> module,
     if (module == nullptr || util::has_flag(module->header.runtime_flag, runtime_flags_t::builtin))
         throw vm_system_exception{ "Unable to set breakpoint in supplied module" };
 
+    // Breakpoints modify the code section, which would be observed by all VMs sharing the module
+    if (is_shared_module(*module))
+        throw vm_system_exception{ "Unable to set breakpoint in shared module" };
+
     auto &code_section = module->code_section;
     if (pc >= static_cast<vm_pc_t>(code_section.size()))
         throw vm_system_exception{ "Invalid PC for module" };
@@ -298,6 +305,7 @@ cookie_t vm_tool_dispatch_t::set_breakpoint(std::shared_ptr<vm_module_t> module,
 
         // Replace the current opcode with breakpoint
         code_section[pc].op.opcode = opcode_t::brkpt;
+        decode_instruction(*module, pc);
 
         if (disvm::debug::is_component_tracing_enabled<component_trace_t::tool>())
             disvm::debug::log_msg(component_trace_t::tool, log_level_t::debug, "breakpoint: set: %d %d >>%s<<", cookie_id, pc, module->module_name->str());
@@ -306,6 +314,11 @@ cookie_t vm_tool_dispatch_t::set_breakpoint(std::shared_ptr<vm_module_t> module,
     }
 }
 
+opcode_t vm_tool_dispatch_t::get_original_opcode(const vm_registers_t &r)
+{
+    return std::get<0>(get_original_opcode_and_cookie(r));
+}
+
 breakpoint_details_t vm_tool_dispatch_t::get_breakpoint_details(cookie_t cookie_id) const
 {
     std::lock_guard<std::mutex> lock{ _breakpoints.lock };
@@ -339,9 +352,10 @@ void vm_tool_dispatch_t::clear_breakpoint(cookie_t cookie_id)
     auto original_opcode = iter_pc->second.first;
 
     // Replace the breakpoint opcode with the original
-    auto &code_section = const_cast<code_section_t &>(details.module->code_section);
-    assert(code_section[target_pc].op.opcode == opcode_t::brkpt);
-    code_section[target_pc].op.opcode = original_opcode;
+    auto &module = *details.module;
+    assert(module.code_section[target_pc].op.opcode == opcode_t::brkpt);
+    module.code_section[target_pc].op.opcode = original_opcode;
+    decode_instruction(module, target_pc);
 
     if (disvm::debug::is_component_tracing_enabled<component_trace_t::tool>())
         disvm::debug::log_msg(component_trace_t::tool, log_level_t::debug, "breakpoint: unset: %d %d >>%s<<", cookie_id, target_pc, details.module->module_name->str());
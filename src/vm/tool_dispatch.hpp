@@ -39,6 +39,9 @@ namespace disvm
             // Returns opcode that was replaced by breakpoint opcode.
             opcode_t on_breakpoint(vm_registers_t &r);
 
+            // Get the opcode replaced by the breakpoint at the current program counter.
+            opcode_t get_original_opcode(const vm_registers_t &r);
+
             // Callback on a raised exception
             void on_exception_raised(vm_registers_t &r, const vm_string_t &id, vm_alloc_t &e);
 
@@ -12,12 +12,17 @@
 #include <debug.hpp>
 #include <runtime.hpp>
 #include <exceptions.hpp>
+#include <vm_memory.hpp>
 #include <builtin_module.hpp>
 #include <vm_version.hpp>
 #include "scheduler.hpp"
 #include "garbage_collector.hpp"
 #include "tool_dispatch.hpp"
 #include "module_resolver.hpp"
+#include "shared_module.hpp"
+#include "instruction_decoder.hpp"
+#include "execution_table.hpp"
+#include "jit.hpp"
 
 using disvm::vm_t;
 using disvm::vm_config_t;
@@ -27,6 +32,7 @@ using disvm::loaded_vm_module_callback_t;
 using disvm::debug::component_trace_t;
 using disvm::debug::log_level_t;
 
+using disvm::runtime::vm_alloc_t;
 using disvm::runtime::vm_pc_t;
 using disvm::runtime::vm_thread_t;
 using disvm::runtime::vm_memory_allocator_t;
@@ -40,6 +46,7 @@ using disvm::runtime::vm_scheduler_t;
 using disvm::runtime::vm_scheduler_control_t;
 using disvm::runtime::vm_tool_t;
 using disvm::runtime::vm_tool_dispatch_t;
+using disvm::runtime::vm_dispatch_strategy_t;
 using disvm::runtime::vm_user_exception;
 using disvm::runtime::vm_module_exception;
 using disvm::runtime::vm_system_exception;
@@ -117,9 +124,25 @@ namespace
             || (vm_memory_alloc == allocator.alloc && vm_memory_free == allocator.free))
             && "Thread already registered with another VM");
 
+        // Allocations released by other threads are freed while the thread can still free memory
+        if (vm_memory_free != nullptr)
+        {
+            vm_alloc_t::process_deferred_releases();
+            disvm::runtime::free_pending_allocs();
+        }
+
         vm_memory_alloc = nullptr;
         vm_memory_free = nullptr;
     }
+
+    // Prepare a newly loaded module for execution
+    void prepare_module(vm_module_t &module, bool jit_enabled)
+    {
+        disvm::runtime::decode_code_section(module);
+
+        if (jit_enabled)
+            disvm::runtime::prepare_native_code(module);
+    }
 }
 
 void disvm::runtime::register_system_thread(vm_t &vm)
@@ -136,8 +159,9 @@ void disvm::runtime::unregister_system_thread(vm_t &vm)
 
 const uint32_t vm_t::root_vm_thread_id = 0;
 
-// The Inferno implementation defined the thread quanta as 2048 (include/interp.h)
-const uint32_t default_thread_quanta = 2048;
+// The Inferno implementation defined the thread quanta as 2048 instructions (include/interp.h).
+// The quanta is only charged at preemption points so it is scaled down by a typical basic block length.
+const uint32_t default_thread_quanta = 256;
 const uint32_t default_system_thread_count = 1;
 
 vm_config_t::vm_config_t()
@@ -145,6 +169,9 @@ vm_config_t::vm_config_t()
     , create_scheduler{ nullptr }
     , sys_thread_pool_size{ default_system_thread_count }
     , thread_quanta{ default_thread_quanta }
+    , dispatch_strategy{ vm_dispatch_strategy_t::call_threaded }
+    , jit_enabled{ false }
+    , share_modules{ false }
 { }
 
 vm_config_t::vm_config_t(vm_config_t &&other)
@@ -152,15 +179,23 @@ vm_config_t::vm_config_t(vm_config_t &&other)
     , create_gc{ other.create_gc }
     , create_scheduler{ other.create_scheduler }
     , probing_paths{ std::move(other.probing_paths) }
+    , module_image_cache_path{ std::move(other.module_image_cache_path) }
     , sys_thread_pool_size{ other.sys_thread_pool_size }
     , thread_quanta{ other.thread_quanta }
+    , dispatch_strategy{ other.dispatch_strategy }
+    , jit_enabled{ other.jit_enabled }
+    , share_modules{ other.share_modules }
 { }
 
 vm_t::vm_t()
     : _last_syscall_error_message{}
     , _last_syscall_error_message_lock{ ATOMIC_FLAG_INIT }
+    , _dispatch_strategy{ vm_dispatch_strategy_t::call_threaded }
+    , _jit_enabled{ false }
+    , _share_modules{ false }
 {
     _gc = std::make_unique<default_garbage_collector_t>(*this);
+    _module_index = std::make_shared<const module_index_t>();
 
     internal_register_system_thread(_gc->get_allocator());
 
@@ -173,12 +208,17 @@ vm_t::vm_t()
 
 vm_t::vm_t(vm_config_t config)
     : _last_syscall_error_message{}
+    , _dispatch_strategy{ get_supported_dispatch_strategy(config.dispatch_strategy) }
+    , _jit_enabled{ config.jit_enabled }
+    , _share_modules{ config.share_modules }
 {
     if (config.create_gc == nullptr)
         _gc = std::make_unique<default_garbage_collector_t>(*this);
     else
         _gc = config.create_gc(*this);
 
+    _module_index = std::make_shared<const module_index_t>();
+
     internal_register_system_thread(_gc->get_allocator());
 
     // Initialize built-in modules.
@@ -190,7 +230,7 @@ vm_t::vm_t(vm_config_t config)
         _scheduler = config.create_scheduler(*this);
 
     _module_resolvers = std::move(config.additional_resolvers);
-    _module_resolvers.push_back(std::make_unique<default_resolver_t>(*this, std::move(config.probing_paths)));
+    _module_resolvers.push_back(std::make_unique<default_resolver_t>(*this, std::move(config.probing_paths), std::move(config.module_image_cache_path)));
 }
 
 vm_t::~vm_t()
@@ -199,12 +239,18 @@ vm_t::~vm_t()
     _scheduler.reset();
     _gc.reset();
 
-    std::lock_guard<std::mutex> lock{ _modules_lock };
-    for (auto &m : _modules)
     {
-        if (m.origin != nullptr)
-            m.origin->release();
+        std::lock_guard<std::mutex> lock{ _modules_lock };
+        for (auto &m : _modules)
+        {
+            if (m.origin != nullptr)
+                m.origin->release();
+        }
     }
+
+    // Free allocations queued while releasing the collector and modules
+    if (vm_memory_free != nullptr)
+        disvm::runtime::free_pending_allocs();
 }
 
 vm_version_t vm_t::get_version() const
@@ -242,6 +288,7 @@ uint32_t vm_t::exec(const char *path)
 uint32_t vm_t::exec(std::unique_ptr<vm_module_t> entry_module)
 {
     assert(entry_module != nullptr);
+    prepare_module(*entry_module, _jit_enabled);
 
     auto entry_module_ref = std::make_unique<vm_module_ref_t>(std::move(entry_module));
     auto thread = _create_thread_safe(std::move(entry_module_ref));
@@ -269,39 +316,45 @@ uint32_t vm_t::fork(
 
 namespace
 {
+    // Returns the module name of an Inferno OS path, otherwise null.
+    const char *get_inferno_module_name(const char *path)
+    {
+        // Check if the path is for the Inferno OS.
+        const char *inferno_root_path = "/dis/";
+        if (std::strncmp(path, inferno_root_path, sizeof(inferno_root_path)) != 0)
+            return nullptr;
+
+        // Plus 1 for the next character. We know this will either be
+        // null or valid character since we searched for a string
+        // containing the character above.
+        const char *module_name = std::strrchr(path, '/') + 1;
+        return (*module_name != '\0') ? module_name : nullptr;
+    }
+
     std::unique_ptr<vm_module_t> resolve_module_from_path(const char *path, const std::vector<std::unique_ptr<vm_module_resolver_t>> &resolvers)
     {
         assert(!resolvers.empty());
         std::unique_ptr<vm_module_t> resolved_module;
 
-        // Check if the path is for the Inferno OS.
-        const char *inferno_root_path = "/dis/";
-        if (std::strncmp(path, inferno_root_path, sizeof(inferno_root_path)) == 0)
+        const char *module_name = get_inferno_module_name(path);
+        if (module_name != nullptr)
         {
             if (disvm::debug::is_component_tracing_enabled<component_trace_t::module>())
                 disvm::debug::log_msg(component_trace_t::module, log_level_t::debug, "load: vm module: Inferno OS path detected - >>%s<<", path);
 
-            // Plus 1 for the next character. We know this will either be
-            // null or valid character since we searched for a string
-            // containing the character above.
-            const char *module_name = std::strrchr(path, '/') + 1;
-
-            if (*module_name != '\0')
+            for (auto &r : resolvers)
             {
-                for (auto &r : resolvers)
+                // Since we are using a modified path, throwing an exception
+                // isn't fair. We will catch all exceptions here and rely on
+                // non-modified path resolution to trigger the actual failure.
+                try
+                {
+                    if (r->try_resolve_module(module_name, resolved_module))
+                        return resolved_module;
+                }
+                catch (...)
                 {
-                    // Since we are using a modified path, throwing an exception
-                    // isn't fair. We will catch all exceptions here and rely on
-                    // non-modified path resolution to trigger the actual failure.
-                    try
-                    {
-                        if (r->try_resolve_module(module_name, resolved_module))
-                            return resolved_module;
-                    }
-                    catch (...)
-                    {
-                        // No-op
-                    }
+                    // No-op
                 }
             }
         }
@@ -317,6 +370,63 @@ namespace
         ss << "Failed to resolve path to module: " << path;
         throw vm_module_exception{ ss.str().c_str() };
     }
+
+    std::shared_ptr<vm_module_t> load_module_from_path(const char *path, const std::vector<std::unique_ptr<vm_module_resolver_t>> &resolvers, bool jit_enabled)
+    {
+        auto module = std::shared_ptr<vm_module_t>{ resolve_module_from_path(path, resolvers) };
+        assert(module != nullptr);
+        prepare_module(*module, jit_enabled);
+
+        return module;
+    }
+
+    // Identify the file the supplied path resolves to, trying resolvers in the same order as resolve_module_from_path().
+    // Returns 'false' if the first resolver able to resolve the path can't identify the file.
+    bool identify_module_from_path(const char *path, const std::vector<std::unique_ptr<vm_module_resolver_t>> &resolvers, std::string &identity)
+    {
+        const char *module_name = get_inferno_module_name(path);
+        if (module_name != nullptr)
+        {
+            for (auto &r : resolvers)
+            {
+                try
+                {
+                    if (r->try_get_module_identity(module_name, identity))
+                        return !identity.empty();
+                }
+                catch (...)
+                {
+                    // No-op
+                }
+            }
+        }
+
+        for (auto &r : resolvers)
+        {
+            if (r->try_get_module_identity(path, identity))
+                return !identity.empty();
+        }
+
+        return false;
+    }
+
+    // Load the module shared between VMs for the file the supplied path resolves to.
+    // Returns null if the file can't be identified, in which case the module isn't shared.
+    std::shared_ptr<vm_module_t> load_shared_module_from_path(
+        const char *path,
+        const std::vector<std::unique_ptr<vm_module_resolver_t>> &resolvers,
+        bool jit_enabled,
+        disvm::runtime::vm_memory_allocator_t allocator)
+    {
+        auto identity = std::string{};
+        if (!identify_module_from_path(path, resolvers, identity))
+            return{};
+
+        return disvm::runtime::get_shared_module(identity, jit_enabled, allocator, [&]()
+        {
+            return load_module_from_path(path, resolvers, jit_enabled);
+        });
+    }
 }
 
 std::shared_ptr<vm_module_t> vm_t::load_module(const char *path)
@@ -324,56 +434,87 @@ std::shared_ptr<vm_module_t> vm_t::load_module(const char *path)
     if (path == nullptr)
         throw vm_user_exception{ "Invalid module path" };
 
+    auto path_key = std::string{ path };
+
+    // [PERF] Check if the module is already loaded without taking the modules lock.
+    {
+        const auto module_index = std::atomic_load(&_module_index);
+        const auto iter = module_index->find(path_key);
+        if (iter != module_index->cend())
+        {
+            auto module = iter->second.module.lock();
+            if (module != nullptr)
+                return module;
+        }
+    }
+
     auto new_module_iter = loaded_modules_t::const_iterator{};
     auto new_module = std::shared_ptr<vm_module_t>{};
     {
         std::lock_guard<std::mutex> lock{ _modules_lock };
 
-        // Check if the module is already loaded.
-        auto iter = std::begin(_modules);
-        while (iter != std::end(_modules))
+        // Check again since the index may have been updated before the lock was taken.
+        // The index is only replaced while holding the lock.
+        const auto iter = _module_index->find(path_key);
+        if (iter != _module_index->cend())
         {
-            if (0 == ::strcmp(iter->origin->str(), path))
+            auto &loaded_module = *iter->second.loaded_module;
+            auto module = loaded_module.module.lock();
+
+            // If an entry exists but is null, the module was loaded before. Read the module again and return.
+            if (module == nullptr)
             {
-                auto module = iter->module.lock();
+                if (_share_modules)
+                    module = load_shared_module_from_path(path, _module_resolvers, _jit_enabled, _gc->get_allocator());
 
-                // If an entry exists but is null, the module was loaded before. Read the module again and return.
-                if (module == nullptr)
+                // The shared module has another ID if the file changed since this VM first loaded it
+                if (module == nullptr || module->vm_id != loaded_module.vm_id)
                 {
-                    module = std::shared_ptr<vm_module_t>{ std::move(resolve_module_from_path(path, _module_resolvers)) };
-                    module->vm_id = iter->vm_id;
-
-                    iter->module = module;
-
-                    if (disvm::debug::is_component_tracing_enabled<component_trace_t::module>())
-                        disvm::debug::log_msg(component_trace_t::module, log_level_t::debug, "reload: vm module: >>%s<<", path);
+                    module = load_module_from_path(path, _module_resolvers, _jit_enabled);
+                    module->vm_id = loaded_module.vm_id;
                 }
 
-                return module;
+                loaded_module.module = module;
+                publish_module_index(loaded_module, std::move(path_key), module);
+
+                if (disvm::debug::is_component_tracing_enabled<component_trace_t::module>())
+                    disvm::debug::log_msg(component_trace_t::module, log_level_t::debug, "reload: vm module: >>%s<<", path);
             }
 
-            ++iter;
+            return module;
         }
 
+        // Shared modules are assigned an ID that is the same in all VMs
+        auto vm_id_next = disvm::runtime::module_id_t{};
         if (path[0] == BUILTIN_MODULE_PREFIX_CHAR)
         {
             new_module = std::move(disvm::runtime::builtin::get_builtin_module(path));
+            vm_id_next = disvm::runtime::get_next_module_id();
+            new_module->vm_id = vm_id_next;
         }
         else
         {
-            new_module = resolve_module_from_path(path, _module_resolvers);
-            assert(new_module != nullptr);
+            if (_share_modules)
+                new_module = load_shared_module_from_path(path, _module_resolvers, _jit_enabled, _gc->get_allocator());
+
+            if (new_module != nullptr)
+            {
+                vm_id_next = new_module->vm_id;
+            }
+            else
+            {
+                new_module = load_module_from_path(path, _module_resolvers, _jit_enabled);
+                vm_id_next = disvm::runtime::get_next_module_id();
+                new_module->vm_id = vm_id_next;
+            }
         }
 
         auto path_local = std::make_unique<vm_string_t>(std::strlen(path), reinterpret_cast<const uint8_t *>(path));
 
-        auto vm_id_next = std::size_t{ 1 };
-        if (!_modules.empty())
-            vm_id_next = (_modules.front().vm_id + 1);
-
-        new_module->vm_id = vm_id_next;
         _modules.push_front(std::move(loaded_vm_module_t{ vm_id_next, std::move(path_local), new_module }));
         new_module_iter = _modules.begin();
+
+        publish_module_index(_modules.front(), std::move(path_key), new_module);
     }
 
     if (_tool_dispatch != nullptr)
@@ -389,6 +530,15 @@ std::shared_ptr<vm_module_t> vm_t::load_module(const char *path)
     return new_module;
 }
 
+void vm_t::publish_module_index(loaded_vm_module_t &loaded_module, std::string path, std::shared_ptr<vm_module_t> module)
+{
+    // Loading a module is rare compared to finding it, so the index is copied on update.
+    auto module_index = std::make_shared<module_index_t>(*_module_index);
+    (*module_index)[std::move(path)] = module_index_entry_t{ &loaded_module, std::move(module) };
+
+    std::atomic_store(&_module_index, std::shared_ptr<const module_index_t>{ std::move(module_index) });
+}
+
 void vm_t::enum_loaded_modules(loaded_vm_module_callback_t callback) const
 {
     if (callback == nullptr)
@@ -412,6 +562,21 @@ vm_garbage_collector_t &vm_t::get_garbage_collector() const
     return *_gc;
 }
 
+vm_dispatch_strategy_t vm_t::get_supported_dispatch_strategy(vm_dispatch_strategy_t strategy)
+{
+    return disvm::runtime::get_supported_dispatch_strategy(strategy);
+}
+
+vm_dispatch_strategy_t vm_t::get_dispatch_strategy() const
+{
+    return _dispatch_strategy;
+}
+
+bool vm_t::is_jit_enabled() const
+{
+    return _jit_enabled;
+}
+
 void vm_t::spin_sleep_till_idle(std::chrono::milliseconds sleep_interval) const
 {
     do
@@ -4,11 +4,13 @@
 // Author: arr
 //
 
+#include <algorithm>
 #include <memory>
 #include <atomic>
 #include <bitset>
 #include <cstdlib>
 #include <mutex>
+#include <unordered_map>
 #include <limits>
 #include <vector>
 #include <condition_variable>
@@ -118,16 +120,6 @@ void disvm::runtime::dec_ref_count_in_memory(const type_descriptor_t &type_desc,
     enum_pointer_fields(type_desc, data, dec_ref_and_free_pointer_field);
 }
 
-void disvm::runtime::dec_ref_count_and_free(vm_alloc_t *alloc)
-{
-    if (alloc == nullptr)
-        return;
-
-    auto current_ref = alloc->release();
-    if (current_ref == 0)
-        delete alloc;
-}
-
 bool disvm::runtime::is_offset_pointer(const type_descriptor_t &type_desc, std::size_t offset)
 {
     if (type_desc.size_in_bytes == 0)
@@ -153,8 +145,390 @@ bool disvm::runtime::is_offset_pointer(const type_descriptor_t &type_desc, std::
     return false;
 }
 
+namespace
+{
+    //
+    // Biased reference counting
+    //
+    // Each allocation is owned by the system thread that created it. The owner updates the biased count
+    // with plain loads and stores, while other threads update the shared count atomically. The shared
+    // count is stored in multiples of 'shared_count_unit' with flags and the collector's bits in the low bits.
+    // The owner ID and the biased count are stored in the same word. If the biased count is full, further
+    // references taken by the owner are counted by the shared count.
+    //
+    // When the biased count reaches zero the owner merges it into the shared count, clears the owner,
+    // and all further updates use the shared count. If another thread releases a reference and the shared
+    // count becomes negative, the allocation may only be referenced through the biased count so it is queued
+    // for the owner to merge. An allocation is freed by the thread that observes a merged count of zero.
+    // While the owner is parked (waiting for work) or retired it doesn't update biased counts, so the
+    // releasing thread merges the count itself under the owner's lock instead of queuing the allocation.
+    //
+    // Each owner counts the allocations that still carry its ID. Once the owner is retired and the count
+    // reaches zero no allocation refers to the ID, so it is returned to the free list and reused.
+    //
+
+    const int32_t shared_count_merged = 1 << 0;
+    const int32_t shared_count_queued = 1 << 1;
+    const int32_t shared_count_gc_shift = 2;
+    const int32_t shared_count_gc_mask = 3 << shared_count_gc_shift;
+    const int32_t shared_count_unit = 1 << 4;
+
+    constexpr int32_t get_shared_count(int32_t value)
+    {
+        return (value - (value & (shared_count_unit - 1))) / shared_count_unit;
+    }
+
+    const uint32_t biased_count_bits = 16;
+    const uint32_t max_biased_count = (1u << biased_count_bits) - 1;
+
+    // Owner IDs are reused once released (see release_owner_id()), zero indicates no owner.
+    const uint32_t no_owner_id = 0;
+    const uint32_t max_owner_id = (1u << (32 - biased_count_bits)) - 1;
+
+    constexpr uint32_t get_owner_id(uint32_t value)
+    {
+        return value >> biased_count_bits;
+    }
+
+    constexpr uint32_t get_biased_count(uint32_t value)
+    {
+        return value & max_biased_count;
+    }
+
+    constexpr uint32_t make_owner_count(uint32_t owner_id, uint32_t biased_count)
+    {
+        return (owner_id << biased_count_bits) | biased_count;
+    }
+
+    struct owner_t
+    {
+        owner_t(uint32_t id)
+            : id{ id }
+            , has_queued{ false }
+            , released_count{ 0 }
+            , retired{ false }
+            , parked{ false }
+        { }
+
+        const uint32_t id;
+        std::atomic<bool> has_queued;
+
+        // Allocations with this owner merged or freed by other threads. The count
+        // owned by this thread is added when the owner is retired.
+        std::atomic<int64_t> released_count;
+
+        std::mutex lock;
+        bool retired;
+        bool parked;
+        std::vector<vm_alloc_t *> queued;
+
+        // Only accessed by the owning thread (see free_alloc())
+        bool freeing = false;
+        std::vector<vm_alloc_t *> pending_frees;
+        int64_t owned_count = 0;
+    };
+
+    struct owners_t
+    {
+        std::mutex lock;
+        uint32_t last_id;
+        std::vector<uint32_t> free_ids;
+        std::unordered_map<uint32_t, std::shared_ptr<owner_t>> owners;
+    };
+
+    owners_t &get_owners()
+    {
+        // Allocations may be released during process exit
+        static auto owners = new owners_t{};
+        return *owners;
+    }
+
+    std::shared_ptr<owner_t> find_owner(uint32_t id)
+    {
+        auto &owners = get_owners();
+        std::lock_guard<std::mutex> lock{ owners.lock };
+        auto iter = owners.owners.find(id);
+        return (iter != owners.owners.end()) ? iter->second : nullptr;
+    }
+
+    // Called once a retired owner has no allocations left
+    void release_owner_id(const owner_t &owner)
+    {
+        assert(owner.id != no_owner_id);
+        auto &owners = get_owners();
+        std::lock_guard<std::mutex> lock{ owners.lock };
+        owners.owners.erase(owner.id);
+        owners.free_ids.push_back(owner.id);
+    }
+
+    // Owner state of the current system thread. The owner is retired when the thread exits.
+    class thread_owner_t final
+    {
+    public:
+        thread_owner_t()
+        {
+            auto &owners = get_owners();
+            std::lock_guard<std::mutex> lock{ owners.lock };
+
+            // Once the IDs are exhausted, allocations created by new threads have no owner
+            // and are only counted through the shared count.
+            auto id = no_owner_id;
+            if (!owners.free_ids.empty())
+            {
+                id = owners.free_ids.back();
+                owners.free_ids.pop_back();
+            }
+            else if (owners.last_id < max_owner_id)
+            {
+                id = ++owners.last_id;
+            }
+
+            _owner = std::make_shared<owner_t>(id);
+            if (id != no_owner_id)
+                owners.owners.emplace(id, _owner);
+        }
+
+        ~thread_owner_t();
+
+        owner_t &get() const
+        {
+            return *_owner;
+        }
+
+    private:
+        std::shared_ptr<owner_t> _owner;
+    };
+
+    thread_local thread_owner_t thread_owner;
+
+    // Set once the owner of the current system thread is retired
+    thread_local bool thread_owner_retired = false;
+
+    uint32_t get_current_owner_id()
+    {
+        return thread_owner_retired ? no_owner_id : thread_owner.get().id;
+    }
+
+    // Returns 'true' if the current system thread owns allocations with the supplied owner ID.
+    bool is_current_owner(uint32_t owner_id)
+    {
+        return owner_id != no_owner_id && owner_id == get_current_owner_id();
+    }
+
+    // Record that an allocation no longer carries the supplied owner ID
+    void release_owned_alloc(uint32_t owner_id)
+    {
+        assert(owner_id != no_owner_id);
+        if (is_current_owner(owner_id))
+        {
+            --thread_owner.get().owned_count;
+            return;
+        }
+
+        // The owner keeps its ID until all its allocations are released
+        auto owner = find_owner(owner_id);
+        assert(owner != nullptr);
+        if (owner->released_count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            release_owner_id(*owner);
+    }
+
+    // Free allocations released by other threads before allocating
+    void process_queued_releases()
+    {
+        if (!thread_owner_retired && thread_owner.get().has_queued.load(std::memory_order_relaxed))
+            vm_alloc_t::process_deferred_releases();
+    }
+
+    thread_owner_t::~thread_owner_t()
+    {
+        // Releases may run finalizers and free memory so the queue is only processed
+        // if the thread is still registered with a VM. Merging updates biased counts,
+        // so the owner is only retired once nothing else has been queued.
+        for (;;)
+        {
+            if (vm_memory_free != nullptr)
+            {
+                vm_alloc_t::process_deferred_releases();
+                disvm::runtime::free_pending_allocs();
+            }
+
+            std::lock_guard<std::mutex> lock{ _owner->lock };
+            if (vm_memory_free == nullptr || _owner->queued.empty())
+            {
+                // Allocations queued from now on are merged by the releasing thread
+                _owner->retired = true;
+                break;
+            }
+        }
+
+        if (!_owner->queued.empty() || !_owner->pending_frees.empty())
+        {
+            disvm::debug::log_msg(
+                component_trace_t::memory,
+                log_level_t::warning,
+                "owner: retired with %d deferred releases and %d pending frees",
+                static_cast<int>(_owner->queued.size()),
+                static_cast<int>(_owner->pending_frees.size()));
+        }
+
+        thread_owner_retired = true;
+
+        if (_owner->id == no_owner_id)
+            return;
+
+        const auto owned_count = _owner->owned_count;
+        if (_owner->released_count.fetch_add(owned_count, std::memory_order_acq_rel) + owned_count == 0)
+            release_owner_id(*_owner);
+    }
+
+    //
+    // Incremental freeing
+    //
+    // Freeing an allocation releases the allocations it refers to, so releasing the head of a long list
+    // or the root of a large tree would free the entire structure at once through recursive destructors.
+    // Instead only the released allocation is freed, and allocations released by its destruction are
+    // queued on the current system thread. Allocations with a finalizer or an eagerly freed type are never
+    // queued since they may release resources outside of the VM (e.g. close a file) that programs expect
+    // to be released with the last reference. Such allocations referenced directly by a queued allocation
+    // are also released when it is queued. The queue is freed in batches by the scheduler between
+    // thread quanta (see free_pending_allocs()), and is bounded by freeing the excess on the releasing
+    // thread if it grows too large.
+    //
+
+    const std::size_t max_pending_frees = 64 * 1024;
+
+    std::size_t free_pending_unsafe(owner_t &owner, std::size_t budget)
+    {
+        assert(!owner.freeing);
+        owner.freeing = true;
+        for (; budget > 0 && !owner.pending_frees.empty(); --budget)
+        {
+            auto alloc = owner.pending_frees.back();
+            owner.pending_frees.pop_back();
+            delete alloc;
+        }
+
+        owner.freeing = false;
+        return owner.pending_frees.size();
+    }
+
+    bool must_free_promptly(const type_descriptor_t &type_desc)
+    {
+        return type_desc.free_eagerly || type_desc.finalizer != type_descriptor_t::no_finalizer;
+    }
+
+    void release_prompt_pointer_field(pointer_t *pointer_field)
+    {
+        assert(pointer_field != nullptr && *pointer_field != nullptr);
+        auto child = vm_alloc_t::from_allocation(*pointer_field);
+        if (!must_free_promptly(*child->alloc_type))
+            return;
+
+        // The allocation is no longer referenced so the field can be cleared before it is destroyed.
+        *pointer_field = nullptr;
+        dec_ref_count_and_free(child);
+    }
+
+    void free_alloc(vm_alloc_t *alloc)
+    {
+        assert(alloc != nullptr);
+
+        // Allocations released during thread exit are freed immediately
+        if (thread_owner_retired)
+        {
+            delete alloc;
+            return;
+        }
+
+        auto &owner = thread_owner.get();
+        if (owner.freeing)
+        {
+            const auto &type_desc = *alloc->alloc_type;
+            if (must_free_promptly(type_desc))
+            {
+                delete alloc;
+                return;
+            }
+
+            // [PERF] Only the fields described by the type are examined (e.g. ADTs and frames), which
+            // covers the common case of a file descriptor held in an ADT without walking the structure.
+            // Allocations referenced through containers are released as the queue is freed.
+            if (type_desc.pointer_count > 0)
+                enum_pointer_fields(type_desc, alloc->get_allocation(), release_prompt_pointer_field);
+
+            owner.pending_frees.push_back(alloc);
+            return;
+        }
+
+        owner.freeing = true;
+        delete alloc;
+        owner.freeing = false;
+
+        while (owner.pending_frees.size() > max_pending_frees)
+            free_pending_unsafe(owner, owner.pending_frees.size() - max_pending_frees);
+    }
+}
+
+void disvm::runtime::dec_ref_count_and_free(vm_alloc_t *alloc)
+{
+    if (alloc == nullptr)
+        return;
+
+    auto current_ref = alloc->release();
+    if (current_ref == 0)
+        free_alloc(alloc);
+}
+
+std::size_t disvm::runtime::free_pending_allocs(std::size_t budget)
+{
+    if (thread_owner_retired)
+        return 0;
+
+    auto &owner = thread_owner.get();
+
+    // Allocations released while freeing are already being processed
+    if (owner.freeing || owner.pending_frees.empty())
+        return owner.pending_frees.size();
+
+    const auto pending_count = owner.pending_frees.size();
+    const auto remaining_count = free_pending_unsafe(owner, budget);
+
+    if (disvm::debug::is_component_tracing_enabled<component_trace_t::memory>())
+        disvm::debug::log_msg(component_trace_t::memory, log_level_t::debug, "free: pending: %d remaining: %d", static_cast<int>(pending_count), static_cast<int>(remaining_count));
+
+    return remaining_count;
+}
+
+bool disvm::runtime::park_system_thread()
+{
+    if (thread_owner_retired)
+        return true;
+
+    auto &owner = thread_owner.get();
+    if (!owner.pending_frees.empty())
+        return false;
+
+    std::lock_guard<std::mutex> lock{ owner.lock };
+    if (!owner.queued.empty())
+        return false;
+
+    owner.parked = true;
+    return true;
+}
+
+void disvm::runtime::unpark_system_thread()
+{
+    if (thread_owner_retired)
+        return;
+
+    auto &owner = thread_owner.get();
+    std::lock_guard<std::mutex> lock{ owner.lock };
+    owner.parked = false;
+}
+
 void *vm_alloc_t::operator new(std::size_t sz)
 {
+    process_queued_releases();
     return alloc_memory(sz);
 }
 
@@ -163,15 +537,23 @@ void vm_alloc_t::operator delete(void *ptr)
     free_memory(ptr);
 }
 
-vm_alloc_t *vm_alloc_t::allocate(std::shared_ptr<const type_descriptor_t> td)
+vm_alloc_t *vm_alloc_t::allocate(const std::shared_ptr<const type_descriptor_t> &td)
+{
+    assert(td != nullptr);
+    return vm_alloc_t::allocate(td.get());
+}
+
+vm_alloc_t *vm_alloc_t::allocate(const type_descriptor_t *td)
 {
     assert(td != nullptr);
     const auto type_size_in_bytes = td->size_in_bytes;
     if (type_size_in_bytes <= 0)
         throw vm_system_exception{ "Invalid dynamic memory allocation size" };
 
+    process_queued_releases();
+
     auto mem = alloc_memory(sizeof(vm_alloc_t) + type_size_in_bytes);
-    auto alloc = ::new(mem)vm_alloc_t{ std::move(td) };
+    auto alloc = ::new(mem)vm_alloc_t{ td };
 
     if (disvm::debug::is_component_tracing_enabled<component_trace_t::memory>())
         disvm::debug::log_msg(component_trace_t::memory, log_level_t::debug, "init: vm alloc: %d", type_size_in_bytes);
@@ -193,23 +575,45 @@ vm_alloc_t *vm_alloc_t::copy(const vm_alloc_t &other)
     return alloc_copy;
 }
 
-vm_alloc_t::vm_alloc_t(std::shared_ptr<const type_descriptor_t> td)
-    : alloc_type{ std::move(td) }
-    , gc_reserved{ nullptr }
-    , _ref_count{ 1 }
+static_assert(sizeof(vm_alloc_t) == ((2 * sizeof(pointer_t)) + (2 * sizeof(uint32_t))), "Allocation header should only contain the type and reference counts");
+
+vm_alloc_t::vm_alloc_t(const std::shared_ptr<const type_descriptor_t> &td)
+    : vm_alloc_t(td.get())
+{ }
+
+vm_alloc_t::vm_alloc_t(const type_descriptor_t *td)
+    : alloc_type{ td }
+    , _owner_count{ make_owner_count(get_current_owner_id(), 1) }
+    , _shared_count{ 0 }
 {
     assert(alloc_type != nullptr);
+
+    // Allocations without an owner start merged with the reference in the shared count
+    if (get_owner_id(_owner_count.load(std::memory_order_relaxed)) == no_owner_id)
+    {
+        _owner_count = make_owner_count(no_owner_id, 0);
+        _shared_count = shared_count_unit | shared_count_merged;
+    }
+    else
+    {
+        ++thread_owner.get().owned_count;
+    }
 }
 
 vm_alloc_t::~vm_alloc_t()
 {
 #ifndef NDEBUG
-    if (_ref_count != 0)
+    if (get_ref_count() != 0)
         disvm::debug::log_msg(component_trace_t::memory, log_level_t::warning,
             "vm alloc being destroy with non-zero reference count. "
             "This could be okay if this is happening due to frame unwinding from an exception");
 #endif
 
+    // Allocations freed without being merged (e.g. by the garbage collector) still carry their owner
+    const auto owner_id = get_owner_id(_owner_count.load(std::memory_order_relaxed));
+    if (owner_id != no_owner_id)
+        release_owned_alloc(owner_id);
+
     auto finalizer = alloc_type->finalizer;
     if (finalizer != type_descriptor_t::no_finalizer)
         finalizer(this);
@@ -223,30 +627,172 @@ vm_alloc_t::~vm_alloc_t()
 
 std::size_t vm_alloc_t::add_ref()
 {
-    assert(_ref_count > 0);
+    assert(get_ref_count() > 0);
 
-    auto prev_value = _ref_count.fetch_add(1, std::memory_order::memory_order_relaxed);
-    return (prev_value + 1);
+    const auto owner_count = _owner_count.load(std::memory_order_relaxed);
+    if (is_current_owner(get_owner_id(owner_count)) && get_biased_count(owner_count) < max_biased_count)
+    {
+        _owner_count.store(owner_count + 1, std::memory_order_relaxed);
+        return get_biased_count(owner_count) + 1;
+    }
+
+    const auto prev_value = _shared_count.fetch_add(shared_count_unit, std::memory_order_relaxed);
+    return static_cast<std::size_t>(get_shared_count(prev_value) + 1);
 }
 
 std::size_t vm_alloc_t::release()
 {
-    assert(_ref_count > 0);
+    assert(get_ref_count() > 0);
+
+    // Read the owner before the shared count is updated, see merge_biased_count()
+    const auto owner_count = _owner_count.load(std::memory_order_acquire);
+    const auto owner_id = get_owner_id(owner_count);
+    if (is_current_owner(owner_id))
+    {
+        assert(get_biased_count(owner_count) > 0);
+        const auto biased_count = get_biased_count(owner_count) - 1;
+        if (biased_count > 0)
+        {
+            _owner_count.store(owner_count - 1, std::memory_order_relaxed);
+            return biased_count;
+        }
+
+        // The remaining references (if any) are counted by the shared count
+        const auto prev_value = _shared_count.fetch_or(shared_count_merged, std::memory_order_acq_rel);
+        _owner_count.store(make_owner_count(no_owner_id, 0), std::memory_order_release);
+        release_owned_alloc(owner_id);
+
+        // A queued allocation is freed when the queue is processed
+        const auto shared_count = get_shared_count(prev_value);
+        if (shared_count == 0 && (prev_value & shared_count_queued) == 0)
+            return 0;
+
+        return (shared_count > 0) ? static_cast<std::size_t>(shared_count) : 1;
+    }
+
+    auto prev_value = _shared_count.load(std::memory_order_relaxed);
+    auto new_value = int32_t{};
+    auto queue = false;
+    do
+    {
+        new_value = prev_value - shared_count_unit;
+        queue = false;
+
+        // References may be held through the biased count
+        if (get_shared_count(new_value) < 0 && (new_value & (shared_count_merged | shared_count_queued)) == 0)
+        {
+            new_value |= shared_count_queued;
+            queue = true;
+        }
+    } while (!_shared_count.compare_exchange_weak(prev_value, new_value, std::memory_order_acq_rel, std::memory_order_relaxed));
+
+    if (queue)
+    {
+        assert(owner_id != no_owner_id);
+        auto owner = find_owner(owner_id);
+        if (owner != nullptr)
+        {
+            std::lock_guard<std::mutex> lock{ owner->lock };
+            if (!owner->retired && !owner->parked)
+            {
+                owner->queued.push_back(this);
+                owner->has_queued.store(true, std::memory_order_relaxed);
+                return 1;
+            }
+
+            // The owner isn't updating biased counts so they can be merged by this thread.
+            // The lock keeps the owner parked until the merge is complete.
+            return merge_biased_count() ? 0 : 1;
+        }
+
+        // The owner ID was released so the owner has already merged the allocation
+        return merge_biased_count() ? 0 : 1;
+    }
 
-    auto prev_value = _ref_count.fetch_sub(1, std::memory_order::memory_order_relaxed);
-    return (prev_value - 1);
+    const auto shared_count = get_shared_count(new_value);
+    if (shared_count == 0 && (new_value & shared_count_merged) != 0 && (new_value & shared_count_queued) == 0)
+        return 0;
+
+    return (shared_count > 0) ? static_cast<std::size_t>(shared_count) : 1;
 }
 
 std::size_t vm_alloc_t::get_ref_count() const
 {
-    return _ref_count;
+    const auto count = get_shared_count(_shared_count.load(std::memory_order_relaxed)) + static_cast<int32_t>(get_biased_count(_owner_count.load(std::memory_order_relaxed)));
+    return (count > 0) ? static_cast<std::size_t>(count) : 0;
+}
+
+uint32_t vm_alloc_t::get_gc_reserved() const
+{
+    return static_cast<uint32_t>((_shared_count.load(std::memory_order_relaxed) & shared_count_gc_mask) >> shared_count_gc_shift);
+}
+
+void vm_alloc_t::set_gc_reserved(uint32_t value)
+{
+    assert(value <= (shared_count_gc_mask >> shared_count_gc_shift));
+    const auto gc_bits = static_cast<int32_t>(value << shared_count_gc_shift);
+
+    // Other threads may be updating the shared count
+    auto prev_value = _shared_count.load(std::memory_order_relaxed);
+    while ((prev_value & shared_count_gc_mask) != gc_bits
+        && !_shared_count.compare_exchange_weak(prev_value, (prev_value & ~shared_count_gc_mask) | gc_bits, std::memory_order_relaxed, std::memory_order_relaxed))
+    {
+    }
+}
+
+bool vm_alloc_t::merge_biased_count()
+{
+    // Only the owner, or any thread while the owner is parked or retired, updates the biased count.
+    const auto owner_count = _owner_count.load(std::memory_order_relaxed);
+    const auto biased_count = static_cast<int32_t>(get_biased_count(owner_count));
+
+    auto prev_value = _shared_count.load(std::memory_order_relaxed);
+    auto new_value = int32_t{};
+    auto already_merged = false;
+    do
+    {
+        // An allocation merged by its owner only needs to leave the queue
+        already_merged = (prev_value & shared_count_merged) != 0;
+        const auto merged_count = already_merged ? 0 : biased_count;
+        new_value = ((prev_value + (merged_count * shared_count_unit)) | shared_count_merged) & ~shared_count_queued;
+    } while (!_shared_count.compare_exchange_weak(prev_value, new_value, std::memory_order_acq_rel, std::memory_order_relaxed));
+
+    _owner_count.store(make_owner_count(no_owner_id, 0), std::memory_order_release);
+    if (!already_merged)
+        release_owned_alloc(get_owner_id(owner_count));
+
+    assert(get_shared_count(new_value) >= 0);
+    return get_shared_count(new_value) == 0;
+}
+
+void vm_alloc_t::process_deferred_releases()
+{
+    if (thread_owner_retired)
+        return;
+
+    auto &owner = thread_owner.get();
+    std::vector<vm_alloc_t *> queued;
+    {
+        std::lock_guard<std::mutex> lock{ owner.lock };
+        queued.swap(owner.queued);
+        owner.has_queued.store(false, std::memory_order_relaxed);
+    }
+
+    for (auto alloc : queued)
+    {
+        if (alloc->merge_biased_count())
+            free_alloc(alloc);
+    }
+
+    if (!queued.empty() && disvm::debug::is_component_tracing_enabled<component_trace_t::memory>())
+        disvm::debug::log_msg(component_trace_t::memory, log_level_t::debug, "owner: merged %d deferred releases", static_cast<int>(queued.size()));
 }
 
 namespace
 {
     namespace hidden_type_desc
     {
-#define TYPE_DESC(N,S,MS,M,F) const type_descriptor_t N{ S, MS, M, F, #N }
+#define TYPE_DESC(N,S,MS,M,F) const type_descriptor_t N{ S, MS, M, 0, nullptr, F, false, #N }
 
         TYPE_DESC(byte, sizeof(byte_t), 0, nullptr, type_descriptor_t::no_finalizer);
         TYPE_DESC(short_word, sizeof(short_word_t), 0, nullptr, type_descriptor_t::no_finalizer);
@@ -256,7 +802,16 @@ namespace
         TYPE_DESC(big, sizeof(big_t), 0, nullptr, type_descriptor_t::no_finalizer);
 
         const byte_t pointer_map[] = { 0x80 };
-        TYPE_DESC(pointer, sizeof(pointer_t), (sizeof(pointer_map) / sizeof(pointer_map[0])), pointer_map, type_descriptor_t::no_finalizer);
+        const word_t pointer_offsets[] = { 0 };
+        const type_descriptor_t pointer{
+            sizeof(pointer_t),
+            (sizeof(pointer_map) / sizeof(pointer_map[0])),
+            pointer_map,
+            (sizeof(pointer_offsets) / sizeof(pointer_offsets[0])),
+            pointer_offsets,
+            type_descriptor_t::no_finalizer,
+            false,
+            "pointer" };
 
         TYPE_DESC(vm_array, 0, 0, nullptr, type_descriptor_t::no_finalizer);
         TYPE_DESC(vm_list, 0, 0, nullptr, type_descriptor_t::no_finalizer);
@@ -390,50 +945,159 @@ std::shared_ptr<const type_descriptor_t> type_descriptor_t::create(const word_t
     return type_descriptor_t::create(size_in_bytes, static_cast<word_t>(pointer_map.size()), pointer_map.data());
 }
 
+namespace
+{
+    // Layout of a type descriptor used to find an interned instance
+    struct type_layout_t
+    {
+        word_t size_in_bytes;
+        word_t map_in_bytes;
+        const byte_t *pointer_map;
+        vm_alloc_instance_finalizer_t finalizer;
+    };
+
+    struct type_layout_hash_t
+    {
+        std::size_t operator()(const type_layout_t &layout) const
+        {
+            // FNV-1a
+            auto hash = std::size_t{ 2166136261u };
+            auto mix = [&hash](std::size_t value)
+            {
+                hash ^= value;
+                hash *= std::size_t{ 16777619u };
+            };
+
+            mix(static_cast<std::size_t>(layout.size_in_bytes));
+            mix(reinterpret_cast<std::size_t>(layout.finalizer));
+            for (auto i = word_t{ 0 }; i < layout.map_in_bytes; ++i)
+                mix(layout.pointer_map[i]);
+
+            return hash;
+        }
+    };
+
+    struct type_layout_equal_t
+    {
+        bool operator()(const type_layout_t &l, const type_layout_t &r) const
+        {
+            return l.size_in_bytes == r.size_in_bytes
+                && l.map_in_bytes == r.map_in_bytes
+                && l.finalizer == r.finalizer
+                && 0 == std::memcmp(l.pointer_map, r.pointer_map, l.map_in_bytes);
+        }
+    };
+
+    // Process-wide table of type descriptors created through type_descriptor_t::create().
+    // The layout key of an entry refers to the pointer map of its descriptor.
+    struct interned_types_t
+    {
+        std::mutex lock;
+        std::unordered_map<type_layout_t, std::shared_ptr<const type_descriptor_t>, type_layout_hash_t, type_layout_equal_t> types;
+    };
+
+    interned_types_t &get_interned_types()
+    {
+        // Allocations only refer to their type descriptor (see vm_alloc_t), so interned
+        // descriptors are never destroyed. Allocations may be freed during process exit.
+        static auto interned_types = new interned_types_t{};
+        return *interned_types;
+    }
+
+    // Interned type descriptors are shared between VMs and outlive the VM (and memory allocator)
+    // that created them so they are allocated from the process heap.
+    void *alloc_type_memory(std::size_t amount_in_bytes)
+    {
+        auto memory = std::malloc(amount_in_bytes);
+        if (memory == nullptr)
+            throw vm_system_exception{ "Out of memory" };
+
+        return memory;
+    }
+
+    struct
+    {
+        void operator()(const type_descriptor_t *)
+        {
+            // Interned descriptors are never destroyed
+        }
+    } interned_type_deleter;
+}
+
 std::shared_ptr<const type_descriptor_t> type_descriptor_t::create(
     const word_t size_in_bytes,
     const word_t pointer_map_length,
     const byte_t *pointer_map,
     const vm_alloc_instance_finalizer_t finalizer)
 {
-    struct
-    {
-        void operator()(type_descriptor_t *td)
-        {
-            free_memory(const_cast<byte_t *>(td->pointer_map));
-            debug::assign_debug_pointer(const_cast<byte_t **>(&td->pointer_map));
+    assert(pointer_map_length == 0 || pointer_map != nullptr);
 
-            if (disvm::debug::is_component_tracing_enabled<component_trace_t::memory>())
-                disvm::debug::log_msg(component_trace_t::memory, log_level_t::debug, "destroy: type descriptor");
-
-            free_memory(td);
-        }
-    } deleter;
+    // [PERF] Identical layouts share a descriptor so finding an existing type doesn't allocate
+    // and equality of descriptors created here is a pointer comparison.
+    const auto layout = type_layout_t{ size_in_bytes, pointer_map_length, pointer_map, finalizer };
 
-    auto new_type_memory = alloc_memory(sizeof(type_descriptor_t));
+    auto &interned_types = get_interned_types();
+    std::lock_guard<std::mutex> lock{ interned_types.lock };
+    auto iter = interned_types.types.find(layout);
+    if (iter != interned_types.types.end())
+        return iter->second;
 
     byte_t *pointer_map_local = nullptr;
     if (pointer_map_length > 0)
     {
-        pointer_map_local = alloc_memory<byte_t>(pointer_map_length);
+        pointer_map_local = static_cast<byte_t *>(alloc_type_memory(pointer_map_length));
         for (auto i = word_t{ 0 }; i < pointer_map_length; ++i)
             pointer_map_local[i] = pointer_map[i];
     }
 
-    auto new_type = ::new(new_type_memory) type_descriptor_t{ size_in_bytes, pointer_map_length, pointer_map_local, finalizer, "?" };
-    return std::shared_ptr<type_descriptor_t>{ new_type, deleter };
+    // Highest order bit is the first field
+    auto pointer_offsets = std::vector<word_t>{};
+    for (auto i = word_t{ 0 }; i < pointer_map_length; ++i)
+    {
+        for (auto b = word_t{ 0 }; b < 8; ++b)
+        {
+            if ((pointer_map[i] & (0x80 >> b)) != 0)
+                pointer_offsets.push_back((i * 8) + b);
+        }
+    }
+
+    word_t *pointer_offsets_local = nullptr;
+    const auto pointer_count = static_cast<word_t>(pointer_offsets.size());
+    if (pointer_count > 0)
+    {
+        pointer_offsets_local = static_cast<word_t *>(alloc_type_memory(pointer_count * sizeof(word_t)));
+        std::copy(pointer_offsets.cbegin(), pointer_offsets.cend(), pointer_offsets_local);
+    }
+
+    auto new_type_memory = alloc_type_memory(sizeof(type_descriptor_t));
+    auto td = ::new(new_type_memory) type_descriptor_t{ size_in_bytes, pointer_map_length, pointer_map_local, pointer_count, pointer_offsets_local, finalizer, false, "?" };
+    auto new_type = std::shared_ptr<const type_descriptor_t>{ td, interned_type_deleter };
+
+    const auto new_layout = type_layout_t{ size_in_bytes, pointer_map_length, td->pointer_map, finalizer };
+    interned_types.types.emplace(new_layout, new_type);
+
+    if (disvm::debug::is_component_tracing_enabled<component_trace_t::memory>())
+        disvm::debug::log_msg(component_trace_t::memory, log_level_t::debug, "intern: type descriptor: %d", interned_types.types.size());
+
+    return new_type;
 }
 
 type_descriptor_t::type_descriptor_t(
     word_t size_in_bytes,
     word_t map_in_bytes,
     const byte_t * pointer_map,
+    word_t pointer_count,
+    const word_t * pointer_offsets,
     vm_alloc_instance_finalizer_t finalizer,
+    bool free_eagerly,
     const char *debug_name)
     : size_in_bytes{ size_in_bytes }
     , map_in_bytes{ map_in_bytes }
     , pointer_map{ pointer_map }
+    , pointer_count{ pointer_count }
+    , pointer_offsets{ pointer_offsets }
     , finalizer{ finalizer }
+    , free_eagerly{ free_eagerly }
 #ifndef NDEBUG
     , debug_type_name{ debug_name }
 #endif
@@ -455,6 +1119,7 @@ bool type_descriptor_t::is_equal(const type_descriptor_t *other) const
     equal = equal && map_in_bytes == other->map_in_bytes;
     equal = equal && 0 == std::memcmp(pointer_map, other->pointer_map, map_in_bytes);
     equal = equal && finalizer == other->finalizer;
+    equal = equal && free_eagerly == other->free_eagerly;
 
     return equal;
 }